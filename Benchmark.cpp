@@ -0,0 +1,940 @@
+#include "Benchmark.h"
+#include "VulkanRenderer.h"
+#include "MappedFile.h"
+#include "MeshImporter.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+// Average CPU-side time per frame (ms) over frameCount frames
+static double TimeFrames(VulkanRenderer& renderer, int frameCount, bool bWaitIdle)
+{
+	// Warm up so first-use costs (driver allocations, shader compilation) don't skew the result
+	for (int i = 0; i < 10; ++i)
+	{
+		renderer.Draw();
+	}
+	renderer.WaitIdle();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < frameCount; ++i)
+	{
+		renderer.Draw();
+
+		// Old behaviour: CPU and GPU never overlap
+		if (bWaitIdle)
+		{
+			renderer.WaitIdle();
+		}
+	}
+	// Include the tail of the last frames so both loops measure the same amount of GPU work
+	renderer.WaitIdle();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count() / frameCount;
+}
+
+void RunFrameBenchmark(int frameCount)
+{
+	double singleFrameMs = 0.0;
+	double inFlightMs = 0.0;
+
+	// Headless, so presentation/vsync doesn't hide the difference and it runs without a display
+	RendererSettings settings;
+	settings.bHeadless = true;
+
+	{
+		settings.framesInFlight = 1;
+		VulkanRenderer renderer(settings);
+		singleFrameMs = TimeFrames(renderer, frameCount, true);
+	}
+	{
+		settings.framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+		VulkanRenderer renderer(settings);
+		inFlightMs = TimeFrames(renderer, frameCount, false);
+	}
+
+	std::cout << "Frame benchmark (" << frameCount << " frames)\n";
+	std::cout << "  1 frame + wait idle : " << singleFrameMs << " ms/frame (" << 1000.0 / singleFrameMs << " fps)\n";
+	std::cout << "  " << DEFAULT_FRAMES_IN_FLIGHT << " frames in flight  : " << inFlightMs << " ms/frame (" << 1000.0 / inFlightMs << " fps)\n";
+	std::cout << "  Speedup             : " << singleFrameMs / inFlightMs << "x\n";
+}
+
+// Small triangles with no shared vertices, so vertex fetch dominates over rasterisation
+static void BuildTriangleSoup(int triangleCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const int gridSize = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(triangleCount))));
+	const float cellSize = 1.8f / gridSize;
+
+	vertices.reserve(triangleCount * 3);
+	indices.reserve(triangleCount * 3);
+	for (int i = 0; i < triangleCount; ++i)
+	{
+		float x = -0.9f + (i % gridSize) * cellSize;
+		float y = -0.9f + (i / gridSize) * cellSize;
+		glm::vec3 colour(static_cast<float>(i % 7) / 6.0f, static_cast<float>(i % 5) / 4.0f, static_cast<float>(i % 3) / 2.0f);
+
+		vertices.push_back({ { x, y, 0.0f }, colour });
+		vertices.push_back({ { x + cellSize, y + cellSize, 0.0f }, colour });
+		vertices.push_back({ { x, y + cellSize, 0.0f }, colour });
+	}
+	for (uint32_t i = 0; i < static_cast<uint32_t>(vertices.size()); ++i)
+	{
+		indices.push_back(i);
+	}
+}
+
+void RunVertexLayoutBenchmark(int triangleCount, int frameCount)
+{
+	RendererSettings settings;
+	settings.bHeadless = true;
+	VulkanRenderer renderer(settings);
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	BuildTriangleSoup(triangleCount, vertices, indices);
+
+	const VertexLayout interleaved = VertexLayout::Interleaved(VulkanRenderer::GetVertexAttributes());
+	const VertexLayout split = VertexLayout::PositionSplit(VulkanRenderer::GetVertexAttributes());
+
+	struct LayoutCase
+	{
+		const char*		name;
+		VertexLayout	layout;
+		VkShaderModule	vertexShader;
+	};
+	const LayoutCase cases[] = {
+		{ "Interleaved   ", interleaved, renderer.GetBasePipelineDesc().vertexShader },
+		{ "Position split", split, renderer.GetBasePipelineDesc().vertexShader },
+		{ "Position only ", split.PositionOnly(), renderer.GetShaderModuleCache()->GetModule("Shaders/depth.spv") },
+	};
+
+	std::cout << "Vertex layout benchmark (" << triangleCount << " triangles, " << frameCount << " frames)\n";
+	for (const LayoutCase& layoutCase : cases)
+	{
+		GraphicsPipelineDesc desc = renderer.GetBasePipelineDesc();
+		desc.vertexShader = layoutCase.vertexShader;
+		desc.vertexLayout = layoutCase.layout;
+		std::shared_future<VkPipeline> pipeline = renderer.GetPipelineCompiler()->Compile(desc);
+		pipeline.wait();
+
+		Mesh* mesh = renderer.CreateMesh(layoutCase.layout, vertices, indices);
+		renderer.FlushUploads();
+		renderer.SetScenePipeline(pipeline, desc);
+		renderer.SetSceneMesh(mesh);
+
+		// Warm up, then only keep timings of the measured frames
+		for (int i = 0; i < 10; ++i)
+		{
+			renderer.Draw();
+		}
+		renderer.WaitIdle();
+		if (renderer.GetGpuProfiler() != nullptr)
+		{
+			renderer.GetGpuProfiler()->ResetStats();
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < frameCount; ++i)
+		{
+			renderer.Draw();
+		}
+		renderer.WaitIdle();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		// GPU time of the main pass if timestamps are supported, otherwise CPU time per frame
+		double frameMs = std::chrono::duration<double, std::milli>(end - start).count() / frameCount;
+		const char* timeSource = "cpu";
+		if (renderer.GetGpuProfiler() != nullptr && renderer.GetGpuProfiler()->IsEnabled())
+		{
+			auto stats = renderer.GetGpuProfiler()->GetStats();
+			auto mainPass = stats.find("MainPass");
+			if (mainPass != stats.end())
+			{
+				frameMs = mainPass->second.avgMs;
+				timeSource = "gpu";
+			}
+		}
+
+		double fetchedBytes = static_cast<double>(vertices.size()) * layoutCase.layout.GetVertexSize();
+		std::cout << "  " << layoutCase.name << " : " << layoutCase.layout.GetVertexSize() << " B/vertex, "
+			<< layoutCase.layout.GetStreamCount() << " stream(s), " << frameMs << " ms/frame (" << timeSource << "), "
+			<< fetchedBytes / (frameMs * 1.0e6) << " GB/s\n";
+
+		renderer.SetSceneMesh(nullptr);
+		renderer.DestroyMesh(mesh);
+	}
+}
+
+// Old loading path: stream the whole file into a heap buffer
+static std::vector<char> ReadFileCopy(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+	std::vector<char> fileBuffer(fileSize);
+	file.seekg(0);
+	file.read(fileBuffer.data(), fileSize);
+
+	return fileBuffer;
+}
+
+// Reads every byte, so both paths pay for actually getting the data into memory
+static uint64_t Checksum(const char* data, size_t size)
+{
+	uint64_t sum = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		sum += static_cast<unsigned char>(data[i]);
+	}
+	return sum;
+}
+
+// Scratch asset of pseudo random bytes (nothing for the OS to compress or dedupe)
+static void WriteScratchFile(const std::string& fileName, size_t size)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to create a file: " + fileName);
+	}
+
+	std::vector<uint32_t> block(1024 * 1024 / sizeof(uint32_t));
+	uint32_t seed = 1;
+	for (size_t written = 0; written < size; written += block.size() * sizeof(uint32_t))
+	{
+		for (uint32_t& word : block)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			word = seed;
+		}
+		size_t blockSize = std::min(block.size() * sizeof(uint32_t), size - written);
+		file.write(reinterpret_cast<const char*>(block.data()), blockSize);
+	}
+}
+
+void RunFileLoadBenchmark(const std::string& fileName, int iterations)
+{
+	// Without a file, load a generated 256 MB asset (small files only measure per call overhead)
+	std::string loadFileName = fileName;
+	if (loadFileName.empty())
+	{
+		loadFileName = "file_load_bench.bin";
+		WriteScratchFile(loadFileName, 256 * 1024 * 1024);
+	}
+
+	uint64_t copySum = 0;
+	uint64_t mapSum = 0;
+	size_t fileSize = 0;
+
+	auto copyStart = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		std::vector<char> data = ReadFileCopy(loadFileName);
+		copySum += Checksum(data.data(), data.size());
+		fileSize = data.size();
+	}
+	auto copyEnd = std::chrono::high_resolution_clock::now();
+
+	auto mapStart = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		MappedFile data(loadFileName);
+		mapSum += Checksum(data.GetData(), data.GetSize());
+	}
+	auto mapEnd = std::chrono::high_resolution_clock::now();
+
+	if (copySum != mapSum)
+	{
+		throw std::runtime_error("File load benchmark: mapped data does not match copied data!");
+	}
+
+	double copyMs = std::chrono::duration<double, std::milli>(copyEnd - copyStart).count() / iterations;
+	double mapMs = std::chrono::duration<double, std::milli>(mapEnd - mapStart).count() / iterations;
+	double sizeMB = fileSize / (1024.0 * 1024.0);
+
+	std::cout << "File load benchmark: " << loadFileName << " (" << sizeMB << " MB, " << iterations << " iterations)\n";
+	std::cout << "  ifstream + copy : " << copyMs << " ms (" << sizeMB / (copyMs / 1000.0) << " MB/s)\n";
+	std::cout << "  memory mapped   : " << mapMs << " ms (" << sizeMB / (mapMs / 1000.0) << " MB/s)\n";
+}
+
+// Grid of quads with per vertex colour and one normal, every position shared by up to 6 triangle corners like a scan
+static void WriteGridOBJ(const std::string& fileName, int gridSize)
+{
+	std::ofstream file(fileName);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+
+	for (int y = 0; y <= gridSize; ++y)
+	{
+		for (int x = 0; x <= gridSize; ++x)
+		{
+			file << "v " << x / static_cast<float>(gridSize) << " " << y / static_cast<float>(gridSize) << " 0.0 "
+				<< (x % 256) / 255.0f << " " << (y % 256) / 255.0f << " 0.5\n";
+		}
+	}
+	file << "vn 0.0 0.0 1.0\n";
+
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int i = y * (gridSize + 1) + x + 1;
+			file << "f " << i << "//1 " << i + 1 << "//1 " << i + gridSize + 2 << "//1 " << i + gridSize + 1 << "//1\n";
+		}
+	}
+}
+
+void RunMeshImportBenchmark(const std::string& fileName, int iterations)
+{
+	// Without a file, import a generated ~2M triangle grid
+	std::string importFileName = fileName;
+	if (importFileName.empty())
+	{
+		importFileName = "mesh_import_bench.obj";
+		WriteGridOBJ(importFileName, 1024);
+	}
+
+	// Single threaded first as the baseline, then doubling up to every hardware thread
+	std::vector<int> threadCounts = { 1 };
+	int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	for (int threads = 2; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	if (maxThreads > 1)
+	{
+		threadCounts.push_back(maxThreads);
+	}
+
+	std::cout << "Mesh import benchmark: " << importFileName << " (" << iterations << " iterations)\n";
+	for (int threads : threadCounts)
+	{
+		MeshImporter::Stats total;
+		MeshData mesh;
+		for (int i = 0; i < iterations; ++i)
+		{
+			MeshImporter::Stats stats;
+			mesh = MeshImporter::ImportOBJ(importFileName, threads, &stats);
+			total.fileBytes = stats.fileBytes;
+			total.threadCount = stats.threadCount;
+			total.parseMs += stats.parseMs / iterations;
+			total.dedupMs += stats.dedupMs / iterations;
+			total.totalMs += stats.totalMs / iterations;
+		}
+
+		double sizeMB = total.fileBytes / (1024.0 * 1024.0);
+		std::cout << "  " << total.threadCount << " thread(s) : " << total.totalMs << " ms (parse " << total.parseMs << " ms, dedup "
+			<< total.dedupMs << " ms), " << sizeMB / (total.totalMs / 1000.0) << " MB/s, " << mesh.vertices.size() << " vertices, "
+			<< mesh.indices.size() / 3 << " triangles\n";
+	}
+}
+
+void RunMeshCacheBenchmark(const std::string& fileName, int iterations)
+{
+	std::string sourceFileName = fileName;
+	if (sourceFileName.empty())
+	{
+		sourceFileName = "mesh_import_bench.obj";
+		WriteGridOBJ(sourceFileName, 1024);
+	}
+
+	const VertexLayout layout = VertexLayout::Interleaved(VulkanRenderer::GetVertexAttributes());
+	const std::string cacheFileName = sourceFileName + ".gxmesh";
+
+	auto cookStart = std::chrono::high_resolution_clock::now();
+	MeshCache::Cook(MeshImporter::ImportOBJ(sourceFileName), layout, RendererSettings().frontFace, cacheFileName, sourceFileName);
+	double cookMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cookStart).count();
+
+	// Both paths end with the data in one upload-sized buffer, standing in for the staging ring
+	std::vector<char> staging;
+	double importMs = 0.0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshData mesh = MeshImporter::ImportOBJ(sourceFileName);
+		std::vector<std::vector<uint8_t>> streams;
+		layout.WriteStreams(mesh.vertices.data(), sizeof(Vertex), mesh.vertices.size(), streams);
+		staging.resize(streams[0].size() + mesh.indices.size() * sizeof(uint32_t));
+		memcpy(staging.data(), streams[0].data(), streams[0].size());
+		memcpy(staging.data() + streams[0].size(), mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		importMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+	}
+
+	double cacheMs = 0.0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshCacheFile cacheFile(cacheFileName);
+		const MeshCacheSection* vertexSection = cacheFile.FindSection(MeshCacheSectionType::VertexStream);
+		const MeshCacheSection* indexSection = cacheFile.FindSection(MeshCacheSectionType::Indices);
+		staging.resize(vertexSection->size + indexSection->size);
+		memcpy(staging.data(), cacheFile.GetSectionData(*vertexSection), vertexSection->size);
+		memcpy(staging.data() + vertexSection->size, cacheFile.GetSectionData(*indexSection), indexSection->size);
+		cacheMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+	}
+
+	std::cout << "Mesh cache benchmark: " << sourceFileName << " (" << iterations << " iterations)\n";
+	std::cout << "  Cook         : " << cookMs << " ms (once)\n";
+	std::cout << "  OBJ import   : " << importMs << " ms\n";
+	std::cout << "  Mapped cache : " << cacheMs << " ms\n";
+	std::cout << "  Speedup      : " << importMs / cacheMs << "x\n";
+}
+
+static void PrintMeshStats(const char* stage, const MeshData& mesh, double ms)
+{
+	MeshOptimizer::CacheStats cache = MeshOptimizer::AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+	MeshOptimizer::FetchStats fetch = MeshOptimizer::AnalyzeVertexFetch(mesh.indices, mesh.vertices.size(), sizeof(Vertex));
+	std::cout << "  " << stage << " : ACMR " << cache.acmr << ", ATVR " << cache.atvr << ", overfetch " << fetch.overfetch;
+	if (ms > 0.0)
+	{
+		std::cout << " (" << ms << " ms)";
+	}
+	std::cout << "\n";
+}
+
+void RunMeshOptimizationReport(const std::vector<std::string>& fileNames)
+{
+	std::vector<std::string> assets = fileNames;
+	if (assets.empty())
+	{
+		assets.push_back("mesh_optimize_bench.obj");
+		WriteGridOBJ(assets.back(), 256);
+	}
+
+	auto TimeStage = [](const std::function<void()>& stage)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		stage();
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	};
+
+	// Stages run cumulatively, as the cook step runs them
+	MeshOptimizer::Options options;
+	for (const std::string& asset : assets)
+	{
+		MeshData mesh = MeshImporter::ImportOBJ(asset);
+		std::cout << asset << " (" << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles, "
+			<< "cache size " << MeshOptimizer::CACHE_SIZE << ")\n";
+
+		PrintMeshStats("Imported     ", mesh, 0.0);
+		double ms = TimeStage([&]() { MeshOptimizer::OptimizeVertexCache(mesh.indices, mesh.vertices.size()); });
+		PrintMeshStats("Vertex cache ", mesh, ms);
+		ms = TimeStage([&]() { MeshOptimizer::OptimizeOverdraw(mesh.indices, mesh.vertices, options.overdrawThreshold, options.frontFace); });
+		PrintMeshStats("Overdraw     ", mesh, ms);
+		ms = TimeStage([&]() { MeshOptimizer::OptimizeVertexFetch(mesh.vertices, mesh.indices); });
+		PrintMeshStats("Vertex fetch ", mesh, ms);
+
+		ms = TimeStage([&]() { MeshOptimizer::BuildMeshlets(mesh, options.frontFace); });
+		size_t backfaceCullable = 0;
+		for (const Meshlet& meshlet : mesh.meshlets)
+		{
+			backfaceCullable += meshlet.coneCutoff <= 1.0f ? 1 : 0;
+		}
+		std::cout << "  Meshlets      : " << mesh.meshlets.size() << ", "
+			<< (mesh.meshlets.empty() ? 0.0 : mesh.indices.size() / 3.0 / mesh.meshlets.size()) << " triangles each, "
+			<< backfaceCullable << " backface cullable (" << ms << " ms)\n";
+	}
+}
+
+// Checkerboard with a gradient, so every mip level differs
+static uint8_t TestPixel(uint32_t x, uint32_t y, uint32_t channel, uint32_t seed)
+{
+	uint8_t checker = ((x / 32 + y / 32 + seed) & 1) ? 224 : 32;
+	return channel == 0 ? checker : channel == 1 ? static_cast<uint8_t>(x + seed * 64) : static_cast<uint8_t>(y);
+}
+
+// Uncompressed 32 bit TGA, bottom row first
+static void WriteTestTGA(const std::string& fileName, uint32_t width, uint32_t height, uint32_t seed)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+
+	uint8_t header[18] = {};
+	header[2] = 2;
+	header[12] = width & 0xFF;
+	header[13] = (width >> 8) & 0xFF;
+	header[14] = height & 0xFF;
+	header[15] = (height >> 8) & 0xFF;
+	header[16] = 32;
+	header[17] = 8;
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	std::vector<uint8_t> row(width * 4);
+	for (uint32_t y = height; y-- > 0;)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			row[x * 4 + 0] = TestPixel(x, y, 2, seed);
+			row[x * 4 + 1] = TestPixel(x, y, 1, seed);
+			row[x * 4 + 2] = TestPixel(x, y, 0, seed);
+			row[x * 4 + 3] = 255;
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+}
+
+// Binary PPM, top row first
+static void WriteTestPPM(const std::string& fileName, uint32_t width, uint32_t height, uint32_t seed)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<uint8_t> row(width * 3);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			for (uint32_t channel = 0; channel < 3; ++channel)
+			{
+				row[x * 3 + channel] = TestPixel(x, y, channel, seed);
+			}
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+}
+
+void RunTextureBenchmark(const std::vector<std::string>& fileNames)
+{
+	// One texture per file, or a generated set (including a non power of two size and an array)
+	std::vector<std::vector<std::string>> textureFiles;
+	for (const std::string& fileName : fileNames)
+	{
+		textureFiles.push_back({ fileName });
+	}
+	if (textureFiles.empty())
+	{
+		WriteTestTGA("texture_bench_4096.tga", 4096, 4096, 0);
+		WriteTestTGA("texture_bench_2048.tga", 2048, 2048, 1);
+		WriteTestTGA("texture_bench_1024.tga", 1024, 1024, 2);
+		WriteTestPPM("texture_bench_1000x600.ppm", 1000, 600, 3);
+		textureFiles = { { "texture_bench_4096.tga" }, { "texture_bench_2048.tga" }, { "texture_bench_1024.tga" }, { "texture_bench_1000x600.ppm" }, {} };
+		for (uint32_t layer = 0; layer < 4; ++layer)
+		{
+			textureFiles.back().push_back("texture_bench_layer" + std::to_string(layer) + ".tga");
+			WriteTestTGA(textureFiles.back().back(), 512, 512, layer);
+		}
+	}
+
+	RendererSettings settings;
+	settings.bHeadless = true;
+	VulkanRenderer renderer(settings);
+
+	// Every request is queued up front so decoding overlaps across loader threads and with the uploads
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<Texture*> textures;
+	for (const auto& files : textureFiles)
+	{
+		textures.push_back(renderer.LoadTextureArray(files, false));
+	}
+	renderer.FinishTextureLoads();
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	double decodeMs = 0.0;
+	VkDeviceSize totalSize = 0;
+	size_t readyCount = 0;
+	for (Texture* texture : textures)
+	{
+		if (texture->state == TextureState::Ready)
+		{
+			decodeMs += texture->decodeMs;
+			totalSize += texture->allocation.size;
+			++readyCount;
+		}
+		renderer.DestroyTexture(texture);
+	}
+
+	std::cout << "Texture benchmark (" << readyCount << "/" << textures.size() << " textures loaded)\n";
+	std::cout << "  Decode (summed over threads) : " << decodeMs << " ms\n";
+	std::cout << "  Request to all ready         : " << totalMs << " ms\n";
+	std::cout << "  VRAM                         : " << totalSize / (1024.0 * 1024.0) << " MB\n";
+}
+
+void RunTextureStreamingBenchmark(int textureCount, int frameCount)
+{
+	std::vector<std::string> fileNames;
+	for (int i = 0; i < textureCount; ++i)
+	{
+		fileNames.push_back("texture_stream_bench" + std::to_string(i) + ".tga");
+		WriteTestTGA(fileNames.back(), 1024, 1024, i);
+	}
+
+	// Budget well below what every mip of every texture needs, so the camera can't see them all sharp at once
+	RendererSettings settings;
+	settings.bHeadless = true;
+	settings.textureStreamingBudget = 32ULL * 1024 * 1024;
+	VulkanRenderer renderer(settings);
+	TextureStreamer* streamer = renderer.GetTextureStreamer();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<Texture*> textures;
+	for (const std::string& fileName : fileNames)
+	{
+		textures.push_back(renderer.LoadStreamedTexture(fileName, false));
+	}
+	renderer.FinishTextureLoads();
+	double tailMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "Texture streaming benchmark (" << textureCount << " textures, " << frameCount << " frames, "
+		<< settings.textureStreamingBudget / (1024 * 1024) << " MB budget)\n";
+	std::cout << "  Mip tails resident after " << tailMs << " ms\n";
+
+	// Camera pans along a row of textures: the nearest covers the screen, further ones less, the rest are off screen
+	const float visibleRange = 4.0f;
+	uint64_t missingMips = 0;
+	VkDeviceSize peakBytes = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		float camera = static_cast<float>(frame) / frameCount * textureCount;
+		for (int i = 0; i < textureCount; ++i)
+		{
+			float distance = std::fabs(i - camera);
+			if (distance < visibleRange)
+			{
+				renderer.ReportTextureUsage(textures[i], settings.width / (1.0f + distance * 2.0f));
+			}
+		}
+		renderer.Draw();
+
+		TextureStreamer::Stats stats = streamer->GetStats();
+		missingMips += stats.missingMips;
+		peakBytes = std::max(peakBytes, stats.residentBytes);
+		if ((frame + 1) % std::max(1, frameCount / 8) == 0)
+		{
+			std::cout << "  Frame " << frame + 1 << " : " << stats.residentMips << "/" << stats.totalMips << " mips, "
+				<< stats.residentBytes / (1024.0 * 1024.0) << " MB resident, " << stats.missingMips << " missing, "
+				<< stats.pendingChanges << " changes pending\n";
+		}
+	}
+	renderer.WaitIdle();
+	double frameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+	TextureStreamer::Stats stats = streamer->GetStats();
+	std::cout << "  All mips resident  : " << stats.fullBytes / (1024.0 * 1024.0) << " MB\n";
+	std::cout << "  Peak resident      : " << peakBytes / (1024.0 * 1024.0) << " MB\n";
+	std::cout << "  Mips streamed in   : " << stats.streamedInMips << ", evicted " << stats.evictedMips << "\n";
+	std::cout << "  Missing mips/frame : " << static_cast<double>(missingMips) / frameCount << "\n";
+	std::cout << "  Frame time         : " << frameMs << " ms\n";
+
+	for (Texture* texture : textures)
+	{
+		renderer.DestroyTexture(texture);
+	}
+}
+
+void RunCommandRecordBenchmark(int drawCount, int frameCount)
+{
+	RendererSettings settings;
+	settings.bHeadless = true;
+	VulkanRenderer renderer(settings);
+
+	// A few small meshes drawn one triangle at a time, so recording (not the GPU) is the cost
+	const int MESH_COUNT = 4;
+	const int TRIANGLES_PER_MESH = 1024;
+	const VertexLayout layout = VertexLayout::Interleaved(VulkanRenderer::GetVertexAttributes());
+	std::vector<Mesh*> meshes;
+	for (int i = 0; i < MESH_COUNT; ++i)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		BuildTriangleSoup(TRIANGLES_PER_MESH, vertices, indices);
+		meshes.push_back(renderer.CreateMesh(layout, vertices, indices));
+	}
+	renderer.FlushUploads();
+
+	// Runs of draws share a mesh, as a list sorted by mesh would
+	std::vector<MeshDraw> draws(drawCount);
+	for (int i = 0; i < drawCount; ++i)
+	{
+		draws[i].mesh = meshes[(i / 64) % MESH_COUNT];
+		draws[i].firstIndex = static_cast<uint32_t>(i % TRIANGLES_PER_MESH) * 3;
+		draws[i].indexCount = 3;
+	}
+	renderer.SetSceneDraws(draws);
+
+	const uint32_t maxThreads = renderer.GetCommandRecorder()->GetThreadCount();
+	std::cout << "Command record benchmark (" << drawCount << " draws, " << frameCount << " frames)\n";
+	double singleThreadMs = 0.0;
+	for (uint32_t threadCount = 1; threadCount <= maxThreads; ++threadCount)
+	{
+		renderer.SetRecordThreadCount(threadCount);
+
+		// Warm up, then only keep timings of the measured frames
+		for (int i = 0; i < 10; ++i)
+		{
+			renderer.Draw();
+		}
+		renderer.WaitIdle();
+		renderer.ResetCommandStats();
+
+		for (int i = 0; i < frameCount; ++i)
+		{
+			renderer.Draw();
+		}
+		renderer.WaitIdle();
+
+		VulkanRenderer::CommandStats stats = renderer.GetCommandStats();
+		double recordMs = stats.recordMs / stats.frameCount;
+		if (threadCount == 1)
+		{
+			singleThreadMs = recordMs;
+		}
+		std::cout << "  " << threadCount << " thread(s) : " << recordMs << " ms/frame recording, "
+			<< drawCount / recordMs << " draws/ms, " << singleThreadMs / recordMs << "x, "
+			<< static_cast<double>(stats.allocatedBuffers) / stats.frameCount << " buffer allocations/frame\n";
+	}
+
+	renderer.SetSceneDraws({});
+	for (Mesh* mesh : meshes)
+	{
+		renderer.DestroyMesh(mesh);
+	}
+}
+
+// A deferred frame: shadows, depth prepass, G-buffer, SSAO, lighting, bloom and tonemap, plus a debug view nothing reads
+static void DeclareDeferredFrame(RenderGraph& graph, int width, int height)
+{
+	const VkExtent2D full = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+	const VkExtent2D half = { full.width / 2, full.height / 2 };
+	const VkExtent2D quarter = { full.width / 4, full.height / 4 };
+	const RenderGraph::ExecuteFunction empty = [](const RenderGraph::PassContext&) {};
+
+	VkClearValue clearDepth = {};
+	clearDepth.depthStencil = { 1.0f, 0 };
+	VkClearValue clearColour = {};
+
+	RenderGraph::ImageState initialState;
+	RenderGraph::ImageState finalState;
+	finalState.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	finalState.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	finalState.access = VK_ACCESS_TRANSFER_READ_BIT;
+	RenderGraph::ResourceHandle backbuffer = graph.ImportImage("Backbuffer", { VK_FORMAT_R8G8B8A8_UNORM, full }, initialState, finalState);
+
+	RenderGraph::ResourceHandle shadowMap = graph.CreateImage("ShadowMap", { VK_FORMAT_D32_SFLOAT, { 2048, 2048 } });
+	RenderGraph::ResourceHandle depth = graph.CreateImage("Depth", { VK_FORMAT_D32_SFLOAT, full });
+	RenderGraph::ResourceHandle albedo = graph.CreateImage("Albedo", { VK_FORMAT_R8G8B8A8_UNORM, full });
+	RenderGraph::ResourceHandle normal = graph.CreateImage("Normal", { VK_FORMAT_R16G16B16A16_SFLOAT, full });
+	RenderGraph::ResourceHandle occlusion = graph.CreateImage("Occlusion", { VK_FORMAT_R32_SFLOAT, full });
+	RenderGraph::ResourceHandle hdr = graph.CreateImage("HDR", { VK_FORMAT_R16G16B16A16_SFLOAT, full });
+	RenderGraph::ResourceHandle bloomHalf = graph.CreateImage("BloomHalf", { VK_FORMAT_R16G16B16A16_SFLOAT, half });
+	RenderGraph::ResourceHandle bloomQuarter = graph.CreateImage("BloomQuarter", { VK_FORMAT_R16G16B16A16_SFLOAT, quarter });
+	RenderGraph::ResourceHandle debugView = graph.CreateImage("DebugView", { VK_FORMAT_R8G8B8A8_UNORM, full });
+
+	RenderGraph::PassHandle pass = graph.AddPass("Shadows", true, empty);
+	graph.Write(pass, shadowMap, RenderGraph::Usage::DepthAttachment, &clearDepth);
+
+	pass = graph.AddPass("DepthPrepass", true, empty);
+	graph.Write(pass, depth, RenderGraph::Usage::DepthAttachment, &clearDepth);
+
+	pass = graph.AddPass("GBuffer", true, empty);
+	graph.Read(pass, depth, RenderGraph::Usage::DepthRead);
+	graph.Write(pass, albedo, RenderGraph::Usage::ColourAttachment, &clearColour);
+	graph.Write(pass, normal, RenderGraph::Usage::ColourAttachment, &clearColour);
+
+	pass = graph.AddPass("SSAO", false, empty);
+	graph.Read(pass, depth, RenderGraph::Usage::Sampled);
+	graph.Read(pass, normal, RenderGraph::Usage::Sampled);
+	graph.Write(pass, occlusion, RenderGraph::Usage::StorageWrite);
+
+	pass = graph.AddPass("Lighting", true, empty);
+	graph.Read(pass, albedo, RenderGraph::Usage::Sampled);
+	graph.Read(pass, normal, RenderGraph::Usage::Sampled);
+	graph.Read(pass, occlusion, RenderGraph::Usage::Sampled);
+	graph.Read(pass, shadowMap, RenderGraph::Usage::Sampled);
+	graph.Write(pass, hdr, RenderGraph::Usage::ColourAttachment);
+
+	pass = graph.AddPass("DebugNormals", true, empty);
+	graph.Read(pass, normal, RenderGraph::Usage::Sampled);
+	graph.Write(pass, debugView, RenderGraph::Usage::ColourAttachment);
+
+	pass = graph.AddPass("BloomHalf", false, empty);
+	graph.Read(pass, hdr, RenderGraph::Usage::Sampled);
+	graph.Write(pass, bloomHalf, RenderGraph::Usage::StorageWrite);
+
+	pass = graph.AddPass("BloomQuarter", false, empty);
+	graph.Read(pass, bloomHalf, RenderGraph::Usage::Sampled);
+	graph.Write(pass, bloomQuarter, RenderGraph::Usage::StorageWrite);
+
+	pass = graph.AddPass("Tonemap", true, empty);
+	graph.Read(pass, hdr, RenderGraph::Usage::Sampled);
+	graph.Read(pass, bloomQuarter, RenderGraph::Usage::Sampled);
+	graph.Write(pass, backbuffer, RenderGraph::Usage::ColourAttachment);
+
+}
+
+void RunRenderGraphReport(int width, int height)
+{
+	RendererSettings settings;
+	settings.bHeadless = true;
+	VulkanRenderer renderer(settings);
+
+	RenderGraph graph(renderer.GetDevice(), renderer.GetGpuAllocator());
+	DeclareDeferredFrame(graph, width, height);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	graph.Compile();
+	double compileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "Render graph report (" << width << "x" << height << ", compiled in " << compileMs << " ms)\n";
+	graph.PrintSummary();
+
+	const RenderGraph::Stats& stats = graph.GetStats();
+	std::cout << "  Aliasing saves " << (stats.transientBytes - stats.aliasedBytes) / (1024.0 * 1024.0) << " MB ("
+		<< 100.0 * (stats.transientBytes - stats.aliasedBytes) / std::max<VkDeviceSize>(stats.transientBytes, 1) << "%)\n";
+
+	// What every swapchain recreation costs: declaring and compiling the frame again, and destroying what it replaces
+	const int REBUILD_COUNT = 100;
+	auto timeRebuilds = [&](bool bDynamicRendering)
+	{
+		RenderGraph rebuilt(renderer.GetDevice(), renderer.GetGpuAllocator(), nullptr, bDynamicRendering);
+		auto rebuildStart = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < REBUILD_COUNT; ++i)
+		{
+			rebuilt.Reset(0);
+			rebuilt.Reclaim(0);
+			DeclareDeferredFrame(rebuilt, width, height);
+			rebuilt.Compile();
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - rebuildStart).count() / REBUILD_COUNT;
+		std::cout << "  " << (rebuilt.UsesDynamicRendering() ? "Dynamic rendering" : "Render passes") << ": rebuilt in " << ms << " ms, "
+			<< rebuilt.GetStats().renderPassCount << " render passes (framebuffers for each are created on first use)\n";
+	};
+
+	std::cout << "Graph rebuild (" << REBUILD_COUNT << " times)\n";
+	timeRebuilds(false);
+	if (renderer.GetDeviceSupport().bDynamicRendering)
+	{
+		timeRebuilds(true);
+	}
+	else
+	{
+		std::cout << "  Dynamic rendering: not supported\n";
+	}
+
+	// The renderer's own frame, after a few frames have created whatever framebuffers it needs
+	for (int i = 0; i < renderer.GetFramesInFlight() + 1; ++i)
+	{
+		renderer.Draw();
+	}
+	renderer.WaitIdle();
+	std::cout << "Renderer frame graph\n";
+	renderer.GetRenderGraph()->PrintSummary();
+}
+
+// Pipelines needed for every material, when pipelines leave the given extended dynamic state to the command buffer
+static size_t CountUniquePipelines(const std::vector<GraphicsPipelineDesc>& materials, bool bDynamicState, bool bDynamicState2, bool bDynamicState3)
+{
+	std::vector<GraphicsPipelineDesc> pipelines;
+	for (GraphicsPipelineDesc desc : materials)
+	{
+		desc.bExtendedDynamicState = bDynamicState;
+		desc.bExtendedDynamicState2 = bDynamicState2;
+		desc.bExtendedDynamicState3 = bDynamicState3;
+
+		bool bShared = false;
+		for (const GraphicsPipelineDesc& pipeline : pipelines)
+		{
+			bShared = bShared || PipelineCompiler::IsCompatible(pipeline, desc);
+		}
+		if (!bShared)
+		{
+			pipelines.push_back(desc);
+		}
+	}
+	return pipelines.size();
+}
+
+void RunPipelineCountReport(int materialCount)
+{
+	RendererSettings settings;
+	settings.bHeadless = true;
+	VulkanRenderer renderer(settings);
+
+	const GraphicsPipelineDesc& base = renderer.GetBasePipelineDesc();
+	const VertexLayout interleaved = VertexLayout::Interleaved(VulkanRenderer::GetVertexAttributes());
+	const VertexLayout split = VertexLayout::PositionSplit(VulkanRenderer::GetVertexAttributes());
+
+	// Materials as a scene mixes them: opaque, alpha blended and overlay surfaces, two sided and mirrored meshes,
+	// strips with primitive restart, over two vertex layouts (picked pseudo randomly, so every combination shows up)
+	std::vector<GraphicsPipelineDesc> materials;
+	uint32_t seed = 1;
+	for (int i = 0; i < materialCount; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		GraphicsPipelineDesc desc = base;
+		desc.vertexLayout = (seed >> 8) & 1 ? split : interleaved;
+		desc.cullMode = (seed >> 9) & 1 ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+		desc.frontFace = (seed >> 10) & 1 ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
+		bool bStrip = ((seed >> 11) & 1) != 0;
+		desc.topology = bStrip ? VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		desc.bPrimitiveRestart = bStrip;
+
+		uint32_t surface = (seed >> 12) % 3;
+		desc.bDepthTest = surface != 2;			// Overlays ignore depth
+		desc.bDepthWrite = surface == 0;		// Only opaque surfaces write it
+		desc.bBlendEnable = surface != 0;
+		materials.push_back(desc);
+	}
+
+	const DeviceSupport& support = renderer.GetDeviceSupport();
+	auto supported = [](bool bSupported) { return bSupported ? "" : " (not supported by this device)"; };
+	std::cout << "Pipeline count report (" << materialCount << " materials)\n";
+	std::cout << "  Static state                 : " << CountUniquePipelines(materials, false, false, false) << " pipelines\n";
+	std::cout << "  + extended dynamic state     : " << CountUniquePipelines(materials, true, false, false) << " pipelines"
+		<< supported(support.bExtendedDynamicState) << "\n";
+	std::cout << "  + extended dynamic state 2   : " << CountUniquePipelines(materials, true, true, false) << " pipelines"
+		<< supported(support.bExtendedDynamicState2) << "\n";
+	std::cout << "  + extended dynamic state 3   : " << CountUniquePipelines(materials, true, true, true) << " pipelines"
+		<< supported(support.bExtendedDynamicState3) << "\n";
+
+	// Compile every material through the background compiler, without and then with what this device supports
+	PipelineCompiler* compiler = renderer.GetPipelineCompiler();
+	auto compileAll = [&](const char* name, bool bDynamicState)
+	{
+		size_t compiledBefore = compiler->GetCompiledCount();
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::vector<std::shared_future<VkPipeline>> pipelines;
+		for (GraphicsPipelineDesc desc : materials)
+		{
+			desc.bExtendedDynamicState = bDynamicState && base.bExtendedDynamicState;
+			desc.bExtendedDynamicState2 = bDynamicState && base.bExtendedDynamicState2;
+			desc.bExtendedDynamicState3 = bDynamicState && base.bExtendedDynamicState3;
+			pipelines.push_back(compiler->Compile(desc));
+		}
+		for (const auto& pipeline : pipelines)
+		{
+			pipeline.wait();
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		std::cout << "  " << name << ": " << compiler->GetCompiledCount() - compiledBefore << " pipelines compiled in " << ms << " ms\n";
+	};
+
+	compileAll("Compiled, static state  ", false);
+	if (base.bExtendedDynamicState || base.bExtendedDynamicState2 || base.bExtendedDynamicState3)
+	{
+		compileAll("Compiled, dynamic state ", true);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Frame-time benchmark (headless)
+// Compares the frames-in-flight loop against a single frame that waits for the device to go idle after every submit
+void RunFrameBenchmark(int frameCount);
+
+// Vertex layout benchmark (headless)
+// Draws the same mesh with interleaved, position-split and position-only (depth pass) streams,
+// reporting main pass GPU time and the vertex bandwidth each layout fetches
+void RunVertexLayoutBenchmark(int triangleCount, int frameCount);
+
+// File load benchmark
+// Compares copying a file into a heap buffer through ifstream against mapping it (both touch every byte)
+// Without a file name a 256 MB scratch file is generated
+void RunFileLoadBenchmark(const std::string& fileName, int iterations);
+
+// Mesh import benchmark
+// Imports an OBJ (a generated grid if fileName is empty) with increasing thread counts and reports MB/s
+void RunMeshImportBenchmark(const std::string& fileName, int iterations);
+
+// Mesh cache benchmark
+// Compares importing an OBJ against mapping its cooked cache, both ending with the data in an upload buffer
+void RunMeshCacheBenchmark(const std::string& fileName, int iterations);
+
+// Mesh optimisation report
+// ACMR/ATVR (post-transform cache) and overfetch (vertex fetch) of every asset after each optimisation stage
+void RunMeshOptimizationReport(const std::vector<std::string>& fileNames);
+
+// Texture load benchmark (headless)
+// Loads images (a generated set if none are given) and reports decode time, time until mipped and resident, and VRAM
+void RunTextureBenchmark(const std::vector<std::string>& fileNames);
+
+// Texture streaming benchmark (headless)
+// Pans a camera over generated textures under a fixed budget, reporting residency, streaming traffic and missing mips
+void RunTextureStreamingBenchmark(int textureCount, int frameCount);
+
+// Command recording benchmark (headless)
+// Records a large draw list inline and then over more and more threads, reporting recording time, draws per ms
+// and command buffer allocations per frame
+void RunCommandRecordBenchmark(int drawCount, int frameCount);
+
+// Render graph report (headless)
+// Compiles a deferred frame (shadows, G-buffer, SSAO, lighting, bloom, tonemap and an unused debug pass), reporting
+// culled passes, barriers and peak transient memory before and after aliasing, then the cost of rebuilding it (as on a
+// swapchain recreation) with render pass and framebuffer objects and with dynamic rendering
+void RunRenderGraphReport(int width, int height);
+
+// Pipeline count report (headless)
+// Builds a scene's worth of material permutations and counts the pipelines they need with static state and with each
+// level of extended dynamic state, then compiles them without and with what the device supports
+void RunPipelineCountReport(int materialCount);
@@ -0,0 +1,396 @@
+#include "ClusterRenderer.h"
+#include "CpuProfiler.h"
+
+#include <stdexcept>
+
+// Descriptor bindings (must match the culling shaders)
+static const uint32_t BINDING_MESHLETS = 0;
+static const uint32_t BINDING_DRAW_COMMANDS = 1;
+static const uint32_t BINDING_DRAW_COUNT = 2;
+static const uint32_t BINDING_VERTICES = 3;
+static const uint32_t BINDING_MESHLET_VERTICES = 4;
+static const uint32_t BINDING_MESHLET_TRIANGLES = 5;
+
+// Mesh shader reads position and colour as 6 floats straight out of a single interleaved stream
+static bool HasShaderVertices(const Mesh& mesh)
+{
+	return mesh.layout.GetStreamCount() == 1 && mesh.layout.GetStride(0) == sizeof(Vertex);
+}
+
+// Invocations per workgroup of the cull compute and task shaders
+static const uint32_t CULL_GROUP_SIZE = 64;
+static const uint32_t TASK_GROUP_SIZE = 32;
+
+ClusterCullParams ClusterCullParams::FromViewProjection(const glm::mat4& viewProjection, const glm::vec4& camera)
+{
+	// Gribb/Hartmann: clip space planes as combinations of the matrix rows (GLM is column major, so row i is m[.][i])
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	ClusterCullParams params;
+	params.frustumPlanes[0] = rows[3] + rows[0];		// Left
+	params.frustumPlanes[1] = rows[3] - rows[0];		// Right
+	params.frustumPlanes[2] = rows[3] + rows[1];		// Bottom
+	params.frustumPlanes[3] = rows[3] - rows[1];		// Top
+	params.frustumPlanes[4] = rows[2];					// Near (Vulkan depth starts at 0, not -w)
+	params.frustumPlanes[5] = rows[3] - rows[2];		// Far
+
+	// Normalised, so plane distances compare against sphere radii
+	for (glm::vec4& plane : params.frustumPlanes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+		{
+			plane /= length;
+		}
+	}
+
+	params.camera = camera;
+	return params;
+}
+
+ClusterRenderer::ClusterRenderer(VkDevice device, const DeviceSupport& support, bool bAllowMeshShaders, ShaderModuleCache* shaderModuleCache,
+	VkPipelineCache pipelineCache, const GraphicsPipelineDesc& baseDesc)
+	: device(device), bMeshShaders(bAllowMeshShaders && support.bMeshShader), bMultiDrawIndirect(support.bMultiDrawIndirect),
+	bDrawIndirectCount(support.bDrawIndirectCount)
+{
+	PROFILE_FUNCTION();
+
+#ifndef VK_EXT_mesh_shader
+	// Built against headers without the extension
+	bMeshShaders = false;
+#endif
+
+	// -- DESCRIPTOR SET LAYOUT --
+	// Meshlets, plus the draw commands and count written by the compute path, or the vertex data the mesh shader reads
+	VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT;
+	std::vector<uint32_t> bindings = { BINDING_MESHLETS, BINDING_DRAW_COMMANDS, BINDING_DRAW_COUNT };
+#ifdef VK_EXT_mesh_shader
+	if (bMeshShaders)
+	{
+		stages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+		bindings = { BINDING_MESHLETS, BINDING_VERTICES, BINDING_MESHLET_VERTICES, BINDING_MESHLET_TRIANGLES };
+	}
+#endif
+
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings(bindings.size());
+	for (size_t i = 0; i < bindings.size(); ++i)
+	{
+		layoutBindings[i] = {};
+		layoutBindings[i].binding = bindings[i];
+		layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		layoutBindings[i].descriptorCount = 1;
+		layoutBindings[i].stageFlags = stages;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
+	setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+	setLayoutCreateInfo.pBindings = layoutBindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// -- DESCRIPTOR POOL --
+	// One set per mesh, freed individually when the mesh is destroyed
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = MAX_MESHES * static_cast<uint32_t>(bindings.size());
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolCreateInfo.maxSets = MAX_MESHES;
+	poolCreateInfo.poolSizeCount = 1;
+	poolCreateInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+
+	// -- PIPELINE LAYOUT --
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = stages;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(ClusterCullParams);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+
+	try
+	{
+		if (bMeshShaders)
+		{
+			CreateMeshPipeline(shaderModuleCache, pipelineCache, baseDesc);
+		}
+		else
+		{
+			CreateComputePipeline(shaderModuleCache, pipelineCache);
+		}
+	}
+	catch (...)
+	{
+		// Destructor doesn't run for a constructor that throws
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		throw;
+	}
+}
+
+ClusterRenderer::~ClusterRenderer()
+{
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+void ClusterRenderer::CreateComputePipeline(ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache)
+{
+	VkPipelineShaderStageCreateInfo stageCreateInfo = {};
+	stageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageCreateInfo.module = shaderModuleCache->GetModule("Shaders/cluster_cull.spv");
+	stageCreateInfo.pName = "main";
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = stageCreateInfo;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the cluster culling Compute Pipeline!");
+	}
+}
+
+void ClusterRenderer::CreateMeshPipeline(ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache, const GraphicsPipelineDesc& baseDesc)
+{
+#ifdef VK_EXT_mesh_shader
+	pfnCmdDrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT"));
+	if (pfnCmdDrawMeshTasks == nullptr)
+	{
+		throw std::runtime_error("Failed to load vkCmdDrawMeshTasksEXT!");
+	}
+
+	// Same fixed function state and fragment shader as the scene, task + mesh shaders in place of vertex input
+	GraphicsPipelineDesc desc = baseDesc;
+	desc.vertexShader = VK_NULL_HANDLE;
+	desc.taskShader = shaderModuleCache->GetModule("Shaders/meshlet_task.spv");
+	desc.meshShader = shaderModuleCache->GetModule("Shaders/meshlet_mesh.spv");
+	desc.layout = pipelineLayout;
+	desc.vertexLayout = VertexLayout();
+
+	PipelineCompiler::CreateGraphicsPipelines(device, pipelineCache, &desc, 1, &pipeline);
+#else
+	(void)shaderModuleCache;
+	(void)pipelineCache;
+	(void)baseDesc;
+	throw std::runtime_error("Failed to create the mesh shader pipeline, built without VK_EXT_mesh_shader!");
+#endif
+}
+
+bool ClusterRenderer::CanDraw(const Mesh& mesh) const
+{
+	if (mesh.meshletCount == 0 || mesh.clusterDescriptorSet == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	return !bMeshShaders || HasShaderVertices(mesh);
+}
+
+void ClusterRenderer::CreateMeshResources(Mesh& mesh, GpuAllocator* allocator)
+{
+	PROFILE_FUNCTION();
+
+	if (mesh.meshletCount == 0 || (bMeshShaders && !HasShaderVertices(mesh)))
+	{
+		return;
+	}
+
+	std::vector<VkDescriptorBufferInfo> bufferInfos;
+	std::vector<uint32_t> bindings;
+	bufferInfos.push_back({ mesh.meshletBuffer, 0, VK_WHOLE_SIZE });
+	bindings.push_back(BINDING_MESHLETS);
+
+	if (bMeshShaders)
+	{
+		bufferInfos.push_back({ mesh.vertexBuffers[0], 0, VK_WHOLE_SIZE });
+		bindings.push_back(BINDING_VERTICES);
+		bufferInfos.push_back({ mesh.meshletVertexBuffer, 0, VK_WHOLE_SIZE });
+		bindings.push_back(BINDING_MESHLET_VERTICES);
+		bufferInfos.push_back({ mesh.meshletTriangleBuffer, 0, VK_WHOLE_SIZE });
+		bindings.push_back(BINDING_MESHLET_TRIANGLES);
+	}
+	else
+	{
+		// Written by the cull shader, read by the indirect draw
+		mesh.drawCommandBuffer = allocator->CreateBuffer(mesh.meshletCount * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, MemoryUsage::GpuOnly, &mesh.drawCommandAllocation);
+		mesh.drawCountBuffer = allocator->CreateBuffer(sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuOnly, &mesh.drawCountAllocation);
+
+		bufferInfos.push_back({ mesh.drawCommandBuffer, 0, VK_WHOLE_SIZE });
+		bindings.push_back(BINDING_DRAW_COMMANDS);
+		bufferInfos.push_back({ mesh.drawCountBuffer, 0, VK_WHOLE_SIZE });
+		bindings.push_back(BINDING_DRAW_COUNT);
+	}
+
+	VkDescriptorSetAllocateInfo setAllocateInfo = {};
+	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocateInfo.descriptorPool = descriptorPool;
+	setAllocateInfo.descriptorSetCount = 1;
+	setAllocateInfo.pSetLayouts = &descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(device, &setAllocateInfo, &mesh.clusterDescriptorSet) != VK_SUCCESS)
+	{
+		DestroyMeshResources(mesh, allocator);
+		throw std::runtime_error("Failed to allocate a cluster Descriptor Set!");
+	}
+
+	std::vector<VkWriteDescriptorSet> writes(bufferInfos.size());
+	for (size_t i = 0; i < writes.size(); ++i)
+	{
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = mesh.clusterDescriptorSet;
+		writes[i].dstBinding = bindings[i];
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void ClusterRenderer::DestroyMeshResources(Mesh& mesh, GpuAllocator* allocator)
+{
+	if (mesh.clusterDescriptorSet != VK_NULL_HANDLE)
+	{
+		vkFreeDescriptorSets(device, descriptorPool, 1, &mesh.clusterDescriptorSet);
+		mesh.clusterDescriptorSet = VK_NULL_HANDLE;
+	}
+	if (mesh.drawCommandBuffer != VK_NULL_HANDLE)
+	{
+		allocator->DestroyBuffer(mesh.drawCommandBuffer, mesh.drawCommandAllocation);
+		mesh.drawCommandBuffer = VK_NULL_HANDLE;
+	}
+	if (mesh.drawCountBuffer != VK_NULL_HANDLE)
+	{
+		allocator->DestroyBuffer(mesh.drawCountBuffer, mesh.drawCountAllocation);
+		mesh.drawCountBuffer = VK_NULL_HANDLE;
+	}
+}
+
+void ClusterRenderer::RecordCull(VkCommandBuffer commandBuffer, const Mesh& mesh, const ClusterCullParams& cullParams)
+{
+	if (bMeshShaders)
+	{
+		// Task shader culls while drawing
+		return;
+	}
+
+	ClusterCullParams params = cullParams;
+	params.meshletCount = mesh.meshletCount;
+	params.bCompact = bDrawIndirectCount ? 1 : 0;
+
+	// Previous frame's indirect draw must have read the commands and count before they are overwritten
+	VkMemoryBarrier readBarrier = {};
+	readBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	readBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	readBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &readBarrier, 0, nullptr, 0, nullptr);
+
+	if (params.bCompact)
+	{
+		vkCmdFillBuffer(commandBuffer, mesh.drawCountBuffer, 0, sizeof(uint32_t), 0);
+
+		VkBufferMemoryBarrier countBarrier = {};
+		countBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		countBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		countBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		countBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		countBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		countBarrier.buffer = mesh.drawCountBuffer;
+		countBarrier.offset = 0;
+		countBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &countBarrier, 0, nullptr);
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &mesh.clusterDescriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterCullParams), &params);
+	vkCmdDispatch(commandBuffer, (mesh.meshletCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	// Commands and count are ready for the indirect draw
+	VkMemoryBarrier drawBarrier = {};
+	drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void ClusterRenderer::RecordDraw(VkCommandBuffer commandBuffer, const Mesh& mesh, const ClusterCullParams& cullParams, VkPipeline scenePipeline)
+{
+#ifdef VK_EXT_mesh_shader
+	if (bMeshShaders)
+	{
+		ClusterCullParams params = cullParams;
+		params.meshletCount = mesh.meshletCount;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &mesh.clusterDescriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(ClusterCullParams), &params);
+		pfnCmdDrawMeshTasks(commandBuffer, (mesh.meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, 1, 1);
+		return;
+	}
+#else
+	(void)cullParams;
+#endif
+
+	// Culled meshlets as indexed draws of the mesh's own buffers
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenePipeline);
+
+	std::vector<VkDeviceSize> offsets(mesh.vertexBuffers.size(), 0);
+	vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(mesh.vertexBuffers.size()), mesh.vertexBuffers.data(), offsets.data());
+	vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (bDrawIndirectCount)
+	{
+		vkCmdDrawIndexedIndirectCount(commandBuffer, mesh.drawCommandBuffer, 0, mesh.drawCountBuffer, 0, mesh.meshletCount, stride);
+	}
+	else if (bMultiDrawIndirect)
+	{
+		vkCmdDrawIndexedIndirect(commandBuffer, mesh.drawCommandBuffer, 0, mesh.meshletCount, stride);
+	}
+	else
+	{
+		// One draw per indirect call without multiDrawIndirect
+		for (uint32_t i = 0; i < mesh.meshletCount; ++i)
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, mesh.drawCommandBuffer, i * stride, 1, stride);
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include <GLM/glm.hpp>
+
+#include "Mesh.h"
+#include "GpuAllocator.h"
+#include "PipelineCompiler.h"
+#include "ShaderModuleCache.h"
+#include "Utilities.h"
+
+// Push constants of the culling shaders (must match Shaders/cluster_common.glsl)
+struct ClusterCullParams
+{
+	glm::vec4			frustumPlanes[6];		// xyz = inward normal, w = distance
+	glm::vec4			camera;					// w = 1: xyz = position, w = 0: xyz = view direction (orthographic)
+	uint32_t			meshletCount = 0;
+	uint32_t			bCompact = 0;
+	uint32_t			padding[2] = {};
+
+	// Planes of the clip volume of viewProjection (Vulkan depth range 0..1)
+	static ClusterCullParams FromViewProjection(const glm::mat4& viewProjection, const glm::vec4& camera);
+};
+
+// Cluster (meshlet) culling and drawing
+// With VK_EXT_mesh_shader a task shader culls meshlets by frustum and normal cone and launches a mesh shader
+// workgroup per visible one. Otherwise a compute shader writes an indexed indirect draw per visible meshlet,
+// which are drawn with the scene pipeline from the mesh's own vertex and index buffers.
+class ClusterRenderer
+{
+public:
+	// Throws if a shader is missing, the renderer then draws meshes without cluster culling
+	ClusterRenderer(VkDevice device, const DeviceSupport& support, bool bAllowMeshShaders, ShaderModuleCache* shaderModuleCache,
+		VkPipelineCache pipelineCache, const GraphicsPipelineDesc& baseDesc);
+	~ClusterRenderer();
+
+	bool				UsesMeshShaders() const { return bMeshShaders; }
+
+	// Meshes must have meshlets, and for mesh shaders the Interleaved layout of Vertex
+	bool				CanDraw(const Mesh& mesh) const;
+
+	// Per mesh buffers and descriptor set of the path in use
+	void				CreateMeshResources(Mesh& mesh, GpuAllocator* allocator);
+	void				DestroyMeshResources(Mesh& mesh, GpuAllocator* allocator);
+
+	// Compute path: cull in to the mesh's draw commands (outside a render pass), no-op with mesh shaders
+	void				RecordCull(VkCommandBuffer commandBuffer, const Mesh& mesh, const ClusterCullParams& cullParams);
+
+	// Inside the render pass, scenePipeline is only used by the compute path
+	void				RecordDraw(VkCommandBuffer commandBuffer, const Mesh& mesh, const ClusterCullParams& cullParams, VkPipeline scenePipeline);
+
+private:
+	// Most meshes with cluster resources alive at once
+	static const uint32_t	MAX_MESHES = 256;
+
+	VkDevice			device;
+	bool				bMeshShaders;
+	bool				bMultiDrawIndirect;
+	bool				bDrawIndirectCount;
+
+	VkDescriptorSetLayout	descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool	descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout	pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline			pipeline = VK_NULL_HANDLE;			// Cull compute pipeline, or task + mesh graphics pipeline
+
+#ifdef VK_EXT_mesh_shader
+	PFN_vkCmdDrawMeshTasksEXT	pfnCmdDrawMeshTasks = nullptr;
+#endif
+
+	void				CreateComputePipeline(ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache);
+	void				CreateMeshPipeline(ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache, const GraphicsPipelineDesc& baseDesc);
+};
@@ -0,0 +1,111 @@
+#include "CommandAllocator.h"
+#include "CpuProfiler.h"
+
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+CommandAllocator::CommandAllocator(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t threadCount)
+	: device(device), threadCount(threadCount)
+{
+	if (this->threadCount == 0)
+	{
+		this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Transient: buffers live for one frame, and the pool is reset instead of each buffer
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	pools.resize(static_cast<size_t>(frameCount) * this->threadCount);
+	for (PoolContext& context : pools)
+	{
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &context.pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Command Pool!");
+		}
+	}
+}
+
+CommandAllocator::~CommandAllocator()
+{
+	// Destroying a pool frees its buffers
+	for (PoolContext& context : pools)
+	{
+		vkDestroyCommandPool(device, context.pool, nullptr);
+	}
+}
+
+void CommandAllocator::ResetFrame(uint32_t frameIndex)
+{
+	PROFILE_FUNCTION();
+
+	for (uint32_t thread = 0; thread < threadCount; ++thread)
+	{
+		PoolContext& context = pools[frameIndex * threadCount + thread];
+
+		// Nothing recorded from this pool since its last reset
+		if (context.usedCount[0] == 0 && context.usedCount[1] == 0)
+		{
+			continue;
+		}
+
+		vkResetCommandPool(device, context.pool, 0);
+		context.usedCount[0] = 0;
+		context.usedCount[1] = 0;
+		context.stats.poolResets++;
+	}
+}
+
+VkCommandBuffer CommandAllocator::Allocate(uint32_t frameIndex, uint32_t thread, VkCommandBufferLevel level)
+{
+	PoolContext& context = pools[frameIndex * threadCount + thread];
+	const int list = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+	std::vector<VkCommandBuffer>& buffers = context.buffers[list];
+	uint32_t& usedCount = context.usedCount[list];
+
+	if (usedCount < buffers.size())
+	{
+		context.stats.recycledBuffers++;
+		return buffers[usedCount++];
+	}
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = context.pool;
+	allocInfo.level = level;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Command Buffers!");
+	}
+	context.stats.allocatedBuffers++;
+
+	buffers.push_back(commandBuffer);
+	usedCount++;
+	return commandBuffer;
+}
+
+CommandAllocator::Stats CommandAllocator::GetStats() const
+{
+	Stats total;
+	for (const PoolContext& context : pools)
+	{
+		total.allocatedBuffers += context.stats.allocatedBuffers;
+		total.recycledBuffers += context.stats.recycledBuffers;
+		total.poolResets += context.stats.poolResets;
+	}
+	return total;
+}
+
+void CommandAllocator::ResetStats()
+{
+	for (PoolContext& context : pools)
+	{
+		context.stats = Stats();
+	}
+}
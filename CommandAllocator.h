@@ -0,0 +1,53 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+// Per-frame command buffer allocator
+// Every frame slot has one command pool per recording thread. Buffers are never freed one at a time: once the slot's fence
+// has signalled its pools are reset whole, and the buffers they already hold are handed out again, so a steady frame
+// allocates nothing from the driver.
+class CommandAllocator
+{
+public:
+	struct Stats
+	{
+		uint64_t			allocatedBuffers = 0;		// vkAllocateCommandBuffers calls (a pool had to grow)
+		uint64_t			recycledBuffers = 0;		// Buffers handed out again after a reset
+		uint64_t			poolResets = 0;
+	};
+
+	// threadCount 0 = one per hardware thread
+	CommandAllocator(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t threadCount = 0);
+	~CommandAllocator();
+
+	// Recycle every buffer of the frame slot
+	// The slot's last submission must have completed and no thread may be allocating from it
+	void				ResetFrame(uint32_t frameIndex);
+
+	// Buffer ready to begin, valid until the frame slot is next reset
+	// A thread index must only be used by one thread at a time, different indices need no locking
+	VkCommandBuffer		Allocate(uint32_t frameIndex, uint32_t thread, VkCommandBufferLevel level);
+
+	uint32_t			GetThreadCount() const { return threadCount; }
+
+	// Totals of every pool, only while no thread is allocating
+	Stats				GetStats() const;
+	void				ResetStats();
+
+private:
+	// Pool of one thread in one frame slot, with the buffers it has allocated so far (primary and secondary)
+	struct PoolContext
+	{
+		VkCommandPool					pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer>	buffers[2];
+		uint32_t						usedCount[2] = {};
+		Stats							stats;
+	};
+
+	VkDevice			device;
+	uint32_t			threadCount;
+	std::vector<PoolContext> pools;						// frameIndex * threadCount + thread
+};
@@ -0,0 +1,164 @@
+#include "CommandRecorder.h"
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+CommandRecorder::CommandRecorder(CommandAllocator* commandAllocator)
+	: commandAllocator(commandAllocator), threadCount(commandAllocator->GetThreadCount())
+{
+	for (uint32_t slice = 1; slice < this->threadCount; ++slice)
+	{
+		workers.emplace_back(&CommandRecorder::WorkerLoop, this, slice);
+	}
+}
+
+CommandRecorder::~CommandRecorder()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		bStopping = true;
+	}
+	jobCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+const std::vector<VkCommandBuffer>& CommandRecorder::Record(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance,
+	uint32_t itemCount, uint32_t sliceCount, const RecordFunction& record)
+{
+	PROFILE_FUNCTION();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	sliceCount = std::max(1u, std::min(sliceCount, threadCount));
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		job = &record;
+		jobInheritance = &inheritance;
+		jobFrame = frameIndex;
+		jobItemCount = itemCount;
+		jobThreadCount = sliceCount;
+		jobError.clear();
+		recorded.assign(sliceCount, VK_NULL_HANDLE);
+		pendingSlices = sliceCount - 1;
+		++jobGeneration;
+	}
+	jobCondition.notify_all();
+
+	// First slice here, so one thread fewer is woken than there are slices
+	std::string error;
+	try
+	{
+		RecordSlice(0);
+	}
+	catch (const std::runtime_error& e)
+	{
+		error = e.what();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(jobMutex);
+		doneCondition.wait(lock, [this] { return pendingSlices == 0; });
+		if (error.empty())
+		{
+			error = jobError;
+		}
+		job = nullptr;
+		jobInheritance = nullptr;
+	}
+	if (!error.empty())
+	{
+		throw std::runtime_error(error);
+	}
+
+	stats.recordCount++;
+	stats.itemCount += itemCount;
+	stats.recordMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	return recorded;
+}
+
+CommandRecorder::Stats CommandRecorder::GetStats()
+{
+	return stats;
+}
+
+void CommandRecorder::ResetStats()
+{
+	stats = Stats();
+}
+
+void CommandRecorder::WorkerLoop(uint32_t slice)
+{
+	PROFILE_THREAD_NAME("CommandRecorder");
+
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobCondition.wait(lock, [&] { return bStopping || jobGeneration != seenGeneration; });
+
+			if (bStopping)
+			{
+				break;
+			}
+
+			// Fewer slices than threads this time
+			seenGeneration = jobGeneration;
+			if (slice >= jobThreadCount)
+			{
+				continue;
+			}
+		}
+
+		try
+		{
+			RecordSlice(slice);
+		}
+		catch (const std::runtime_error& e)
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			jobError = e.what();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			--pendingSlices;
+		}
+		doneCondition.notify_one();
+	}
+}
+
+void CommandRecorder::RecordSlice(uint32_t slice)
+{
+	PROFILE_FUNCTION();
+
+	VkCommandBuffer commandBuffer = commandAllocator->Allocate(jobFrame, slice, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = jobInheritance;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording a Command Buffer!");
+	}
+
+	uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(jobItemCount) * slice / jobThreadCount);
+	uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(jobItemCount) * (slice + 1) / jobThreadCount);
+	(*job)(commandBuffer, first, end);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Command Buffer!");
+	}
+
+	recorded[slice] = commandBuffer;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "CommandAllocator.h"
+
+// Parallel command recording service
+// Work is split in to one slice per thread and each slice is recorded in to a secondary command buffer continuing a render
+// pass, for the primary buffer to execute in slice order. Slice i allocates from thread i's pools of the command allocator,
+// so recording needs no locking.
+class CommandRecorder
+{
+public:
+	// Record items [first, end) in to a secondary command buffer (begun and ended by the recorder)
+	// Secondary buffers inherit nothing but the render pass: pipeline and dynamic state must be set by every slice
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t end)>;
+
+	struct Stats
+	{
+		uint64_t			recordCount = 0;
+		uint64_t			itemCount = 0;
+		double				recordMs = 0.0;				// Wall time of Record calls
+	};
+
+	// One thread per allocator thread, the thread calling Record is one of them
+	CommandRecorder(CommandAllocator* commandAllocator);
+	~CommandRecorder();
+
+	// Record every item over threadCount threads (clamped to 1..GetThreadCount()), blocking until all are recorded
+	// Buffers come from the frame slot's pools and stay valid until the allocator resets it
+	const std::vector<VkCommandBuffer>&	Record(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance,
+		uint32_t itemCount, uint32_t threadCount, const RecordFunction& record);
+
+	uint32_t			GetThreadCount() const { return threadCount; }
+	Stats				GetStats();
+	void				ResetStats();
+
+private:
+	CommandAllocator*	commandAllocator;
+	uint32_t			threadCount;
+
+	// Current job, read by the workers while it is in progress
+	const RecordFunction*	job = nullptr;
+	const VkCommandBufferInheritanceInfo* jobInheritance = nullptr;
+	uint32_t			jobFrame = 0;
+	uint32_t			jobItemCount = 0;
+	uint32_t			jobThreadCount = 0;
+	std::vector<VkCommandBuffer> recorded;				// Slice order
+	std::string			jobError;
+
+	std::vector<std::thread> workers;					// Worker i records slice i + 1
+	std::mutex			jobMutex;
+	std::condition_variable	jobCondition;
+	std::condition_variable	doneCondition;
+	uint64_t			jobGeneration = 0;
+	uint32_t			pendingSlices = 0;
+	bool				bStopping = false;
+
+	Stats				stats;
+
+	void				WorkerLoop(uint32_t slice);
+	void				RecordSlice(uint32_t slice);
+};
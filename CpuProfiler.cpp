@@ -0,0 +1,184 @@
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+std::mutex CpuProfiler::registryMutex;
+std::vector<std::unique_ptr<CpuProfiler::ThreadBuffer>> CpuProfiler::threadBuffers;
+std::vector<CpuProfiler::ThreadBuffer*> CpuProfiler::freeBuffers;
+uint32_t CpuProfiler::nextThreadId = 1;
+
+uint64_t CpuProfiler::Now()
+{
+	static const std::chrono::steady_clock::time_point timeBase = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timeBase).count();
+}
+
+void CpuProfiler::Record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	// Only this thread writes, so a relaxed load of our own index is enough
+	uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+	buffer.zones[index & (RING_CAPACITY - 1)] = { name, startNs, endNs };
+
+	// Publish the zone to the trace writer
+	buffer.writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer.segments.back().threadName = name;
+}
+
+// Names are written as JSON strings, so quotes, backslashes and control characters must be escaped
+static void WriteJsonString(std::ofstream& file, const char* text)
+{
+	file << '"';
+	for (const char* c = text; *c != '\0'; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			file << '\\' << *c;
+		}
+		else if (static_cast<unsigned char>(*c) < 0x20)
+		{
+			file << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(*c) << std::dec << std::setfill(' ');
+		}
+		else
+		{
+			file << *c;
+		}
+	}
+	file << '"';
+}
+
+void CpuProfiler::WriteChromeTrace(const std::string& fileName)
+{
+	std::ofstream file(fileName);
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[\n";
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	bool bFirst = true;
+	for (const auto& buffer : threadBuffers)
+	{
+		// Snapshot how far the owning thread has published, only zones before it are read
+		uint64_t endIndex = buffer->writeIndex.load(std::memory_order_acquire);
+
+		// Nothing was ever recorded on this slot, leave it out of the trace
+		if (endIndex == 0)
+		{
+			continue;
+		}
+
+		for (const ThreadSegment& segment : buffer->segments)
+		{
+			if (segment.threadName != nullptr)
+			{
+				file << (bFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << segment.threadId << ",\"args\":{\"name\":";
+				WriteJsonString(file, segment.threadName);
+				file << "}}";
+				bFirst = false;
+			}
+		}
+
+		// Copy what's there, then drop anything the owning thread overwrote (or may still be writing) while we were copying
+		// (trace is normally written once the frame loop has stopped, so this rarely drops anything)
+		uint64_t beginIndex = endIndex > RING_CAPACITY ? endIndex - RING_CAPACITY : 0;
+
+		std::vector<Zone> zones;
+		zones.reserve(static_cast<size_t>(endIndex - beginIndex));
+		for (uint64_t i = beginIndex; i < endIndex; ++i)
+		{
+			zones.push_back(buffer->zones[i & (RING_CAPACITY - 1)]);
+		}
+
+		// Copies must be done before the index is read again, as with a sequence lock
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		// With the writer at index W, slots up to and including W's have been reused, so indices up to W - RING_CAPACITY are invalid
+		uint64_t overwrittenIndex = buffer->writeIndex.load(std::memory_order_relaxed) + 1;
+		size_t firstValid = overwrittenIndex > beginIndex + RING_CAPACITY
+			? static_cast<size_t>(std::min(overwrittenIndex - RING_CAPACITY - beginIndex, endIndex - beginIndex)) : 0;
+
+		// Complete events, timestamps in microseconds, each under the id of the thread that recorded it
+		size_t segment = 0;
+		for (size_t i = firstValid; i < zones.size(); ++i)
+		{
+			while (segment + 1 < buffer->segments.size() && buffer->segments[segment + 1].beginIndex <= beginIndex + i)
+			{
+				++segment;
+			}
+
+			file << (bFirst ? "" : ",\n") << "{\"name\":";
+			WriteJsonString(file, zones[i].name);
+			file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->segments[segment].threadId
+				<< ",\"ts\":" << zones[i].startNs / 1000.0 << ",\"dur\":" << (zones[i].endNs - zones[i].startNs) / 1000.0 << "}";
+			bFirst = false;
+		}
+	}
+
+	file << "\n]}\n";
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::GetThreadBuffer()
+{
+	// Registered once per thread, every later zone goes straight to the buffer
+	thread_local ThreadBufferOwner owner;
+	if (owner.buffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		if (!freeBuffers.empty())
+		{
+			// Reuse a finished thread's ring, its zones stay in the trace under its own id and name until overwritten
+			owner.buffer = freeBuffers.back();
+			freeBuffers.pop_back();
+
+			// Forget segments that are empty or whose zones have all been overwritten
+			std::vector<ThreadSegment>& segments = owner.buffer->segments;
+			uint64_t index = owner.buffer->writeIndex.load(std::memory_order_relaxed);
+			uint64_t oldestIndex = index > RING_CAPACITY ? index - RING_CAPACITY : 0;
+			if (segments.back().beginIndex == index)
+			{
+				segments.pop_back();
+			}
+			while (segments.size() > 1 && segments[1].beginIndex <= oldestIndex)
+			{
+				segments.erase(segments.begin());
+			}
+
+			ThreadSegment segment;
+			segment.beginIndex = index;
+			segment.threadId = nextThreadId++;
+			segments.push_back(segment);
+		}
+		else
+		{
+			threadBuffers.push_back(std::make_unique<ThreadBuffer>());
+			owner.buffer = threadBuffers.back().get();
+
+			ThreadSegment segment;
+			segment.threadId = nextThreadId++;
+			owner.buffer->segments.push_back(segment);
+		}
+	}
+
+	return *owner.buffer;
+}
+
+CpuProfiler::ThreadBufferOwner::~ThreadBufferOwner()
+{
+	// Thread-locals are destroyed before statics, so the registry is still alive here
+	if (buffer != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		freeBuffers.push_back(buffer);
+	}
+}
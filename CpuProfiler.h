@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Set to 0 to compile every profiling macro out (no timer reads, no thread-local lookups)
+#ifndef GENIX_CPU_PROFILER_ENABLED
+#define GENIX_CPU_PROFILER_ENABLED 1
+#endif
+
+// CPU zone profiler
+// Every thread records completed zones into its own ring buffer, so recording never takes a lock.
+// Zone names must be string literals (or otherwise outlive the profiler), only the pointer is stored.
+class CpuProfiler
+{
+public:
+	struct Zone
+	{
+		const char*		name;
+		uint64_t		startNs;
+		uint64_t		endNs;
+	};
+
+	// Nanoseconds since the profiler's time base (first use)
+	static uint64_t		Now();
+
+	// Record a completed zone for the calling thread
+	static void			Record(const char* name, uint64_t startNs, uint64_t endNs);
+
+	// Name shown for the calling thread in the trace viewer
+	static void			SetThreadName(const char* name);
+
+	// Write every zone still held in the ring buffers as chrome://tracing / Perfetto JSON
+	static void			WriteChromeTrace(const std::string& fileName);
+
+private:
+	// Zones per thread before the oldest are overwritten (power of two)
+	static const uint32_t RING_CAPACITY = 1 << 16;
+
+	// Zones recorded into a buffer by one thread, from beginIndex until the next segment starts
+	struct ThreadSegment
+	{
+		uint64_t				beginIndex = 0;
+		uint32_t				threadId = 0;
+		const char*				threadName = nullptr;
+	};
+
+	// Single producer (owning thread), single consumer (trace writer)
+	struct ThreadBuffer
+	{
+		std::vector<Zone>		zones = std::vector<Zone>(RING_CAPACITY);
+		std::atomic<uint64_t>	writeIndex { 0 };
+		std::vector<ThreadSegment> segments;			// Oldest first, last is the owning thread (guarded by registryMutex)
+	};
+
+	// Hands the calling thread's buffer back to the free list when the thread exits
+	struct ThreadBufferOwner
+	{
+		ThreadBuffer*			buffer = nullptr;
+		~ThreadBufferOwner();
+	};
+
+	// Buffers are owned here and outlive their threads, so zones of finished workers still get written.
+	// A finished thread's buffer is reused (as a new segment with its own thread id) by the next thread that registers,
+	// so memory is bounded by the peak number of live threads rather than by every thread ever started
+	static std::mutex							registryMutex;
+	static std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+	static std::vector<ThreadBuffer*>			freeBuffers;
+	static uint32_t								nextThreadId;
+
+	static ThreadBuffer&	GetThreadBuffer();
+};
+
+// Records the time between construction and destruction as one zone
+class CpuProfileZone
+{
+public:
+	explicit CpuProfileZone(const char* name) : name(name), startNs(CpuProfiler::Now()) {}
+	~CpuProfileZone() { CpuProfiler::Record(name, startNs, CpuProfiler::Now()); }
+
+	CpuProfileZone(const CpuProfileZone&) = delete;
+	CpuProfileZone& operator=(const CpuProfileZone&) = delete;
+
+private:
+	const char*			name;
+	uint64_t			startNs;
+};
+
+#define GENIX_PROFILE_CONCAT_INNER(a, b) a##b
+#define GENIX_PROFILE_CONCAT(a, b) GENIX_PROFILE_CONCAT_INNER(a, b)
+
+#if GENIX_CPU_PROFILER_ENABLED
+#define PROFILE_ZONE(name)			CpuProfileZone GENIX_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION()			PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name)	CpuProfiler::SetThreadName(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#endif
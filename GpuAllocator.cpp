@@ -0,0 +1,570 @@
+#include "GpuAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// -- TLSF --
+// Free ranges are kept in lists indexed by size class: first level = power of two, second level = 2^SL_BITS
+// linear subdivisions of it. Bitmaps of non-empty lists make finding a fitting list two bit scans.
+static const uint32_t SL_BITS = 5;
+static const uint32_t SL_COUNT = 1 << SL_BITS;
+static const uint32_t FL_OFFSET = 8;									// Sizes below 2^FL_OFFSET all go in first level 0
+static const VkDeviceSize SMALL_SIZE = 1ULL << FL_OFFSET;
+static const uint32_t FL_COUNT = 64 - FL_OFFSET + 1;
+
+// Smallest range worth splitting off as a free node
+static const VkDeviceSize MIN_NODE_SIZE = 256;
+
+static uint32_t BitScanReverse(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+static uint32_t BitScanForward(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+// Size class a range of this size belongs to
+static void MapSize(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+	if (size < SMALL_SIZE)
+	{
+		fl = 0;
+		sl = static_cast<uint32_t>(size / (SMALL_SIZE / SL_COUNT));
+	}
+	else
+	{
+		uint32_t log2 = BitScanReverse(size);
+		sl = static_cast<uint32_t>(size >> (log2 - SL_BITS)) ^ SL_COUNT;
+		fl = log2 - FL_OFFSET + 1;
+	}
+}
+
+// Smallest size class whose ranges are all at least this size
+static void MapSizeRoundUp(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+	if (size < SMALL_SIZE)
+	{
+		VkDeviceSize step = SMALL_SIZE / SL_COUNT;
+		size = (size + step - 1) & ~(step - 1);
+	}
+	else
+	{
+		size += (1ULL << (BitScanReverse(size) - SL_BITS)) - 1;
+	}
+	MapSize(size, fl, sl);
+}
+
+// Contiguous range of a block, free or allocated
+struct MemoryNode
+{
+	VkDeviceSize		offset = 0;
+	VkDeviceSize		size = 0;
+	bool				bFree = true;
+
+	// Neighbours in address order
+	MemoryNode*			prevPhysical = nullptr;
+	MemoryNode*			nextPhysical = nullptr;
+
+	// Neighbours in the same free list
+	MemoryNode*			prevFree = nullptr;
+	MemoryNode*			nextFree = nullptr;
+};
+
+struct MemoryBlock
+{
+	VkDeviceMemory		memory = VK_NULL_HANDLE;
+	VkDeviceSize		size = 0;
+	void*				pMapped = nullptr;
+	uint32_t			memoryTypeIndex = 0;
+	bool				bLinear = true;
+
+	uint32_t			allocationCount = 0;
+	VkDeviceSize		usedBytes = 0;
+
+	uint64_t			flBitmap = 0;
+	uint32_t			slBitmap[FL_COUNT] = {};
+	MemoryNode*			freeLists[FL_COUNT][SL_COUNT] = {};
+
+	// Recycled nodes, so splitting doesn't hit the heap once the block has warmed up
+	std::vector<MemoryNode*> spareNodes;
+	std::vector<MemoryNode*> ownedNodes;
+
+	~MemoryBlock()
+	{
+		for (MemoryNode* node : ownedNodes)
+		{
+			delete node;
+		}
+	}
+
+	MemoryNode* NewNode()
+	{
+		if (spareNodes.empty())
+		{
+			ownedNodes.push_back(new MemoryNode());
+			return ownedNodes.back();
+		}
+
+		MemoryNode* node = spareNodes.back();
+		spareNodes.pop_back();
+		*node = MemoryNode();
+		return node;
+	}
+
+	void InsertFree(MemoryNode* node)
+	{
+		uint32_t fl, sl;
+		MapSize(node->size, fl, sl);
+
+		node->bFree = true;
+		node->prevFree = nullptr;
+		node->nextFree = freeLists[fl][sl];
+		if (node->nextFree != nullptr)
+		{
+			node->nextFree->prevFree = node;
+		}
+		freeLists[fl][sl] = node;
+
+		flBitmap |= 1ULL << fl;
+		slBitmap[fl] |= 1U << sl;
+	}
+
+	void RemoveFree(MemoryNode* node)
+	{
+		uint32_t fl, sl;
+		MapSize(node->size, fl, sl);
+
+		if (node->prevFree != nullptr)
+		{
+			node->prevFree->nextFree = node->nextFree;
+		}
+		else
+		{
+			freeLists[fl][sl] = node->nextFree;
+		}
+		if (node->nextFree != nullptr)
+		{
+			node->nextFree->prevFree = node->prevFree;
+		}
+
+		if (freeLists[fl][sl] == nullptr)
+		{
+			slBitmap[fl] &= ~(1U << sl);
+			if (slBitmap[fl] == 0)
+			{
+				flBitmap &= ~(1ULL << fl);
+			}
+		}
+
+		node->bFree = false;
+	}
+
+	// First free range in a size class at least as big as the requested one
+	MemoryNode* FindFree(VkDeviceSize size)
+	{
+		uint32_t fl, sl;
+		MapSizeRoundUp(size, fl, sl);
+		if (fl >= FL_COUNT)
+		{
+			return nullptr;
+		}
+
+		uint32_t slMap = sl < SL_COUNT ? slBitmap[fl] & (~0U << sl) : 0;
+		if (slMap == 0)
+		{
+			// Nothing in this first level, take the smallest non-empty one above it
+			uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ULL << (fl + 1)) : 0;
+			if (flMap == 0)
+			{
+				return nullptr;
+			}
+
+			fl = BitScanForward(flMap);
+			slMap = slBitmap[fl];
+		}
+
+		return freeLists[fl][BitScanForward(slMap)];
+	}
+
+	// Split the end of a node off in to a new free node
+	void SplitTail(MemoryNode* node, VkDeviceSize size)
+	{
+		MemoryNode* tail = NewNode();
+		tail->offset = node->offset + size;
+		tail->size = node->size - size;
+		tail->prevPhysical = node;
+		tail->nextPhysical = node->nextPhysical;
+		if (tail->nextPhysical != nullptr)
+		{
+			tail->nextPhysical->prevPhysical = tail;
+		}
+		node->nextPhysical = tail;
+		node->size = size;
+
+		InsertFree(tail);
+	}
+
+	// Merge a node with the one after it, the next node is recycled
+	void MergeNext(MemoryNode* node)
+	{
+		MemoryNode* next = node->nextPhysical;
+		node->size += next->size;
+		node->nextPhysical = next->nextPhysical;
+		if (node->nextPhysical != nullptr)
+		{
+			node->nextPhysical->prevPhysical = node;
+		}
+		spareNodes.push_back(next);
+	}
+
+	MemoryNode* Allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		// Searching for size + alignment - 1 guarantees the aligned range fits in whatever is found
+		MemoryNode* node = FindFree(size + alignment - 1);
+		if (node == nullptr)
+		{
+			return nullptr;
+		}
+		RemoveFree(node);
+
+		// Give the padding in front of the aligned offset back as its own free node
+		VkDeviceSize alignedOffset = (node->offset + alignment - 1) & ~(alignment - 1);
+		VkDeviceSize padding = alignedOffset - node->offset;
+		if (padding > 0)
+		{
+			SplitTail(node, padding);
+
+			// SplitTail put the aligned part in a free list, take it back out and free the padding instead
+			MemoryNode* aligned = node->nextPhysical;
+			RemoveFree(aligned);
+			InsertFree(node);
+			node = aligned;
+		}
+
+		if (node->size - size >= MIN_NODE_SIZE)
+		{
+			SplitTail(node, size);
+		}
+
+		++allocationCount;
+		usedBytes += node->size;
+		return node;
+	}
+
+	void Free(MemoryNode* node)
+	{
+		--allocationCount;
+		usedBytes -= node->size;
+
+		// Coalesce with free physical neighbours
+		if (node->nextPhysical != nullptr && node->nextPhysical->bFree)
+		{
+			RemoveFree(node->nextPhysical);
+			MergeNext(node);
+		}
+		if (node->prevPhysical != nullptr && node->prevPhysical->bFree)
+		{
+			MemoryNode* prev = node->prevPhysical;
+			RemoveFree(prev);
+			MergeNext(prev);
+			node = prev;
+		}
+
+		InsertFree(node);
+	}
+
+	VkDeviceSize LargestFree() const
+	{
+		if (flBitmap == 0)
+		{
+			return 0;
+		}
+
+		uint32_t fl = BitScanReverse(flBitmap);
+		VkDeviceSize largest = 0;
+		for (MemoryNode* node = freeLists[fl][BitScanReverse(slBitmap[fl])]; node != nullptr; node = node->nextFree)
+		{
+			largest = std::max(largest, node->size);
+		}
+		return largest;
+	}
+};
+
+double GpuAllocator::Stats::GetFragmentation() const
+{
+	VkDeviceSize freeBytes = blockBytes - usedBytes;
+	return freeBytes > 0 ? 1.0 - static_cast<double>(largestFreeRange) / freeBytes : 0.0;
+}
+
+GpuAllocator::GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+	: physicalDevice(physicalDevice), device(device), blockSize(blockSize)
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	maxAllocationCount = deviceProperties.limits.maxMemoryAllocationCount;
+}
+
+GpuAllocator::~GpuAllocator()
+{
+	for (auto& typePools : pools)
+	{
+		for (auto& pool : typePools)
+		{
+			for (MemoryBlock* block : pool)
+			{
+				DestroyBlock(block);
+			}
+		}
+	}
+}
+
+MemoryAllocation GpuAllocator::Allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool bLinear)
+{
+	uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, usage);
+	if (memoryTypeIndex == UINT32_MAX)
+	{
+		throw std::runtime_error("Failed to find a suitable memory type!");
+	}
+
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	std::vector<MemoryBlock*>& pool = pools[memoryTypeIndex][bLinear ? 0 : 1];
+	VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+	MemoryNode* node = nullptr;
+	MemoryBlock* block = nullptr;
+	for (MemoryBlock* candidate : pool)
+	{
+		node = candidate->Allocate(requirements.size, alignment);
+		if (node != nullptr)
+		{
+			block = candidate;
+			break;
+		}
+	}
+
+	// No room in existing blocks, resources bigger than a block get a block of their own size
+	if (node == nullptr)
+	{
+		block = CreateBlock(memoryTypeIndex, bLinear, std::max(blockSize, requirements.size + alignment));
+		pool.push_back(block);
+		node = block->Allocate(requirements.size, alignment);
+	}
+
+	MemoryAllocation allocation;
+	allocation.memory = block->memory;
+	allocation.offset = node->offset;
+	allocation.size = requirements.size;
+	allocation.pMapped = block->pMapped != nullptr ? static_cast<char*>(block->pMapped) + node->offset : nullptr;
+	allocation.block = block;
+	allocation.node = node;
+	return allocation;
+}
+
+void GpuAllocator::Free(MemoryAllocation& allocation)
+{
+	if (allocation.block == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	MemoryBlock* block = allocation.block;
+	block->Free(allocation.node);
+
+	// Give empty blocks back to the driver, but keep the last one of a pool to avoid allocation churn
+	std::vector<MemoryBlock*>& pool = pools[block->memoryTypeIndex][block->bLinear ? 0 : 1];
+	if (block->allocationCount == 0 && pool.size() > 1)
+	{
+		pool.erase(std::find(pool.begin(), pool.end(), block));
+		DestroyBlock(block);
+	}
+
+	allocation = MemoryAllocation();
+}
+
+VkBuffer GpuAllocator::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags bufferUsage, MemoryUsage memoryUsage, MemoryAllocation* allocation)
+{
+	// Information to create a buffer (doesn't include assigning memory)
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;										// Size of buffer (size of 1 vertex * number of vertices)
+	bufferInfo.usage = bufferUsage;								// Multiple types of buffer possible
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;			// Similar to Swap Chain images, can share vertex buffers
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+	*allocation = Allocate(memRequirements, memoryUsage, true);
+	vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset);
+
+	return buffer;
+}
+
+void GpuAllocator::DestroyBuffer(VkBuffer buffer, MemoryAllocation& allocation)
+{
+	vkDestroyBuffer(device, buffer, nullptr);
+	Free(allocation);
+}
+
+void GpuAllocator::AllocateImageMemory(VkImage image, VkImageTiling tiling, MemoryUsage memoryUsage, MemoryAllocation* allocation)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+	*allocation = Allocate(memRequirements, memoryUsage, tiling == VK_IMAGE_TILING_LINEAR);
+	vkBindImageMemory(device, image, allocation->memory, allocation->offset);
+}
+
+uint32_t GpuAllocator::FindMemoryType(uint32_t allowedTypes, MemoryUsage usage) const
+{
+	VkMemoryPropertyFlags required = 0;
+	VkMemoryPropertyFlags preferred = 0;
+	VkMemoryPropertyFlags avoided = 0;
+	switch (usage)
+	{
+	case MemoryUsage::GpuOnly:
+		required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;			// Keep small host visible device heaps (BAR) free for CpuToGpu
+		break;
+	case MemoryUsage::CpuToGpu:
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;			// Write combined is faster for memcpy in
+		break;
+	case MemoryUsage::GpuToCpu:
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;			// Reading uncached memory is very slow
+		break;
+	}
+
+	// Score every allowed type that has the required flags, best one wins
+	uint32_t bestIndex = UINT32_MAX;
+	int bestScore = -1;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+		if (!(allowedTypes & (1 << i)) || (flags & required) != required)
+		{
+			continue;
+		}
+
+		int score = 0;
+		if ((flags & preferred) == preferred)
+		{
+			score += 2;
+		}
+		if (!(flags & avoided))
+		{
+			score += 1;
+		}
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestIndex = i;
+		}
+	}
+
+	return bestIndex;
+}
+
+GpuAllocator::Stats GpuAllocator::GetStats()
+{
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	Stats stats;
+	for (auto& typePools : pools)
+	{
+		for (auto& pool : typePools)
+		{
+			for (MemoryBlock* block : pool)
+			{
+				++stats.blockCount;
+				stats.allocationCount += block->allocationCount;
+				stats.blockBytes += block->size;
+				stats.usedBytes += block->usedBytes;
+				stats.largestFreeRange = std::max(stats.largestFreeRange, block->LargestFree());
+			}
+		}
+	}
+
+	return stats;
+}
+
+MemoryBlock* GpuAllocator::CreateBlock(uint32_t memoryTypeIndex, bool bLinear, VkDeviceSize size)
+{
+	if (blockCount >= maxAllocationCount)
+	{
+		throw std::runtime_error("Reached maxMemoryAllocationCount!");
+	}
+
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = size;
+	memoryAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	MemoryBlock* block = new MemoryBlock();
+	if (vkAllocateMemory(device, &memoryAllocInfo, nullptr, &block->memory) != VK_SUCCESS)
+	{
+		delete block;
+		throw std::runtime_error("Failed to allocate a device memory block!");
+	}
+
+	block->size = size;
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->bLinear = bLinear;
+
+	// Host visible blocks stay mapped for their whole life
+	if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->pMapped);
+	}
+
+	// Whole block starts as one free range
+	MemoryNode* node = block->NewNode();
+	node->size = size;
+	block->InsertFree(node);
+
+	++blockCount;
+	return block;
+}
+
+void GpuAllocator::DestroyBlock(MemoryBlock* block)
+{
+	if (block->pMapped != nullptr)
+	{
+		vkUnmapMemory(device, block->memory);
+	}
+	vkFreeMemory(device, block->memory, nullptr);
+	delete block;
+
+	--blockCount;
+}
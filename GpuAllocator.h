@@ -0,0 +1,88 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <vector>
+
+struct MemoryBlock;
+struct MemoryNode;
+
+// What a resource's memory is used for, decides which memory type it is placed in
+enum class MemoryUsage
+{
+	GpuOnly,		// DEVICE_LOCAL, never mapped (render targets, vertex/index buffers, textures)
+	CpuToGpu,		// HOST_VISIBLE | HOST_COHERENT, persistently mapped, prefers DEVICE_LOCAL if available (staging, per frame data)
+	GpuToCpu		// HOST_VISIBLE | HOST_COHERENT, persistently mapped, prefers HOST_CACHED (readback)
+};
+
+// A range of a device memory block handed out by GpuAllocator
+struct MemoryAllocation
+{
+	VkDeviceMemory		memory = VK_NULL_HANDLE;	// Block the range lives in (bind with this and offset)
+	VkDeviceSize		offset = 0;
+	VkDeviceSize		size = 0;
+	void*				pMapped = nullptr;			// Start of the range if the block is host visible, otherwise nullptr
+
+	// Owner bookkeeping
+	MemoryBlock*		block = nullptr;
+	MemoryNode*			node = nullptr;
+};
+
+// Device memory allocator
+// Resources are sub-allocated from large blocks (one vkAllocateMemory per block) with a TLSF
+// (two-level segregated fit) allocator per block: allocating and freeing are O(1).
+// Linear (buffers, linear images) and optimal-tiling resources are kept in separate blocks, so
+// bufferImageGranularity never has to be considered between neighbours.
+class GpuAllocator
+{
+public:
+	struct Stats
+	{
+		uint32_t			blockCount = 0;
+		uint32_t			allocationCount = 0;
+		VkDeviceSize		blockBytes = 0;				// Device memory allocated from Vulkan
+		VkDeviceSize		usedBytes = 0;				// Handed out to resources
+		VkDeviceSize		largestFreeRange = 0;
+
+		// 0 = all free memory is one range, approaching 1 = free memory is split into many small ranges
+		double				GetFragmentation() const;
+	};
+
+	GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+	~GpuAllocator();
+
+	// bLinear: buffer or VK_IMAGE_TILING_LINEAR image, otherwise an optimal tiling image
+	MemoryAllocation	Allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool bLinear);
+	void				Free(MemoryAllocation& allocation);
+
+	// Create a resource and allocate and bind its memory
+	VkBuffer			CreateBuffer(VkDeviceSize size, VkBufferUsageFlags bufferUsage, MemoryUsage memoryUsage, MemoryAllocation* allocation);
+	void				DestroyBuffer(VkBuffer buffer, MemoryAllocation& allocation);
+	void				AllocateImageMemory(VkImage image, VkImageTiling tiling, MemoryUsage memoryUsage, MemoryAllocation* allocation);
+
+	// Memory type the allocator would use for the given usage (UINT32_MAX if none fits)
+	uint32_t			FindMemoryType(uint32_t allowedTypes, MemoryUsage usage) const;
+
+	Stats				GetStats();
+
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ULL * 1024 * 1024;
+
+private:
+	VkPhysicalDevice	physicalDevice;
+	VkDevice			device;
+	VkDeviceSize		blockSize;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	uint32_t			maxAllocationCount;
+
+	// One pool of blocks per memory type, for linear and for optimal resources
+	std::vector<MemoryBlock*> pools[VK_MAX_MEMORY_TYPES][2];
+	uint32_t			blockCount = 0;
+
+	std::mutex			allocatorMutex;
+
+	MemoryBlock*		CreateBlock(uint32_t memoryTypeIndex, bool bLinear, VkDeviceSize size);
+	void				DestroyBlock(MemoryBlock* block);
+};
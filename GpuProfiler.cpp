@@ -0,0 +1,186 @@
+#include "GpuProfiler.h"
+
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, int framesInFlight, uint32_t timestampValidBits, uint32_t maxScopesPerFrame)
+	: device(device), maxScopes(maxScopesPerFrame)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	// Queue family must write valid timestamps and the device must report their period
+	bEnabled = timestampValidBits > 0 && deviceProperties.limits.timestampPeriod > 0.0f;
+	if (!bEnabled)
+	{
+		return;
+	}
+
+	timestampPeriodNs = deviceProperties.limits.timestampPeriod;
+	timestampMask = timestampValidBits >= 64 ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+
+	// Query pool creation information (2 timestamps per scope)
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = maxScopes * 2;
+
+	frames.resize(framesInFlight);
+	for (auto& frame : frames)
+	{
+		if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a timestamp Query Pool!");
+		}
+	}
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (auto& frame : frames)
+	{
+		vkDestroyQueryPool(device, frame.queryPool, nullptr);
+	}
+}
+
+void GpuProfiler::BeginFrame(int frameIndex, VkCommandBuffer commandBuffer)
+{
+	if (!bEnabled)
+	{
+		return;
+	}
+
+	currentFrame = frameIndex;
+	FrameQueries& frame = frames[currentFrame];
+
+	// This frame slot's fence has been waited on, so its previous queries are complete
+	CollectResults(frame);
+
+	// Queries must be reset before they are written again
+	vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, maxScopes * 2);
+	frame.scopeNames.clear();
+}
+
+std::map<std::string, GpuProfiler::PassStats> GpuProfiler::GetStats() const
+{
+	std::map<std::string, PassStats> stats;
+
+	for (const auto& pass : samples)
+	{
+		if (pass.second.empty())
+		{
+			continue;
+		}
+
+		std::vector<double> sorted(pass.second.begin(), pass.second.end());
+		std::sort(sorted.begin(), sorted.end());
+
+		PassStats passStats;
+		passStats.sampleCount = sorted.size();
+		passStats.minMs = sorted.front();
+		passStats.avgMs = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+		passStats.p99Ms = sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * 0.99))];
+
+		stats[pass.first] = passStats;
+	}
+
+	return stats;
+}
+
+void GpuProfiler::DumpCSV(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	file << "pass,min_ms,avg_ms,p99_ms,samples\n";
+	for (const auto& pass : GetStats())
+	{
+		file << pass.first << "," << pass.second.minMs << "," << pass.second.avgMs << "," << pass.second.p99Ms << "," << pass.second.sampleCount << "\n";
+	}
+}
+
+void GpuProfiler::DumpJSON(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	file << "{\n  \"passes\": [";
+
+	bool bFirst = true;
+	for (const auto& pass : GetStats())
+	{
+		file << (bFirst ? "\n" : ",\n");
+		file << "    { \"name\": \"" << pass.first << "\", \"min_ms\": " << pass.second.minMs << ", \"avg_ms\": " << pass.second.avgMs
+			<< ", \"p99_ms\": " << pass.second.p99Ms << ", \"samples\": " << pass.second.sampleCount << " }";
+		bFirst = false;
+	}
+
+	file << "\n  ]\n}\n";
+}
+
+int GpuProfiler::BeginScope(const std::string& name)
+{
+	FrameQueries& frame = frames[currentFrame];
+	if (frame.scopeNames.size() >= maxScopes)
+	{
+		return -1;
+	}
+
+	frame.scopeNames.push_back(name);
+	return static_cast<int>(frame.scopeNames.size() - 1) * 2;
+}
+
+void GpuProfiler::CollectResults(FrameQueries& frame)
+{
+	if (frame.scopeNames.empty())
+	{
+		return;
+	}
+
+	uint32_t queryCount = static_cast<uint32_t>(frame.scopeNames.size() * 2);
+	std::vector<uint64_t> timestamps(queryCount);
+
+	// No WAIT bit: if results aren't there (they should be), drop them rather than stall
+	VkResult result = vkGetQueryPoolResults(device, frame.queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t),
+		timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < frame.scopeNames.size(); ++i)
+	{
+		uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+		double ms = ticks * timestampPeriodNs / 1000000.0;
+
+		std::deque<double>& passSamples = samples[frame.scopeNames[i]];
+		passSamples.push_back(ms);
+		if (passSamples.size() > SAMPLE_HISTORY)
+		{
+			passSamples.pop_front();
+		}
+	}
+}
+
+GpuProfileScope::GpuProfileScope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const std::string& name)
+	: profiler(profiler), commandBuffer(commandBuffer)
+{
+	if (profiler == nullptr || !profiler->IsEnabled())
+	{
+		return;
+	}
+
+	queryIndex = profiler->BeginScope(name);
+	if (queryIndex >= 0)
+	{
+		// Written once all previous commands have started
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->frames[profiler->currentFrame].queryPool, queryIndex);
+	}
+}
+
+GpuProfileScope::~GpuProfileScope()
+{
+	if (queryIndex >= 0)
+	{
+		// Written once all previous commands have completed
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->frames[profiler->currentFrame].queryPool, queryIndex + 1);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <deque>
+#include <string>
+#include <vector>
+
+// GPU timestamp profiler
+// One query pool per frame in flight: results for a frame are read when that frame slot is reused,
+// by which point its fence has signalled, so reading never stalls the CPU.
+class GpuProfiler
+{
+public:
+	struct PassStats
+	{
+		double			minMs = 0.0;
+		double			avgMs = 0.0;
+		double			p99Ms = 0.0;
+		size_t			sampleCount = 0;
+	};
+
+	// timestampValidBits comes from the queue family the command buffers are submitted to (0 = timestamps unsupported)
+	GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, int framesInFlight, uint32_t timestampValidBits, uint32_t maxScopesPerFrame = 64);
+	~GpuProfiler();
+
+	bool				IsEnabled() const { return bEnabled; }
+
+	// Call at the start of recording a frame's command buffer (outside any render pass)
+	// Collects the results from the last time this frame slot was used and resets its queries
+	void				BeginFrame(int frameIndex, VkCommandBuffer commandBuffer);
+
+	// Per pass timings over the last SAMPLE_HISTORY frames
+	std::map<std::string, PassStats> GetStats() const;
+	void				ResetStats() { samples.clear(); }
+
+	void				DumpCSV(const std::string& fileName) const;
+	void				DumpJSON(const std::string& fileName) const;
+
+private:
+	friend class GpuProfileScope;
+
+	// Number of samples kept per pass for min/avg/p99
+	static const size_t	SAMPLE_HISTORY = 512;
+
+	struct FrameQueries
+	{
+		VkQueryPool					queryPool = VK_NULL_HANDLE;
+		std::vector<std::string>	scopeNames;			// Scope i uses queries 2i (begin) and 2i+1 (end)
+	};
+
+	VkDevice			device;
+	bool				bEnabled = false;
+	double				timestampPeriodNs = 1.0;		// Nanoseconds per timestamp tick
+	uint64_t			timestampMask = ~0ULL;			// Only the low timestampValidBits bits are meaningful
+	uint32_t			maxScopes;
+
+	std::vector<FrameQueries>	frames;
+	int					currentFrame = 0;
+
+	std::map<std::string, std::deque<double>> samples;
+
+	// Returns index of the first of the scope's two queries, or -1 if out of queries
+	int					BeginScope(const std::string& name);
+	void				CollectResults(FrameQueries& frame);
+};
+
+// RAII timestamp pair around a region of a command buffer
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const std::string& name);
+	~GpuProfileScope();
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler*		profiler;
+	VkCommandBuffer		commandBuffer;
+	int					queryIndex = -1;
+};
@@ -0,0 +1,121 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(const std::string& fileName)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of file: " + fileName);
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files can't be mapped, treat them as an empty view
+	if (size > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr)
+		{
+			data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			// View keeps the mapping alive, handle isn't needed anymore
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+#else
+	int file = open(fileName.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0)
+	{
+		close(file);
+		throw std::runtime_error("Failed to get size of file: " + fileName);
+	}
+	size = static_cast<size_t>(fileStat.st_size);
+
+	// Empty files can't be mapped, treat them as an empty view
+	if (size > 0)
+	{
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping != MAP_FAILED)
+		{
+			data = static_cast<const char*>(mapping);
+			// Files are read front to back, let the kernel read ahead aggressively
+			madvise(mapping, size, MADV_SEQUENTIAL);
+		}
+	}
+	// Mapping stays valid after the descriptor is closed
+	close(file);
+#endif
+
+	if (size > 0 && data == nullptr)
+	{
+		throw std::runtime_error("Failed to map a file: " + fileName);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: data(other.data), size(other.size)
+{
+	other.data = nullptr;
+	other.size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Unmap();
+		data = other.data;
+		size = other.size;
+		other.data = nullptr;
+		other.size = 0;
+	}
+	return *this;
+}
+
+void MappedFile::Unmap()
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<char*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
+}
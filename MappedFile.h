@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory-mapped view of a file
+// The view starts on a page boundary, so it is suitably aligned for any type (SPIR-V words, vertex data etc.)
+// and can be handed straight to Vulkan without copying it to the heap first.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& fileName);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	const char*			GetData() const { return data; }
+	size_t				GetSize() const { return size; }
+
+	// Typed view of the mapping (alignment is guaranteed by the page aligned base address)
+	template<typename T>
+	const T*			GetDataAs() const { return reinterpret_cast<const T*>(data); }
+
+private:
+	const char*			data = nullptr;
+	size_t				size = 0;
+
+	void				Unmap();
+};
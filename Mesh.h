@@ -0,0 +1,47 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "VertexLayout.h"
+#include "GpuAllocator.h"
+
+// Vertex streams and index buffer of a mesh in device local memory
+// Created and destroyed through the renderer, which uploads the data and defers destruction until no frame uses it
+struct Mesh
+{
+	VertexLayout					layout;
+	std::vector<VkBuffer>			vertexBuffers;			// One per layout stream
+	std::vector<MemoryAllocation>	vertexAllocations;
+	VkBuffer						indexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation				indexAllocation;
+	uint32_t						vertexCount = 0;
+	uint32_t						indexCount = 0;
+
+	// Meshlets for cluster culling (meshletCount 0 = drawn without)
+	uint32_t						meshletCount = 0;
+	VkBuffer						meshletBuffer = VK_NULL_HANDLE;
+	MemoryAllocation				meshletAllocation;
+	VkBuffer						meshletVertexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation				meshletVertexAllocation;
+	VkBuffer						meshletTriangleBuffer = VK_NULL_HANDLE;
+	MemoryAllocation				meshletTriangleAllocation;
+
+	// Owned by the ClusterRenderer path in use
+	VkBuffer						drawCommandBuffer = VK_NULL_HANDLE;		// Compute path: one indexed indirect draw per meshlet
+	MemoryAllocation				drawCommandAllocation;
+	VkBuffer						drawCountBuffer = VK_NULL_HANDLE;
+	MemoryAllocation				drawCountAllocation;
+	VkDescriptorSet					clusterDescriptorSet = VK_NULL_HANDLE;
+};
+
+// One indexed draw of (a range of) a mesh in the scene draw list
+struct MeshDraw
+{
+	Mesh*							mesh = nullptr;
+	uint32_t						firstIndex = 0;
+	uint32_t						indexCount = 0;			// 0 = every index from firstIndex
+	int32_t							vertexOffset = 0;
+};
@@ -0,0 +1,296 @@
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "CpuProfiler.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+
+// Modification time of a source file as a plain number (0 if it has none)
+static int64_t GetSourceTime(const std::string& sourceFileName, std::error_code& error)
+{
+	auto time = std::filesystem::last_write_time(sourceFileName, error);
+	return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+MeshCacheFile::MeshCacheFile(const std::string& fileName)
+	: file(fileName)
+{
+	if (file.GetSize() < sizeof(MeshCacheHeader))
+	{
+		throw std::runtime_error("Failed to load mesh cache, file is truncated: " + fileName);
+	}
+
+	header = file.GetDataAs<MeshCacheHeader>();
+	if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION || header->headerSize != sizeof(MeshCacheHeader))
+	{
+		throw std::runtime_error("Failed to load mesh cache, unknown format or version: " + fileName);
+	}
+	if (header->attributeCount > MESH_CACHE_MAX_ATTRIBUTES)
+	{
+		throw std::runtime_error("Failed to load mesh cache, too many vertex attributes: " + fileName);
+	}
+
+	// Section table and every payload must lie inside the file
+	uint64_t tableEnd = sizeof(MeshCacheHeader) + static_cast<uint64_t>(header->sectionCount) * sizeof(MeshCacheSection);
+	if (tableEnd > file.GetSize())
+	{
+		throw std::runtime_error("Failed to load mesh cache, section table is truncated: " + fileName);
+	}
+
+	sections = reinterpret_cast<const MeshCacheSection*>(file.GetData() + sizeof(MeshCacheHeader));
+	for (uint32_t i = 0; i < header->sectionCount; ++i)
+	{
+		if (sections[i].offset < tableEnd || sections[i].offset > file.GetSize() || sections[i].size > file.GetSize() - sections[i].offset)
+		{
+			throw std::runtime_error("Failed to load mesh cache, section is out of bounds: " + fileName);
+		}
+	}
+}
+
+VertexLayout MeshCacheFile::GetVertexLayout() const
+{
+	// Source offsets only matter when converting application vertices, which a cache never does again
+	std::vector<VertexAttribute> attributes(header->attributeCount);
+	for (uint32_t i = 0; i < header->attributeCount; ++i)
+	{
+		attributes[i].location = header->attributes[i].location;
+		attributes[i].format = static_cast<VkFormat>(header->attributes[i].format);
+		attributes[i].sourceOffset = 0;
+		attributes[i].stream = header->attributes[i].stream;
+	}
+	return VertexLayout(attributes);
+}
+
+const MeshCacheSection* MeshCacheFile::FindSection(MeshCacheSectionType type, uint32_t index) const
+{
+	for (uint32_t i = 0; i < header->sectionCount; ++i)
+	{
+		if (sections[i].type == static_cast<uint32_t>(type) && index-- == 0)
+		{
+			return &sections[i];
+		}
+	}
+	return nullptr;
+}
+
+uint64_t MeshCacheFile::GetPayloadSize() const
+{
+	uint64_t size = 0;
+	for (uint32_t i = 0; i < header->sectionCount; ++i)
+	{
+		size += sections[i].size;
+	}
+	return size;
+}
+
+void MeshCache::Cook(const MeshData& mesh, const VertexLayout& layout, VkFrontFace frontFace, const std::string& fileName, const std::string& sourceFileName)
+{
+	PROFILE_FUNCTION();
+
+	const std::vector<VertexAttribute>& layoutAttributes = layout.GetAttributes();
+	if (layoutAttributes.size() > MESH_CACHE_MAX_ATTRIBUTES)
+	{
+		throw std::runtime_error("Failed to cook mesh, too many vertex attributes!");
+	}
+
+	std::vector<std::vector<uint8_t>> streams;
+	layout.WriteStreams(mesh.vertices.data(), sizeof(Vertex), mesh.vertices.size(), streams);
+
+	// Whole mesh is the only LOD until a simplifier adds more
+	MeshCacheLod lod = {};
+	lod.firstIndex = 0;
+	lod.indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+	// Payloads in file order
+	struct Payload
+	{
+		MeshCacheSectionType	type;
+		uint32_t				stride;
+		const void*				data;
+		uint64_t				size;
+	};
+	std::vector<Payload> payloads;
+	for (uint32_t s = 0; s < streams.size(); ++s)
+	{
+		payloads.push_back({ MeshCacheSectionType::VertexStream, layout.GetStride(s), streams[s].data(), streams[s].size() });
+	}
+	payloads.push_back({ MeshCacheSectionType::Indices, sizeof(uint32_t), mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t) });
+	payloads.push_back({ MeshCacheSectionType::Lods, sizeof(MeshCacheLod), &lod, sizeof(lod) });
+	if (!mesh.meshlets.empty())
+	{
+		payloads.push_back({ MeshCacheSectionType::Meshlets, sizeof(Meshlet), mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet) });
+		payloads.push_back({ MeshCacheSectionType::MeshletVertices, sizeof(uint32_t), mesh.meshletVertices.data(), mesh.meshletVertices.size() * sizeof(uint32_t) });
+		payloads.push_back({ MeshCacheSectionType::MeshletTriangles, sizeof(uint8_t), mesh.meshletTriangles.data(), mesh.meshletTriangles.size() });
+	}
+
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.headerSize = sizeof(MeshCacheHeader);
+	header.sectionCount = static_cast<uint32_t>(payloads.size());
+	header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	header.attributeCount = static_cast<uint32_t>(layoutAttributes.size());
+	header.frontFace = static_cast<uint32_t>(frontFace);
+	for (size_t i = 0; i < layoutAttributes.size(); ++i)
+	{
+		header.attributes[i].location = layoutAttributes[i].location;
+		header.attributes[i].format = static_cast<uint32_t>(layoutAttributes[i].format);
+		header.attributes[i].stream = layoutAttributes[i].stream;
+	}
+
+	// Bounds
+	glm::vec3 boundsMin(0.0f);
+	glm::vec3 boundsMax(0.0f);
+	if (!mesh.vertices.empty())
+	{
+		boundsMin = boundsMax = mesh.vertices[0].pos;
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.pos);
+			boundsMax = glm::max(boundsMax, vertex.pos);
+		}
+	}
+	glm::vec3 centre = (boundsMin + boundsMax) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (const Vertex& vertex : mesh.vertices)
+	{
+		glm::vec3 offset = vertex.pos - centre;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	memcpy(header.boundsMin, &boundsMin, sizeof(header.boundsMin));
+	memcpy(header.boundsMax, &boundsMax, sizeof(header.boundsMax));
+	header.boundsRadius = std::sqrt(radiusSquared);
+
+	if (!sourceFileName.empty())
+	{
+		std::error_code error;
+		header.sourceSize = std::filesystem::file_size(sourceFileName, error);
+		header.sourceTime = GetSourceTime(sourceFileName, error);
+	}
+
+	// Section table, payloads placed on aligned offsets after it
+	std::vector<MeshCacheSection> sections(payloads.size());
+	uint64_t offset = sizeof(MeshCacheHeader) + sections.size() * sizeof(MeshCacheSection);
+	for (size_t i = 0; i < payloads.size(); ++i)
+	{
+		offset = (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+		sections[i].type = static_cast<uint32_t>(payloads[i].type);
+		sections[i].stride = payloads[i].stride;
+		sections[i].offset = offset;
+		sections[i].size = payloads[i].size;
+		offset += payloads[i].size;
+	}
+
+	// Write to a temporary file first, so a half written cache never replaces a good one
+	std::string tempFileName = fileName + ".tmp";
+	{
+		std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open a file: " + tempFileName);
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(sections.data()), sections.size() * sizeof(MeshCacheSection));
+
+		const char zeros[SECTION_ALIGNMENT] = {};
+		uint64_t position = sizeof(MeshCacheHeader) + sections.size() * sizeof(MeshCacheSection);
+		for (size_t i = 0; i < payloads.size(); ++i)
+		{
+			file.write(zeros, static_cast<std::streamsize>(sections[i].offset - position));
+			file.write(static_cast<const char*>(payloads[i].data), static_cast<std::streamsize>(payloads[i].size));
+			position = sections[i].offset + sections[i].size;
+		}
+
+		if (!file)
+		{
+			throw std::runtime_error("Failed to write mesh cache: " + tempFileName);
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFileName, fileName, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFileName, error);
+		throw std::runtime_error("Failed to replace mesh cache: " + fileName);
+	}
+}
+
+bool MeshCache::IsUpToDate(const std::string& fileName, const std::string& sourceFileName, const VertexLayout& layout, VkFrontFace frontFace)
+{
+	// Only the header is needed, no point mapping the whole file
+	std::ifstream file(fileName, std::ios::binary);
+	MeshCacheHeader header;
+	if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		return false;
+	}
+
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.headerSize != sizeof(MeshCacheHeader))
+	{
+		return false;
+	}
+
+	// Triangle order and meshlet cones only suit the winding they were cooked for
+	if (header.frontFace != static_cast<uint32_t>(frontFace))
+	{
+		return false;
+	}
+
+	// Streams are stored packed for one layout
+	const std::vector<VertexAttribute>& attributes = layout.GetAttributes();
+	if (header.attributeCount != attributes.size())
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < header.attributeCount; ++i)
+	{
+		if (header.attributes[i].location != attributes[i].location || header.attributes[i].format != static_cast<uint32_t>(attributes[i].format)
+			|| header.attributes[i].stream != attributes[i].stream)
+		{
+			return false;
+		}
+	}
+
+	std::error_code error;
+	uint64_t sourceSize = std::filesystem::file_size(sourceFileName, error);
+	int64_t sourceTime = GetSourceTime(sourceFileName, error);
+	if (error)
+	{
+		// Source is gone, the cache is all there is
+		return true;
+	}
+	return sourceSize == header.sourceSize && sourceTime == header.sourceTime;
+}
+
+bool MeshCache::CookIfStale(const std::string& sourceFileName, const std::string& fileName, const VertexLayout& layout, VkFrontFace frontFace)
+{
+	PROFILE_FUNCTION();
+
+	if (IsUpToDate(fileName, sourceFileName, layout, frontFace))
+	{
+		return false;
+	}
+
+	std::cout << "Cooking '" << sourceFileName << "' in to '" << fileName << "'\n";
+	CookOBJ(sourceFileName, fileName, layout, frontFace);
+	return true;
+}
+
+void MeshCache::CookOBJ(const std::string& sourceFileName, const std::string& fileName, const VertexLayout& layout, VkFrontFace frontFace)
+{
+	PROFILE_FUNCTION();
+
+	MeshData mesh = MeshImporter::ImportOBJ(sourceFileName);
+	MeshOptimizer::Options options;
+	options.frontFace = frontFace;
+	MeshOptimizer::Optimize(mesh, options);
+	MeshOptimizer::BuildMeshlets(mesh, frontFace);
+	Cook(mesh, layout, frontFace, fileName, sourceFileName);
+}
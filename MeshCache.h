@@ -0,0 +1,123 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshImporter.h"
+#include "VertexLayout.h"
+
+// Binary mesh cache (.gxmesh)
+// Layout: MeshCacheHeader, then a MeshCacheSection table, then the section payloads, each starting on a
+// SECTION_ALIGNMENT boundary of the file. Vertex streams are stored already packed for the layout they were cooked
+// with, so a mapped payload can be memcpy'd straight in to the staging ring with no parsing or conversion.
+// Little endian only. Any change to the layout of these structs, or to what the cook step produces, must bump
+// MESH_CACHE_VERSION so existing caches are recooked.
+
+const uint32_t MESH_CACHE_MAGIC = 0x4853454D;			// "MESH"
+const uint32_t MESH_CACHE_VERSION = 4;
+const uint32_t MESH_CACHE_MAX_ATTRIBUTES = 16;
+
+enum class MeshCacheSectionType : uint32_t
+{
+	VertexStream,			// One per layout stream, in stream order
+	Indices,				// uint32_t triangle list
+	Lods,					// MeshCacheLod array, LOD 0 first
+	Meshlets,				// Meshlet array (same layout as the culling shaders read)
+	MeshletVertices,		// uint32_t mesh vertex index per meshlet local vertex
+	MeshletTriangles,		// uint8_t local vertex indices, 3 per triangle, padded to 4 bytes
+	Count
+};
+
+struct MeshCacheLod
+{
+	uint32_t				firstIndex;
+	uint32_t				indexCount;
+	float					error;					// Simplification error relative to LOD 0 (0 for LOD 0)
+	uint32_t				padding;
+};
+
+struct MeshCacheAttribute
+{
+	uint32_t				location;
+	uint32_t				format;					// VkFormat
+	uint32_t				stream;
+	uint32_t				padding;
+};
+
+struct MeshCacheSection
+{
+	uint32_t				type;					// MeshCacheSectionType
+	uint32_t				stride;					// Element size (vertex stride for streams)
+	uint64_t				offset;					// From the start of the file, multiple of SECTION_ALIGNMENT
+	uint64_t				size;					// Bytes
+};
+
+struct MeshCacheHeader
+{
+	uint32_t				magic;
+	uint32_t				version;
+	uint32_t				headerSize;				// sizeof(MeshCacheHeader), catches mismatched builds
+	uint32_t				sectionCount;
+
+	uint32_t				vertexCount;
+	uint32_t				indexCount;
+	uint32_t				attributeCount;
+	uint32_t				frontFace;				// VkFrontFace the triangle order and meshlet cones were cooked for
+	MeshCacheAttribute		attributes[MESH_CACHE_MAX_ATTRIBUTES];
+
+	float					boundsMin[3];
+	float					boundsRadius;			// Bounding sphere around the box centre
+	float					boundsMax[3];
+	float					padding2;
+
+	// Source the cache was cooked from, a mismatch means it's stale
+	uint64_t				sourceSize;
+	int64_t					sourceTime;
+};
+
+// Read-only view of a cache file, every pointer points in to the mapping
+class MeshCacheFile
+{
+public:
+	// Throws if the file is missing, truncated or of another version
+	explicit MeshCacheFile(const std::string& fileName);
+
+	const MeshCacheHeader&	GetHeader() const { return *header; }
+	VertexLayout			GetVertexLayout() const;
+
+	// First section of a type (nullptr if there is none)
+	const MeshCacheSection*	FindSection(MeshCacheSectionType type, uint32_t index = 0) const;
+	const void*				GetSectionData(const MeshCacheSection& section) const { return file.GetData() + section.offset; }
+
+	// Number of bytes of section payloads
+	uint64_t				GetPayloadSize() const;
+
+private:
+	MappedFile				file;
+	const MeshCacheHeader*	header = nullptr;
+	const MeshCacheSection*	sections = nullptr;
+};
+
+class MeshCache
+{
+public:
+	static const uint64_t	SECTION_ALIGNMENT = 256;
+
+	// Write a mesh as a cache file with its vertices packed for layout
+	// frontFace is the winding the mesh was optimised and its meshlets built for
+	// sourceFileName is recorded so IsUpToDate can tell when the source changed (may be empty)
+	static void				Cook(const MeshData& mesh, const VertexLayout& layout, VkFrontFace frontFace, const std::string& fileName, const std::string& sourceFileName = "");
+
+	// Cache exists, is this version, was cooked with this layout and winding and from the source as it is now
+	static bool				IsUpToDate(const std::string& fileName, const std::string& sourceFileName, const VertexLayout& layout, VkFrontFace frontFace);
+
+	// Import sourceFileName (OBJ), optimise it and build its meshlets for frontFace, and cook it in to fileName
+	static void				CookOBJ(const std::string& sourceFileName, const std::string& fileName, const VertexLayout& layout, VkFrontFace frontFace);
+
+	// CookOBJ unless the cache is already up to date, returns true if it had to cook
+	static bool				CookIfStale(const std::string& sourceFileName, const std::string& fileName, const VertexLayout& layout, VkFrontFace frontFace);
+};
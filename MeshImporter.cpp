@@ -0,0 +1,665 @@
+#include "MeshImporter.h"
+#include "MappedFile.h"
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <cstring>
+#include <charconv>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+
+// Files smaller than this per thread aren't worth splitting further
+static const size_t MIN_CHUNK_SIZE = 1024 * 1024;
+
+// Face corner before indices are resolved to global ones
+struct ObjCorner
+{
+	int32_t				position;
+	int32_t				normal;					// -1 = none
+	uint8_t				relativeMask;			// Bit 0 = position, bit 1 = normal is relative to the chunk's own count
+};
+
+// Everything parsed from one newline aligned range of the file
+struct ObjChunk
+{
+	const char*					begin;
+	const char*					end;
+
+	std::vector<glm::vec3>		positions;
+	std::vector<glm::vec3>		colours;			// Same count as positions, white where a "v" has no colour
+	std::vector<glm::vec3>		normals;
+	std::vector<ObjCorner>		corners;			// Three per triangle
+	bool						bHasColours = false;
+
+	// Filled when resolving
+	size_t						positionBase = 0;
+	size_t						normalBase = 0;
+	size_t						cornerBase = 0;
+	std::vector<uint64_t>		keys;				// Dedup key per corner
+	std::vector<std::vector<uint32_t>> shardCorners;	// Corner indices of this chunk per shard
+};
+
+// Open addressing (linear probing) map from dedup key to vertex index
+// Keys and values live in one flat array, so a lookup is usually a single cache line
+class VertexHashMap
+{
+public:
+	explicit VertexHashMap(size_t expectedCount)
+	{
+		size_t capacity = 64;
+		while (capacity < expectedCount * 2)
+		{
+			capacity *= 2;
+		}
+		slots.assign(capacity, Slot());
+	}
+
+	// Index stored for key, inserting newIndex if it isn't in the map yet
+	uint32_t FindOrInsert(uint64_t key, uint64_t hash, uint32_t newIndex, bool* bInserted)
+	{
+		// Keep the load factor under 1/2 so probe sequences stay short
+		if ((count + 1) * 2 > slots.size())
+		{
+			Grow();
+		}
+
+		size_t mask = slots.size() - 1;
+		for (size_t i = static_cast<size_t>(hash) & mask;; i = (i + 1) & mask)
+		{
+			if (slots[i].key == key)
+			{
+				*bInserted = false;
+				return slots[i].index;
+			}
+			if (slots[i].key == EMPTY_KEY)
+			{
+				slots[i].key = key;
+				slots[i].index = newIndex;
+				++count;
+				*bInserted = true;
+				return newIndex;
+			}
+		}
+	}
+
+	static uint64_t Hash(uint64_t key)
+	{
+		// 64 bit finaliser of MurmurHash3, spreads neighbouring indices over the whole table
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+
+	static const uint64_t EMPTY_KEY = ~0ULL;
+
+private:
+	struct Slot
+	{
+		uint64_t		key = EMPTY_KEY;
+		uint32_t		index = 0;
+	};
+
+	std::vector<Slot>	slots;
+	size_t				count = 0;
+
+	void Grow()
+	{
+		std::vector<Slot> oldSlots(slots.size() * 2);
+		oldSlots.swap(slots);
+
+		size_t mask = slots.size() - 1;
+		for (const Slot& slot : oldSlots)
+		{
+			if (slot.key == EMPTY_KEY)
+			{
+				continue;
+			}
+
+			size_t i = static_cast<size_t>(Hash(slot.key)) & mask;
+			while (slots[i].key != EMPTY_KEY)
+			{
+				i = (i + 1) & mask;
+			}
+			slots[i] = slot;
+		}
+	}
+};
+
+// Worker threads shared by every import, started on first use and joined at exit
+// Jobs run one at a time, the calling thread works on the job too, indices are handed out to whoever is free
+class ImportWorkerPool
+{
+public:
+	static ImportWorkerPool& Get()
+	{
+		// Function local so it is created after (and destroyed before) the profiler's registry
+		static ImportWorkerPool pool;
+		return pool;
+	}
+
+	// Run function(0..count-1), the first exception thrown by any index is rethrown once all have finished
+	// Not re-entrant: function must not call Run (or ParallelFor) itself, the nested call would wait forever
+	// on dispatchMutex held by the outer one, so it throws instead
+	void Run(int count, const std::function<void(int)>& function)
+	{
+		if (bInsideJob)
+		{
+			throw std::runtime_error("Failed to run import job, nested ParallelFor would deadlock!");
+		}
+
+		// One job at a time, imports on other threads wait their turn
+		std::lock_guard<std::mutex> dispatchLock(dispatchMutex);
+
+		std::vector<std::exception_ptr> errors(count);
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			job = &function;
+			jobErrors = &errors;
+			jobCount = count;
+			nextIndex = 0;
+			++jobGeneration;
+		}
+		if (count > 1)
+		{
+			jobCondition.notify_all();
+		}
+
+		RunIndices(function, count, errors);
+
+		// Workers that haven't picked the job up by now see it cleared and skip it
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+			job = nullptr;
+			jobErrors = nullptr;
+		}
+
+		for (auto& error : errors)
+		{
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex				dispatchMutex;
+	std::mutex				jobMutex;
+	std::condition_variable	jobCondition;
+	std::condition_variable	doneCondition;
+	const std::function<void(int)>* job = nullptr;
+	std::vector<std::exception_ptr>* jobErrors = nullptr;
+	int						jobCount = 0;
+	std::atomic<int>		nextIndex { 0 };
+	uint64_t				jobGeneration = 0;
+	int						activeWorkers = 0;
+	bool					bStopping = false;
+
+	// Set while the calling thread runs indices of a job, on the caller and on workers alike
+	static thread_local bool bInsideJob;
+
+	ImportWorkerPool()
+	{
+		// The calling thread is the last worker
+		int threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+		for (int i = 0; i < threadCount; ++i)
+		{
+			workers.emplace_back(&ImportWorkerPool::WorkerLoop, this);
+		}
+	}
+
+	~ImportWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			bStopping = true;
+		}
+		jobCondition.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void RunIndices(const std::function<void(int)>& function, int count, std::vector<std::exception_ptr>& errors)
+	{
+		bInsideJob = true;
+		for (int index = nextIndex++; index < count; index = nextIndex++)
+		{
+			try
+			{
+				function(index);
+			}
+			catch (...)
+			{
+				errors[index] = std::current_exception();
+			}
+		}
+		bInsideJob = false;
+	}
+
+	void WorkerLoop()
+	{
+		PROFILE_THREAD_NAME("MeshImporter");
+
+		uint64_t seenGeneration = 0;
+		while (true)
+		{
+			const std::function<void(int)>* function;
+			std::vector<std::exception_ptr>* errors;
+			int count;
+			{
+				std::unique_lock<std::mutex> lock(jobMutex);
+				jobCondition.wait(lock, [&] { return bStopping || jobGeneration != seenGeneration; });
+
+				if (bStopping)
+				{
+					break;
+				}
+
+				seenGeneration = jobGeneration;
+				if (job == nullptr)
+				{
+					continue;
+				}
+
+				function = job;
+				errors = jobErrors;
+				count = jobCount;
+				++activeWorkers;
+			}
+
+			RunIndices(*function, count, *errors);
+
+			{
+				std::lock_guard<std::mutex> lock(jobMutex);
+				--activeWorkers;
+			}
+			doneCondition.notify_one();
+		}
+	}
+};
+
+thread_local bool ImportWorkerPool::bInsideJob = false;
+
+// Not re-entrant, see ImportWorkerPool::Run
+static void ParallelFor(int count, const std::function<void(int)>& function)
+{
+	ImportWorkerPool::Get().Run(count, function);
+}
+
+static const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+	{
+		++p;
+	}
+	return p;
+}
+
+// Parse up to count floats, returns how many were read
+static int ParseFloats(const char* p, const char* end, float* values, int count)
+{
+	int parsed = 0;
+	for (; parsed < count; ++parsed)
+	{
+		p = SkipSpaces(p, end);
+		if (p < end && *p == '+')
+		{
+			++p;
+		}
+
+		// from_chars is locale independent and doesn't allocate, unlike strtof/streams
+		std::from_chars_result result = std::from_chars(p, end, values[parsed]);
+		if (result.ec != std::errc())
+		{
+			break;
+		}
+		p = result.ptr;
+	}
+	return parsed;
+}
+
+static const char* ParseIndex(const char* p, const char* end, int32_t* index)
+{
+	std::from_chars_result result = std::from_chars(p, end, *index);
+	if (result.ec != std::errc() || *index == 0)
+	{
+		throw std::runtime_error("Failed to parse an OBJ face index!");
+	}
+	return result.ptr;
+}
+
+// One face corner "v", "v/vt", "v//vn" or "v/vt/vn", indices made 0 based (relative ones against the chunk's counts so far)
+static const char* ParseCorner(const char* p, const char* end, const ObjChunk& chunk, ObjCorner* corner)
+{
+	int32_t index;
+	p = ParseIndex(p, end, &index);
+	corner->relativeMask = 0;
+	corner->normal = -1;
+	if (index > 0)
+	{
+		corner->position = index - 1;
+	}
+	else
+	{
+		corner->position = static_cast<int32_t>(chunk.positions.size()) + index;
+		corner->relativeMask |= 1;
+	}
+
+	if (p < end && *p == '/')
+	{
+		++p;
+		// Texture coordinate isn't used by Vertex, skip it
+		while (p < end && *p != '/' && *p != ' ' && *p != '\t' && *p != '\r')
+		{
+			++p;
+		}
+
+		if (p < end && *p == '/')
+		{
+			++p;
+			p = ParseIndex(p, end, &index);
+			if (index > 0)
+			{
+				corner->normal = index - 1;
+			}
+			else
+			{
+				corner->normal = static_cast<int32_t>(chunk.normals.size()) + index;
+				corner->relativeMask |= 2;
+			}
+		}
+	}
+	return p;
+}
+
+static void ParseChunk(ObjChunk& chunk)
+{
+	PROFILE_FUNCTION();
+
+	ObjCorner polygon[3];
+	const char* p = chunk.begin;
+	while (p < chunk.end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+		if (lineEnd == nullptr)
+		{
+			lineEnd = chunk.end;
+		}
+
+		p = SkipSpaces(p, lineEnd);
+		if (lineEnd - p >= 2 && p[0] == 'v' && p[1] == ' ')
+		{
+			float values[6];
+			int count = ParseFloats(p + 2, lineEnd, values, 6);
+			if (count < 3)
+			{
+				throw std::runtime_error("Failed to parse an OBJ vertex position!");
+			}
+
+			chunk.positions.push_back(glm::vec3(values[0], values[1], values[2]));
+			chunk.colours.push_back(count == 6 ? glm::vec3(values[3], values[4], values[5]) : glm::vec3(1.0f));
+			chunk.bHasColours |= count == 6;
+		}
+		else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && p[2] == ' ')
+		{
+			float values[3];
+			if (ParseFloats(p + 3, lineEnd, values, 3) != 3)
+			{
+				throw std::runtime_error("Failed to parse an OBJ vertex normal!");
+			}
+			chunk.normals.push_back(glm::vec3(values[0], values[1], values[2]));
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'f' && p[1] == ' ')
+		{
+			// Fan triangulation: (0, 1, 2), (0, 2, 3), ...
+			int cornerCount = 0;
+			const char* c = SkipSpaces(p + 2, lineEnd);
+			while (c < lineEnd && *c != '\r')
+			{
+				ObjCorner corner;
+				c = ParseCorner(c, lineEnd, chunk, &corner);
+				if (cornerCount < 2)
+				{
+					polygon[cornerCount] = corner;
+				}
+				else
+				{
+					polygon[2] = corner;
+					chunk.corners.insert(chunk.corners.end(), polygon, polygon + 3);
+					polygon[1] = corner;
+				}
+				++cornerCount;
+				c = SkipSpaces(c, lineEnd);
+			}
+		}
+		// Anything else (comments, vt, groups, materials...) is ignored
+
+		p = lineEnd + 1;
+	}
+}
+
+MeshData MeshImporter::ImportOBJ(const std::string& fileName, int threadCount, Stats* stats)
+{
+	PROFILE_FUNCTION();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	MappedFile file(fileName);
+	MeshData mesh = ParseOBJ(file.GetData(), file.GetSize(), threadCount, stats);
+
+	if (stats != nullptr)
+	{
+		stats->totalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	return mesh;
+}
+
+MeshData MeshImporter::ParseOBJ(const char* data, size_t size, int threadCount, Stats* stats)
+{
+	PROFILE_FUNCTION();
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (threadCount <= 0)
+	{
+		threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+	threadCount = std::max(1, std::min(threadCount, static_cast<int>(size / MIN_CHUNK_SIZE)));
+
+	// Split in to chunks that start at the beginning of a line
+	std::vector<ObjChunk> chunks(threadCount);
+	const char* chunkBegin = data;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		const char* chunkEnd = data + size;
+		if (i < threadCount - 1)
+		{
+			const char* split = std::max(chunkBegin, data + size * (i + 1) / threadCount);
+			const char* newline = static_cast<const char*>(memchr(split, '\n', chunkEnd - split));
+			chunkEnd = newline != nullptr ? newline + 1 : chunkEnd;
+		}
+
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	// -- PARSE --
+	ParallelFor(threadCount, [&](int i) { ParseChunk(chunks[i]); });
+
+	// Global index of the first element of every chunk
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t cornerCount = 0;
+	bool bHasColours = false;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.positionBase = positionCount;
+		chunk.normalBase = normalCount;
+		chunk.cornerBase = cornerCount;
+		positionCount += chunk.positions.size();
+		normalCount += chunk.normals.size();
+		cornerCount += chunk.corners.size();
+		bHasColours |= chunk.bHasColours;
+	}
+	if (positionCount >= UINT32_MAX || normalCount >= UINT32_MAX || cornerCount >= UINT32_MAX)
+	{
+		throw std::runtime_error("Failed to import OBJ, too many elements for 32 bit indices!");
+	}
+
+	auto parseEnd = std::chrono::high_resolution_clock::now();
+
+	// -- RESOLVE --
+	// Make indices global and bucket every corner by the shard its key hashes to
+	const int shardCount = threadCount;
+	ParallelFor(threadCount, [&](int c)
+	{
+		PROFILE_ZONE("ResolveCorners");
+
+		ObjChunk& chunk = chunks[c];
+		chunk.keys.resize(chunk.corners.size());
+		chunk.shardCorners.resize(shardCount);
+		for (auto& shard : chunk.shardCorners)
+		{
+			shard.reserve(chunk.corners.size() / shardCount + 1);
+		}
+
+		for (size_t i = 0; i < chunk.corners.size(); ++i)
+		{
+			const ObjCorner& corner = chunk.corners[i];
+			int64_t position = corner.position + static_cast<int64_t>((corner.relativeMask & 1) ? chunk.positionBase : 0);
+			int64_t normal = corner.normal < 0 ? -1 : corner.normal + static_cast<int64_t>((corner.relativeMask & 2) ? chunk.normalBase : 0);
+			if (position < 0 || position >= static_cast<int64_t>(positionCount) || normal >= static_cast<int64_t>(normalCount))
+			{
+				throw std::runtime_error("Failed to import OBJ, face index out of range!");
+			}
+
+			// Normal only changes the vertex if it becomes the colour
+			if (bHasColours || normal < 0)
+			{
+				normal = -1;
+			}
+
+			uint64_t key = (static_cast<uint64_t>(position) << 32) | static_cast<uint32_t>(normal + 1);
+			chunk.keys[i] = key;
+			chunk.shardCorners[(VertexHashMap::Hash(key) >> 32) % shardCount].push_back(static_cast<uint32_t>(i));
+		}
+	});
+
+	// -- DEDUPLICATE --
+	// Each shard owns a disjoint set of keys, so shards never touch the same map or vertex.
+	// Corners get a shard-local vertex index first and are offset by the shard's base afterwards.
+	MeshData mesh;
+	mesh.indices.resize(cornerCount);
+	std::vector<std::vector<uint64_t>> shardKeys(shardCount);
+	ParallelFor(shardCount, [&](int s)
+	{
+		PROFILE_ZONE("DeduplicateShard");
+
+		size_t shardCornerCount = 0;
+		for (const ObjChunk& chunk : chunks)
+		{
+			shardCornerCount += chunk.shardCorners[s].size();
+		}
+
+		// Meshes usually share each vertex between ~6 corners
+		VertexHashMap map(shardCornerCount / 4);
+		for (const ObjChunk& chunk : chunks)
+		{
+			for (uint32_t corner : chunk.shardCorners[s])
+			{
+				uint64_t key = chunk.keys[corner];
+				bool bInserted;
+				uint32_t index = map.FindOrInsert(key, VertexHashMap::Hash(key), static_cast<uint32_t>(shardKeys[s].size()), &bInserted);
+				if (bInserted)
+				{
+					shardKeys[s].push_back(key);
+				}
+				mesh.indices[chunk.cornerBase + corner] = index;
+			}
+		}
+	});
+
+	std::vector<size_t> shardBase(shardCount);
+	size_t vertexCount = 0;
+	for (int s = 0; s < shardCount; ++s)
+	{
+		shardBase[s] = vertexCount;
+		vertexCount += shardKeys[s].size();
+	}
+
+	// Flatten the attribute arrays so a key's indices can be looked up directly
+	std::vector<glm::vec3> positions(positionCount);
+	std::vector<glm::vec3> colours(bHasColours ? positionCount : 0);
+	std::vector<glm::vec3> normals(normalCount);
+	ParallelFor(threadCount, [&](int c)
+	{
+		const ObjChunk& chunk = chunks[c];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase);
+		if (bHasColours)
+		{
+			std::copy(chunk.colours.begin(), chunk.colours.end(), colours.begin() + chunk.positionBase);
+		}
+	});
+
+	mesh.vertices.resize(vertexCount);
+	ParallelFor(shardCount, [&](int s)
+	{
+		PROFILE_ZONE("BuildVertices");
+
+		for (size_t i = 0; i < shardKeys[s].size(); ++i)
+		{
+			uint64_t key = shardKeys[s][i];
+			uint32_t position = static_cast<uint32_t>(key >> 32);
+			uint32_t normal = static_cast<uint32_t>(key);
+
+			Vertex& vertex = mesh.vertices[shardBase[s] + i];
+			vertex.pos = positions[position];
+			if (bHasColours)
+			{
+				vertex.col = colours[position];
+			}
+			else
+			{
+				vertex.col = normal != 0 ? normals[normal - 1] * 0.5f + 0.5f : glm::vec3(1.0f);
+			}
+		}
+
+		uint32_t base = static_cast<uint32_t>(shardBase[s]);
+		for (const ObjChunk& chunk : chunks)
+		{
+			for (uint32_t corner : chunk.shardCorners[s])
+			{
+				mesh.indices[chunk.cornerBase + corner] += base;
+			}
+		}
+	});
+
+	if (stats != nullptr)
+	{
+		auto end = std::chrono::high_resolution_clock::now();
+		stats->fileBytes = size;
+		stats->positionCount = positionCount;
+		stats->cornerCount = cornerCount;
+		stats->threadCount = threadCount;
+		stats->parseMs = std::chrono::duration<double, std::milli>(parseEnd - start).count();
+		stats->dedupMs = std::chrono::duration<double, std::milli>(end - parseEnd).count();
+		stats->totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	return mesh;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+
+#include "Utilities.h"
+
+// Indexed geometry on the CPU, ready for VulkanRenderer::CreateMesh
+struct MeshData
+{
+	std::vector<Vertex>		vertices;
+	std::vector<uint32_t>	indices;				// Triangle list
+
+	// Filled by MeshOptimizer::BuildMeshlets, meshlets cover the index buffer in order
+	std::vector<Meshlet>	meshlets;
+	std::vector<uint32_t>	meshletVertices;
+	std::vector<uint8_t>	meshletTriangles;		// Padded to a multiple of 4 bytes
+};
+
+// Mesh file importer
+// OBJ files are memory mapped and parsed in newline aligned chunks on a pool of worker threads shared by every
+// import. Face corners are then deduplicated in to unique vertices with open addressing hash maps, one per shard
+// of the key space, each shard a task of its own, so no locks are taken and no tree nodes are allocated per vertex.
+class MeshImporter
+{
+public:
+	struct Stats
+	{
+		size_t				fileBytes = 0;
+		size_t				positionCount = 0;		// "v" lines
+		size_t				cornerCount = 0;		// Face corners after triangulation
+		int					threadCount = 0;
+		double				parseMs = 0.0;
+		double				dedupMs = 0.0;
+		double				totalMs = 0.0;			// Including mapping the file
+	};
+
+	// Supports "v x y z [r g b]", "vn", "vt" and polygonal "f" with v, v/vt, v//vn and v/vt/vn corners
+	// (negative indices are relative). Polygons are fan triangulated.
+	// Vertex colour is the "v" colour if the file has any, else the normal mapped to [0, 1], else white.
+	// Vertices are ordered by shard, not by first use (reorder with the optimiser for cache locality).
+	// threadCount: chunks and shards the work is split in to, 0 = one per hardware thread (always run on the shared pool)
+	static MeshData		ImportOBJ(const std::string& fileName, int threadCount = 0, Stats* stats = nullptr);
+	static MeshData		ParseOBJ(const char* data, size_t size, int threadCount = 0, Stats* stats = nullptr);
+};
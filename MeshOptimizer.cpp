@@ -0,0 +1,527 @@
+#include "MeshOptimizer.h"
+#include "CpuProfiler.h"
+
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+// Forsyth scoring parameters (from the paper)
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+// Remaining triangle counts above this all score the same
+static const uint32_t MAX_VALENCE = 32;
+
+// Fetch simulation: 64 byte lines in a 16KB direct mapped cache
+static const uint32_t FETCH_LINE_SIZE = 64;
+static const uint32_t FETCH_LINE_COUNT = 256;
+
+// Normal of the side of a triangle that faces the viewer when drawn with frontFace, twice the triangle's area long
+// Framebuffer y points down, so a triangle clockwise on screen has its normal along (c - a) x (b - a)
+static glm::vec3 GetFrontNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, VkFrontFace frontFace)
+{
+	return frontFace == VK_FRONT_FACE_CLOCKWISE ? glm::cross(c - a, b - a) : glm::cross(b - a, c - a);
+}
+
+void MeshOptimizer::Optimize(MeshData& mesh)
+{
+	Optimize(mesh, Options());
+}
+
+void MeshOptimizer::Optimize(MeshData& mesh, const Options& options)
+{
+	PROFILE_FUNCTION();
+
+	if (options.bVertexCache)
+	{
+		OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	}
+	if (options.bOverdraw)
+	{
+		OptimizeOverdraw(mesh.indices, mesh.vertices, options.overdrawThreshold, options.frontFace);
+	}
+	if (options.bVertexFetch)
+	{
+		OptimizeVertexFetch(mesh.vertices, mesh.indices);
+	}
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	PROFILE_FUNCTION();
+
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Score tables, indexed by cache position and by remaining triangle count
+	float cacheScores[CACHE_SIZE];
+	for (uint32_t i = 0; i < CACHE_SIZE; ++i)
+	{
+		// Last triangle's vertices get a fixed score, so the next triangle doesn't just reuse the same edge
+		cacheScores[i] = i < 3 ? LAST_TRIANGLE_SCORE : std::pow(1.0f - static_cast<float>(i - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	float valenceScores[MAX_VALENCE + 1];
+	valenceScores[0] = 0.0f;
+	for (uint32_t i = 1; i <= MAX_VALENCE; ++i)
+	{
+		// Vertices with few triangles left are boosted, so they get finished instead of leaving lone triangles
+		valenceScores[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+	}
+
+	// Triangles of every vertex (compressed adjacency: triangles of vertex v are at offsets[v] .. offsets[v] + remaining[v])
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		if (index >= vertexCount)
+		{
+			throw std::runtime_error("Failed to optimise mesh, index out of range!");
+		}
+		++remaining[index];
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	auto VertexScore = [&](uint32_t vertex, int32_t cachePosition)
+	{
+		uint32_t valence = remaining[vertex];
+		if (valence == 0)
+		{
+			return -1.0f;
+		}
+		float score = valenceScores[std::min(valence, MAX_VALENCE)];
+		if (cachePosition >= 0)
+		{
+			score += cacheScores[cachePosition];
+		}
+		return score;
+	};
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		vertexScores[v] = VertexScore(static_cast<uint32_t>(v), -1);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	// Cache has room for the new triangle's vertices before the oldest ones are dropped
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(CACHE_SIZE + 3);
+	newCache.reserve(CACHE_SIZE + 3);
+
+	size_t bestTriangle = 0;
+	size_t deadEndCursor = 0;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		// Dead end (nothing in cache has triangles left): take the next triangle not emitted yet
+		if (bestTriangle == SIZE_MAX)
+		{
+			while (emitted[deadEndCursor])
+			{
+				++deadEndCursor;
+			}
+			bestTriangle = deadEndCursor;
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		output.insert(output.end(), triangle, triangle + 3);
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from its vertices' adjacency
+		for (int c = 0; c < 3; ++c)
+		{
+			uint32_t vertex = triangle[c];
+			uint32_t* begin = &adjacency[offsets[vertex]];
+			uint32_t* end = begin + remaining[vertex];
+			*std::find(begin, end, static_cast<uint32_t>(bestTriangle)) = end[-1];
+			--remaining[vertex];
+		}
+
+		// Triangle's vertices move to the front of the cache (LRU)
+		newCache.assign(triangle, triangle + 3);
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+			{
+				newCache.push_back(vertex);
+			}
+		}
+
+		// Vertices pushed out
+		for (size_t i = CACHE_SIZE; i < newCache.size(); ++i)
+		{
+			cachePositions[newCache[i]] = -1;
+			vertexScores[newCache[i]] = VertexScore(newCache[i], -1);
+		}
+		newCache.resize(std::min<size_t>(newCache.size(), CACHE_SIZE));
+		cache.swap(newCache);
+
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			cachePositions[cache[i]] = static_cast<int32_t>(i);
+			vertexScores[cache[i]] = VertexScore(cache[i], static_cast<int32_t>(i));
+		}
+
+		// Only triangles of cached vertices changed score, the best of them is next
+		bestTriangle = SIZE_MAX;
+		float bestScore = -1.0f;
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t a = offsets[vertex]; a < offsets[vertex] + remaining[vertex]; ++a)
+			{
+				uint32_t t = adjacency[a];
+				float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold, VkFrontFace frontFace)
+{
+	PROFILE_FUNCTION();
+
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Cluster boundaries: triangles where the simulated cache is cold (all three vertices miss),
+	// so moving whole clusters around barely changes ACMR
+	std::vector<size_t> clusterStarts;
+	{
+		std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+		uint32_t time = CACHE_SIZE + 1;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			int misses = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				uint32_t vertex = indices[t * 3 + c];
+				if (time - cacheTimestamps[vertex] > CACHE_SIZE)
+				{
+					cacheTimestamps[vertex] = time++;
+					++misses;
+				}
+			}
+			if (t == 0 || misses == 3)
+			{
+				clusterStarts.push_back(t);
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+	const size_t clusterCount = clusterStarts.size() - 1;
+	if (clusterCount < 2)
+	{
+		return;
+	}
+
+	// Area weighted centroid and normal of every cluster, and of the whole mesh
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		float clusterArea = 0.0f;
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+		{
+			const glm::vec3& a = vertices[indices[t * 3]].pos;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& d = vertices[indices[t * 3 + 2]].pos;
+
+			// Cross product length is twice the area, the factor cancels out
+			glm::vec3 normal = GetFrontNormal(a, b, d, frontFace);
+			float area = glm::length(normal);
+
+			clusterCentroids[c] += (a + b + d) * (area / 3.0f);
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterArea;
+		clusterCentroids[c] = clusterArea > 0.0f ? clusterCentroids[c] / clusterArea : vertices[indices[clusterStarts[c] * 3]].pos;
+
+		float normalLength = glm::length(clusterNormals[c]);
+		clusterNormals[c] = normalLength > 0.0f ? clusterNormals[c] / normalLength : glm::vec3(0.0f);
+	}
+	meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+	// Clusters far out along their own normal are likely in front of the rest from any direction where they're visible
+	std::vector<float> occlusion(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		occlusion[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return occlusion[a] > occlusion[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (uint32_t c : order)
+	{
+		output.insert(output.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+	}
+
+	// Keep the vertex cache order if clusters cost more transforms than allowed
+	float inputAcmr = AnalyzeVertexCache(indices, vertices.size()).acmr;
+	float outputAcmr = AnalyzeVertexCache(output, vertices.size()).acmr;
+	if (outputAcmr <= inputAcmr * threshold)
+	{
+		indices.swap(output);
+	}
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> output;
+	output.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(output.size());
+			output.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(output);
+}
+
+// Bounds of the triangles [firstTriangle, firstTriangle + meshlet.triangleCount)
+static void ComputeMeshletBounds(const MeshData& mesh, size_t firstTriangle, VkFrontFace frontFace, Meshlet& meshlet)
+{
+	// Sphere around the box of the meshlet's vertices
+	glm::vec3 boundsMin = mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset]].pos;
+	glm::vec3 boundsMax = boundsMin;
+	for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+	{
+		const glm::vec3& position = mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + v]].pos;
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+	meshlet.center = (boundsMin + boundsMax) * 0.5f;
+	meshlet.radius = 0.0f;
+	for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+	{
+		meshlet.radius = std::max(meshlet.radius, glm::length(mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + v]].pos - meshlet.center));
+	}
+
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangleCount);
+	glm::vec3 axis(0.0f);
+	for (size_t t = firstTriangle; t < firstTriangle + meshlet.triangleCount; ++t)
+	{
+		const glm::vec3& a = mesh.vertices[mesh.indices[t * 3]].pos;
+		const glm::vec3& b = mesh.vertices[mesh.indices[t * 3 + 1]].pos;
+		const glm::vec3& c = mesh.vertices[mesh.indices[t * 3 + 2]].pos;
+		glm::vec3 normal = GetFrontNormal(a, b, c, frontFace);
+		float length = glm::length(normal);
+
+		// Degenerate triangles are never drawn, they don't limit the cone
+		normals.push_back(length > 0.0f ? normal / length : glm::vec3(0.0f));
+		axis += normals.back();
+	}
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 2.0f;
+
+	float axisLength = glm::length(axis);
+	if (axisLength == 0.0f)
+	{
+		return;
+	}
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (const glm::vec3& normal : normals)
+	{
+		if (normal != glm::vec3(0.0f))
+		{
+			minDot = std::min(minDot, glm::dot(normal, axis));
+		}
+	}
+
+	// Normals spread over (nearly) a hemisphere, some triangle always faces the camera
+	if (minDot <= 0.1f)
+	{
+		return;
+	}
+
+	// Apex: furthest point back along the axis that is behind every triangle's plane
+	float maxT = 0.0f;
+	for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+	{
+		const glm::vec3& normal = normals[i];
+		if (normal != glm::vec3(0.0f))
+		{
+			const glm::vec3& a = mesh.vertices[mesh.indices[(firstTriangle + i) * 3]].pos;
+			maxT = std::max(maxT, glm::dot(meshlet.center - a, normal) / glm::dot(axis, normal));
+		}
+	}
+
+	// Backfacing from camera position p when dot(normalize(apex - p), axis) >= cutoff
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+void MeshOptimizer::BuildMeshlets(MeshData& mesh, VkFrontFace frontFace, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	PROFILE_FUNCTION();
+
+	mesh.meshlets.clear();
+	mesh.meshletVertices.clear();
+	mesh.meshletTriangles.clear();
+
+	// Local index of every mesh vertex in the meshlet being built (UINT32_MAX = not in it)
+	std::vector<uint32_t> localIndices(mesh.vertices.size(), UINT32_MAX);
+
+	Meshlet meshlet = {};
+	size_t firstTriangle = 0;
+	auto FinishMeshlet = [&](size_t endTriangle)
+	{
+		ComputeMeshletBounds(mesh, firstTriangle, frontFace, meshlet);
+		mesh.meshlets.push_back(meshlet);
+
+		for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+		{
+			localIndices[mesh.meshletVertices[meshlet.vertexOffset + v]] = UINT32_MAX;
+		}
+
+		meshlet = {};
+		meshlet.firstIndex = static_cast<uint32_t>(endTriangle * 3);
+		meshlet.vertexOffset = static_cast<uint32_t>(mesh.meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(mesh.meshletTriangles.size());
+		firstTriangle = endTriangle;
+	};
+
+	const size_t triangleCount = mesh.indices.size() / 3;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* triangle = &mesh.indices[t * 3];
+		uint32_t newVertices = 0;
+		for (int c = 0; c < 3; ++c)
+		{
+			newVertices += localIndices[triangle[c]] == UINT32_MAX ? 1 : 0;
+		}
+
+		if (meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount + 1 > maxTriangles)
+		{
+			FinishMeshlet(t);
+		}
+
+		for (int c = 0; c < 3; ++c)
+		{
+			uint32_t& local = localIndices[triangle[c]];
+			if (local == UINT32_MAX)
+			{
+				local = meshlet.vertexCount++;
+				mesh.meshletVertices.push_back(triangle[c]);
+			}
+			mesh.meshletTriangles.push_back(static_cast<uint8_t>(local));
+		}
+		++meshlet.triangleCount;
+	}
+	if (meshlet.triangleCount > 0)
+	{
+		FinishMeshlet(triangleCount);
+	}
+
+	// Shaders read the triangle list as 32 bit words
+	mesh.meshletTriangles.resize((mesh.meshletTriangles.size() + 3) / 4 * 4, 0);
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	CacheStats stats;
+	stats.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	// FIFO cache: a vertex is a hit if fewer than cacheSize misses happened since it was last loaded
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t time = cacheSize + 1;
+	for (uint32_t index : indices)
+	{
+		if (time - cacheTimestamps[index] > cacheSize)
+		{
+			cacheTimestamps[index] = time++;
+			++stats.transformCount;
+		}
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			++stats.vertexCount;
+		}
+	}
+
+	stats.acmr = stats.triangleCount > 0 ? static_cast<float>(stats.transformCount) / stats.triangleCount : 0.0f;
+	stats.atvr = stats.vertexCount > 0 ? static_cast<float>(stats.transformCount) / stats.vertexCount : 0.0f;
+	return stats;
+}
+
+MeshOptimizer::FetchStats MeshOptimizer::AnalyzeVertexFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize)
+{
+	FetchStats stats;
+
+	// Line index + 1 held by each cache slot (0 = empty)
+	std::vector<uint64_t> lines(FETCH_LINE_COUNT, 0);
+	for (uint32_t index : indices)
+	{
+		uint64_t begin = static_cast<uint64_t>(index) * vertexSize / FETCH_LINE_SIZE;
+		uint64_t end = (static_cast<uint64_t>(index) * vertexSize + vertexSize - 1) / FETCH_LINE_SIZE;
+		for (uint64_t line = begin; line <= end; ++line)
+		{
+			uint64_t& slot = lines[line % FETCH_LINE_COUNT];
+			if (slot != line + 1)
+			{
+				slot = line + 1;
+				stats.bytesFetched += FETCH_LINE_SIZE;
+			}
+		}
+	}
+
+	uint64_t bufferSize = static_cast<uint64_t>(vertexCount) * vertexSize;
+	stats.overfetch = bufferSize > 0 ? static_cast<float>(stats.bytesFetched) / bufferSize : 0.0f;
+	return stats;
+}
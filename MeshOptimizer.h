@@ -0,0 +1,68 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "MeshImporter.h"
+
+// Mesh optimisation for vertex throughput
+// Run by the cook step after importing, in this order: vertex cache -> overdraw -> vertex fetch,
+// each stage keeping what the previous one achieved.
+class MeshOptimizer
+{
+public:
+	struct Options
+	{
+		bool				bVertexCache = true;
+		bool				bOverdraw = true;
+		float				overdrawThreshold = 1.05f;	// Max ACMR increase overdraw ordering may cost (1.05 = 5%)
+		bool				bVertexFetch = true;
+		VkFrontFace			frontFace = VK_FRONT_FACE_CLOCKWISE;		// Winding the pipelines drawing the mesh treat as front facing
+	};
+
+	// Post-transform vertex cache statistics of a FIFO cache simulation
+	struct CacheStats
+	{
+		uint32_t			triangleCount = 0;
+		uint32_t			vertexCount = 0;		// Vertices referenced by the indices
+		uint32_t			transformCount = 0;		// Cache misses
+		float				acmr = 0.0f;			// Average cache miss ratio: transforms per triangle (0.5 best, 3 worst)
+		float				atvr = 0.0f;			// Average transform to vertex ratio: transforms per vertex (1 best)
+	};
+
+	// Pre-transform (vertex fetch) statistics of a cache line simulation
+	struct FetchStats
+	{
+		uint64_t			bytesFetched = 0;
+		float				overfetch = 0.0f;		// Bytes fetched / vertex buffer size (1 best)
+	};
+
+	static void				Optimize(MeshData& mesh);
+	static void				Optimize(MeshData& mesh, const Options& options);
+
+	// Reorder triangles so vertices are reused while still in the post-transform cache
+	// (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+	static void				OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Reorder clusters of the (cache optimised) triangles so outward facing ones come first and hide the rest,
+	// keeping the result only if ACMR stays within threshold of the input
+	// frontFace is the winding of the pipelines the mesh is drawn with (see RendererSettings::frontFace)
+	static void				OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold, VkFrontFace frontFace);
+
+	// Renumber vertices in order of first use so fetches walk the vertex buffer sequentially
+	// Unreferenced vertices are dropped
+	static void				OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Split the triangles, in index order, in to meshlets of at most maxVertices/maxTriangles with their bounding
+	// sphere and normal cone (run after the other stages so meshlets are spatially compact)
+	// Cones are built for frontFace, the winding of the pipelines the mesh is drawn with
+	static void				BuildMeshlets(MeshData& mesh, VkFrontFace frontFace, uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+	static CacheStats		AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+	static FetchStats		AnalyzeVertexFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize);
+
+	// Post-transform cache size optimised for and reported against
+	static const uint32_t	CACHE_SIZE = 32;
+};
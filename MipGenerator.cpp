@@ -0,0 +1,380 @@
+#include "MipGenerator.h"
+#include "CpuProfiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+// Invocations per workgroup side of the downsample shader
+static const uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+
+// Stages that sample textures once their mips are done
+static const VkPipelineStageFlags SAMPLING_STAGES = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+// Layout transition of a range of levels (every layer)
+static void RecordLevelBarrier(VkCommandBuffer commandBuffer, const Texture& texture, uint32_t baseLevel, uint32_t levelCount,
+	VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+	VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = texture.image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = baseLevel;
+	barrier.subresourceRange.levelCount = levelCount;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = texture.layerCount;
+
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+MipGenerator::MipGenerator(VkPhysicalDevice physicalDevice, VkDevice device, ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache)
+	: physicalDevice(physicalDevice), device(device)
+{
+	try
+	{
+		CreateComputePipeline(shaderModuleCache, pipelineCache);
+	}
+	catch (const std::runtime_error& e)
+	{
+		// Only matters for formats that can't be blitted
+		std::cout << "Compute mip generation disabled: " << e.what() << std::endl;
+	}
+}
+
+MipGenerator::~MipGenerator()
+{
+	for (auto& work : computeWork)
+	{
+		for (VkImageView view : work.levelViews)
+		{
+			vkDestroyImageView(device, view, nullptr);
+		}
+	}
+
+	vkDestroyPipeline(device, computePipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+void MipGenerator::CreateComputePipeline(ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache)
+{
+	PROFILE_FUNCTION();
+
+	// Module first, so a missing shader leaves nothing half created
+	VkShaderModule shaderModule = shaderModuleCache->GetModule("Shaders/mip_downsample.spv");
+
+	// -- DESCRIPTOR SET LAYOUT --
+	// Source and target level as storage images
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
+	setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCreateInfo.bindingCount = 2;
+	setLayoutCreateInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// -- DESCRIPTOR POOL --
+	// Sets are freed per generation once the GPU is done with them
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSize.descriptorCount = MAX_SETS * 2;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolCreateInfo.maxSets = MAX_SETS;
+	poolCreateInfo.poolSizeCount = 1;
+	poolCreateInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+
+	// -- PIPELINE --
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &computePipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the mip generation Compute Pipeline!");
+	}
+}
+
+VkFormat MipGenerator::GetStorageFormat(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+	default:
+		return format;
+	}
+}
+
+MipGenerator::Method MipGenerator::GetMethod(VkFormat format) const
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	if ((properties.optimalTilingFeatures & blitFeatures) == blitFeatures)
+	{
+		return Method::Blit;
+	}
+
+	// Shader declares its images rgba8
+	VkFormat storageFormat = GetStorageFormat(format);
+	if (computePipeline != VK_NULL_HANDLE && storageFormat == VK_FORMAT_R8G8B8A8_UNORM)
+	{
+		VkFormatProperties storageProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, storageFormat, &storageProperties);
+		if (storageProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)
+		{
+			return Method::Compute;
+		}
+	}
+
+	return Method::None;
+}
+
+VkImageUsageFlags MipGenerator::GetImageUsage(VkFormat format) const
+{
+	switch (GetMethod(format))
+	{
+	case Method::Blit:
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	case Method::Compute:
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	default:
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+}
+
+VkImageCreateFlags MipGenerator::GetImageFlags(VkFormat format) const
+{
+	// Storage views of sRGB images use the UNORM format
+	return GetMethod(format) == Method::Compute && GetStorageFormat(format) != format ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0;
+}
+
+bool MipGenerator::Record(VkCommandBuffer commandBuffer, const Texture& texture, uint64_t serial)
+{
+	PROFILE_FUNCTION();
+
+	if (texture.mipLevels > 1 && texture.bComputeMips)
+	{
+		if (freeSetCount < texture.mipLevels - 1)
+		{
+			return false;
+		}
+		RecordCompute(commandBuffer, texture, serial);
+	}
+	else if (texture.mipLevels > 1)
+	{
+		RecordBlits(commandBuffer, texture);
+	}
+	else
+	{
+		RecordLevelBarrier(commandBuffer, texture, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, SAMPLING_STAGES);
+	}
+	return true;
+}
+
+void MipGenerator::RecordBlits(VkCommandBuffer commandBuffer, const Texture& texture)
+{
+	int32_t width = static_cast<int32_t>(texture.width);
+	int32_t height = static_cast<int32_t>(texture.height);
+
+	for (uint32_t level = 1; level < texture.mipLevels; ++level)
+	{
+		// Level above has been written (copied or blitted), read it
+		RecordLevelBarrier(commandBuffer, texture, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		int32_t levelWidth = std::max(1, width / 2);
+		int32_t levelHeight = std::max(1, height / 2);
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = texture.layerCount;
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.dstSubresource = blit.srcSubresource;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstOffsets[1] = { levelWidth, levelHeight, 1 };
+		vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		// Level above is finished
+		RecordLevelBarrier(commandBuffer, texture, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, SAMPLING_STAGES);
+
+		width = levelWidth;
+		height = levelHeight;
+	}
+
+	// Last level was only ever written
+	RecordLevelBarrier(commandBuffer, texture, texture.mipLevels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, SAMPLING_STAGES);
+}
+
+void MipGenerator::RecordCompute(VkCommandBuffer commandBuffer, const Texture& texture, uint64_t serial)
+{
+	ComputeWork work;
+	work.serial = serial;
+
+	// One storage view per level, sets pair each level with the one below it
+	VkFormat storageFormat = GetStorageFormat(texture.format);
+	work.levelViews.resize(texture.mipLevels, VK_NULL_HANDLE);
+
+	// Nothing is queued if a later step fails, so views made so far would leak (destroying VK_NULL_HANDLE does nothing)
+	auto DestroyLevelViews = [&]()
+	{
+		for (VkImageView view : work.levelViews)
+		{
+			vkDestroyImageView(device, view, nullptr);
+		}
+	};
+
+	for (uint32_t level = 0; level < texture.mipLevels; ++level)
+	{
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = texture.image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCreateInfo.format = storageFormat;
+		viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCreateInfo.subresourceRange.baseMipLevel = level;
+		viewCreateInfo.subresourceRange.levelCount = 1;
+		viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+		viewCreateInfo.subresourceRange.layerCount = texture.layerCount;
+
+		if (vkCreateImageView(device, &viewCreateInfo, nullptr, &work.levelViews[level]) != VK_SUCCESS)
+		{
+			DestroyLevelViews();
+			throw std::runtime_error("Failed to create image view!");
+		}
+	}
+
+	std::vector<VkDescriptorSetLayout> setLayouts(texture.mipLevels - 1, descriptorSetLayout);
+	VkDescriptorSetAllocateInfo setAllocateInfo = {};
+	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocateInfo.descriptorPool = descriptorPool;
+	setAllocateInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+	setAllocateInfo.pSetLayouts = setLayouts.data();
+
+	work.descriptorSets.resize(setLayouts.size());
+	if (vkAllocateDescriptorSets(device, &setAllocateInfo, work.descriptorSets.data()) != VK_SUCCESS)
+	{
+		DestroyLevelViews();
+		throw std::runtime_error("Failed to allocate mip generation Descriptor Sets!");
+	}
+	freeSetCount -= static_cast<uint32_t>(work.descriptorSets.size());
+
+	std::vector<VkDescriptorImageInfo> imageInfos(work.levelViews.size());
+	for (size_t level = 0; level < imageInfos.size(); ++level)
+	{
+		imageInfos[level] = { VK_NULL_HANDLE, work.levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+	}
+	std::vector<VkWriteDescriptorSet> writes(work.descriptorSets.size() * 2);
+	for (size_t i = 0; i < writes.size(); ++i)
+	{
+		size_t set = i / 2;
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = work.descriptorSets[set];
+		writes[i].dstBinding = static_cast<uint32_t>(i % 2);
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[i].pImageInfo = &imageInfos[set + i % 2];		// Binding 0 = level above, 1 = level being generated
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	// Every level in GENERAL for storage access
+	RecordLevelBarrier(commandBuffer, texture, 0, texture.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	uint32_t bSRGB = storageFormat != texture.format ? 1 : 0;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(bSRGB), &bSRGB);
+
+	for (uint32_t level = 1; level < texture.mipLevels; ++level)
+	{
+		uint32_t levelWidth = std::max(1u, texture.width >> level);
+		uint32_t levelHeight = std::max(1u, texture.height >> level);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &work.descriptorSets[level - 1], 0, nullptr);
+		vkCmdDispatch(commandBuffer, (levelWidth + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE,
+			(levelHeight + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE, texture.layerCount);
+
+		// Generated level is the source of the next
+		RecordLevelBarrier(commandBuffer, texture, level, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+
+	RecordLevelBarrier(commandBuffer, texture, 0, texture.mipLevels, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, SAMPLING_STAGES);
+
+	computeWork.push_back(std::move(work));
+}
+
+void MipGenerator::Reclaim(uint64_t completedSerial)
+{
+	// Generations are recorded in serial order
+	while (!computeWork.empty() && computeWork.front().serial <= completedSerial)
+	{
+		ComputeWork& work = computeWork.front();
+		vkFreeDescriptorSets(device, descriptorPool, static_cast<uint32_t>(work.descriptorSets.size()), work.descriptorSets.data());
+		freeSetCount += static_cast<uint32_t>(work.descriptorSets.size());
+		for (VkImageView view : work.levelViews)
+		{
+			vkDestroyImageView(device, view, nullptr);
+		}
+		computeWork.pop_front();
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <vector>
+
+#include "Texture.h"
+#include "ShaderModuleCache.h"
+
+// GPU mip chain generation
+// Each level is blitted (linear filter) from the one above it. Formats that can't be blitted are downsampled by a
+// compute shader through UNORM storage views instead, which needs the image created with the flags GetImageFlags returns.
+class MipGenerator
+{
+public:
+	enum class Method
+	{
+		None,			// Neither works, the texture keeps only its first mip
+		Blit,
+		Compute
+	};
+
+	// Compute path is unavailable (not an error) if its shader is missing
+	MipGenerator(VkPhysicalDevice physicalDevice, VkDevice device, ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache);
+	~MipGenerator();
+
+	Method				GetMethod(VkFormat format) const;
+
+	// Usage and create flags an image of the format needs for its method
+	VkImageUsageFlags	GetImageUsage(VkFormat format) const;
+	VkImageCreateFlags	GetImageFlags(VkFormat format) const;
+
+	// Every level of the texture must be in TRANSFER_DST_OPTIMAL with level 0 written, all end in SHADER_READ_ONLY_OPTIMAL
+	// Returns false (recording nothing) if the compute path is out of descriptor sets until earlier work completes
+	bool				Record(VkCommandBuffer commandBuffer, const Texture& texture, uint64_t serial);
+
+	// Free the views and descriptor sets of compute generations whose frame serial has completed
+	void				Reclaim(uint64_t completedSerial);
+
+private:
+	// Descriptor sets (one per generated level) the compute path may have in flight
+	static const uint32_t	MAX_SETS = 512;
+
+	// Views and sets of one compute generation, kept until the GPU has finished with them
+	struct ComputeWork
+	{
+		uint64_t					serial;
+		std::vector<VkImageView>	levelViews;
+		std::vector<VkDescriptorSet> descriptorSets;
+	};
+
+	VkPhysicalDevice	physicalDevice;
+	VkDevice			device;
+
+	VkDescriptorSetLayout	descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool	descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout	pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline			computePipeline = VK_NULL_HANDLE;
+	uint32_t			freeSetCount = MAX_SETS;
+	std::deque<ComputeWork>	computeWork;
+
+	void				CreateComputePipeline(ShaderModuleCache* shaderModuleCache, VkPipelineCache pipelineCache);
+	void				RecordBlits(VkCommandBuffer commandBuffer, const Texture& texture);
+	void				RecordCompute(VkCommandBuffer commandBuffer, const Texture& texture, uint64_t serial);
+
+	// Format the compute shader reads and writes the image as (UNORM equivalent of sRGB formats)
+	static VkFormat		GetStorageFormat(VkFormat format);
+};
@@ -0,0 +1,144 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+
+#include "MappedFile.h"
+
+// Size of VkPipelineCacheHeaderVersionOne:
+// headerSize, headerVersion, vendorID, deviceID (4 bytes each) + pipelineCacheUUID
+static const size_t PIPELINE_CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+PipelineCache::PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& fileName)
+	: device(device), cacheFileName(fileName)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	vendorID = deviceProperties.vendorID;
+	deviceID = deviceProperties.deviceID;
+	memcpy(pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	// Load previous cache (a missing or stale file just means a cold start)
+	// Mapped, so the driver reads the blob straight from the file without an intermediate copy
+	MappedFile cacheData;
+	if (std::filesystem::exists(cacheFileName))
+	{
+		cacheData = MappedFile(cacheFileName);
+		if (!IsCacheDataValid(cacheData.GetData(), cacheData.GetSize()))
+		{
+			std::cout << "Pipeline cache '" << cacheFileName << "' is from a different device or driver, ignoring it\n";
+			cacheData = MappedFile();
+		}
+	}
+
+	bWarm = cacheData.GetSize() > 0;
+
+	VkPipelineCacheCreateInfo cacheCreateInfo = {};
+	cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheCreateInfo.initialDataSize = cacheData.GetSize();			// Size of data from previous run (0 = empty cache)
+	cacheCreateInfo.pInitialData = cacheData.GetData();				// Data from previous run
+
+	if (vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &cache) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Pipeline Cache!");
+	}
+}
+
+PipelineCache::~PipelineCache()
+{
+	vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+VkPipelineCache PipelineCache::CreateWorkerCache()
+{
+	VkPipelineCacheCreateInfo cacheCreateInfo = {};
+	cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	VkPipelineCache workerCache;
+	if (vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &workerCache) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a worker Pipeline Cache!");
+	}
+
+	return workerCache;
+}
+
+void PipelineCache::MergeWorkerCache(VkPipelineCache workerCache)
+{
+	{
+		std::lock_guard<std::mutex> lock(mergeMutex);
+		if (vkMergePipelineCaches(device, cache, 1, &workerCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to merge Pipeline Caches!");
+		}
+	}
+
+	// Worker cache contents now live in the main cache
+	vkDestroyPipelineCache(device, workerCache, nullptr);
+}
+
+void PipelineCache::Save()
+{
+	std::lock_guard<std::mutex> lock(mergeMutex);
+
+	// Get size of data, then data itself
+	size_t dataSize = 0;
+	vkGetPipelineCacheData(device, cache, &dataSize, nullptr);
+
+	std::vector<char> data(dataSize);
+	if (dataSize == 0 || vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS)
+	{
+		std::cout << "Failed to get Pipeline Cache data, cache not saved\n";
+		return;
+	}
+
+	// Write to a temporary file first, then replace the old cache in one step
+	std::string tempFileName = cacheFileName + ".tmp";
+	{
+		std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Failed to open '" << tempFileName << "', cache not saved\n";
+			return;
+		}
+		file.write(data.data(), dataSize);
+		if (!file)
+		{
+			std::cout << "Failed to write '" << tempFileName << "', cache not saved\n";
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFileName, cacheFileName, error);
+	if (error)
+	{
+		std::cout << "Failed to replace '" << cacheFileName << "': " << error.message() << "\n";
+		std::filesystem::remove(tempFileName, error);
+	}
+}
+
+bool PipelineCache::IsCacheDataValid(const char* data, size_t size)
+{
+	if (size < PIPELINE_CACHE_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	// Header is tightly packed little-endian uint32s followed by the UUID
+	uint32_t headerSize, headerVersion, dataVendorID, dataDeviceID;
+	memcpy(&headerSize, data + 0, sizeof(uint32_t));
+	memcpy(&headerVersion, data + 4, sizeof(uint32_t));
+	memcpy(&dataVendorID, data + 8, sizeof(uint32_t));
+	memcpy(&dataDeviceID, data + 12, sizeof(uint32_t));
+
+	return headerSize >= PIPELINE_CACHE_HEADER_SIZE
+		&& headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& dataVendorID == vendorID
+		&& dataDeviceID == deviceID
+		&& memcmp(data + 16, pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
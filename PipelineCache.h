@@ -0,0 +1,47 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Persistent VkPipelineCache
+// Loads a cache blob from disk at startup (if it was written by the same driver/device),
+// collects caches from worker threads and writes everything back atomically on shutdown.
+class PipelineCache
+{
+public:
+	PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& fileName);
+	~PipelineCache();
+
+	VkPipelineCache		GetCache() { return cache; }
+
+	// True if valid data from a previous run was loaded (pipelines should compile "warm")
+	bool				IsWarm() const { return bWarm; }
+
+	// Worker threads compile into their own cache and merge back when done,
+	// so they never contend on the main cache
+	VkPipelineCache		CreateWorkerCache();
+	void				MergeWorkerCache(VkPipelineCache workerCache);
+
+	// Write current cache contents to disk (temp file + rename, so a crash never leaves a torn file)
+	void				Save();
+
+private:
+	VkDevice			device;
+	VkPipelineCache		cache = VK_NULL_HANDLE;
+	std::string			cacheFileName;
+	bool				bWarm = false;
+
+	// Identity of the device the cache must match
+	uint32_t			vendorID = 0;
+	uint32_t			deviceID = 0;
+	uint8_t				pipelineCacheUUID[VK_UUID_SIZE] = {};
+
+	// vkMergePipelineCaches requires the destination cache to be externally synchronised
+	std::mutex			mergeMutex;
+
+	bool				IsCacheDataValid(const char* data, size_t size);
+};
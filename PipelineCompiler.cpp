@@ -0,0 +1,580 @@
+#include "PipelineCompiler.h"
+#include "CpuProfiler.h"
+#include "Utilities.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+// Viewport and scissor, plus every extended dynamic state a pipeline can leave to the command buffer
+static const uint32_t MAX_DYNAMIC_STATES = 10;
+
+// All fixed function state a VkGraphicsPipelineCreateInfo points to
+// Kept together so a batch of create infos can each own their state
+struct GraphicsPipelineState
+{
+	VkPipelineShaderStageCreateInfo			shaderStages[3];
+	VkPipelineVertexInputStateCreateInfo	vertexInputCreateInfo;
+	VkPipelineInputAssemblyStateCreateInfo	inputAssembly;
+	VkPipelineViewportStateCreateInfo		viewportStateCreateInfo;
+	VkDynamicState							dynamicStates[MAX_DYNAMIC_STATES];
+	VkPipelineDynamicStateCreateInfo		dynamicStateCreateInfo;
+	VkPipelineRasterizationStateCreateInfo	rasterizerCreateInfo;
+	VkPipelineMultisampleStateCreateInfo	multisamplingCreateInfo;
+	VkPipelineColorBlendAttachmentState		colourState;
+	VkPipelineColorBlendStateCreateInfo		colourBlendingCreateInfo;
+	VkPipelineDepthStencilStateCreateInfo	depthStencilCreateInfo;
+#ifdef VK_KHR_dynamic_rendering
+	VkPipelineRenderingCreateInfoKHR		renderingCreateInfo;
+#endif
+
+	void Fill(const GraphicsPipelineDesc& desc, VkGraphicsPipelineCreateInfo& pipelineCreateInfo);
+};
+
+void GraphicsPipelineState::Fill(const GraphicsPipelineDesc& desc, VkGraphicsPipelineCreateInfo& pipelineCreateInfo)
+{
+	// -- SHADER STAGE CREATION INFORMATION --
+	// Vertex Stage creation information
+	shaderStages[0] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;				// Shader Stage name
+	shaderStages[0].module = desc.vertexShader;						// Shader module to be used by stage
+	shaderStages[0].pName = "main";									// Entry point in to shader
+
+	uint32_t stageCount = 1;
+	bool bMeshShading = false;
+#ifdef VK_EXT_mesh_shader
+	// Mesh shading replaces the vertex stage (and all of vertex input with it)
+	if (desc.meshShader != VK_NULL_HANDLE)
+	{
+		bMeshShading = true;
+		stageCount = 0;
+		if (desc.taskShader != VK_NULL_HANDLE)
+		{
+			shaderStages[stageCount] = {};
+			shaderStages[stageCount].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStages[stageCount].stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+			shaderStages[stageCount].module = desc.taskShader;
+			shaderStages[stageCount].pName = "main";
+			++stageCount;
+		}
+		shaderStages[stageCount] = {};
+		shaderStages[stageCount].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[stageCount].stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+		shaderStages[stageCount].module = desc.meshShader;
+		shaderStages[stageCount].pName = "main";
+		++stageCount;
+	}
+#endif
+
+	// Fragment Stage creation information
+	shaderStages[stageCount] = {};
+	shaderStages[stageCount].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[stageCount].stage = VK_SHADER_STAGE_FRAGMENT_BIT;	// Shader Stage name
+	shaderStages[stageCount].module = desc.fragmentShader;			// Shader module to be used by stage
+	shaderStages[stageCount].pName = "main";						// Entry point in to shader
+	++stageCount;
+
+
+	// -- VERTEX INPUT --
+	// Descriptions are generated by the vertex layout (desc outlives the create call, so pointing in to it is safe)
+	const auto& bindingDescriptions = desc.vertexLayout.GetBindingDescriptions();
+	const auto& attributeDescriptions = desc.vertexLayout.GetAttributeDescriptions();
+	vertexInputCreateInfo = {};
+	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+	vertexInputCreateInfo.pVertexBindingDescriptions = bindingDescriptions.data();			// List of Vertex Binding Descriptions (data spacing/stride information)
+	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();		// List of Vertex Attribute Descriptions (data format and where to bind to/from)
+
+
+	// -- INPUT ASSEMBLY --
+	inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = desc.topology;								// Primitive type to assemble vertices as
+	inputAssembly.primitiveRestartEnable = desc.bPrimitiveRestart ? VK_TRUE : VK_FALSE;	// Allow overriding of "strip" topology to start new primitives
+
+
+	// -- VIEWPORT & SCISSOR --
+	// Only the counts are baked in, the rectangles are set per command buffer (see dynamic states)
+	viewportStateCreateInfo = {};
+	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCreateInfo.viewportCount = 1;
+	viewportStateCreateInfo.pViewports = nullptr;
+	viewportStateCreateInfo.scissorCount = 1;
+	viewportStateCreateInfo.pScissors = nullptr;
+
+
+	// -- DYNAMIC STATES --
+	// Dynamic states to enable
+	// Pipelines don't depend on the swapchain extent, so they survive a window resize
+	uint32_t dynamicStateCount = 0;
+	dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_VIEWPORT;	// Dynamic Viewport : Can resize in command buffer with vkCmdSetViewport(commandbuffer, 0, 1, &viewport);
+	dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_SCISSOR;		// Dynamic Scissor	: Can resize in command buffer with vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
+
+	// Extended dynamic state: the values baked in below are ignored, one pipeline serves every value
+	// (topology and primitive restart don't exist for mesh shading pipelines)
+#ifdef VK_EXT_extended_dynamic_state
+	if (desc.bExtendedDynamicState)
+	{
+		dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_CULL_MODE_EXT;
+		dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_FRONT_FACE_EXT;
+		dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT;
+		dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT;
+		dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT;
+		if (!bMeshShading)
+		{
+			dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT;
+		}
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+	if (desc.bExtendedDynamicState2 && !bMeshShading)
+	{
+		dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT;
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+	if (desc.bExtendedDynamicState3)
+	{
+		dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+	}
+#endif
+
+	// Dynamic State creation info
+	dynamicStateCreateInfo = {};
+	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCreateInfo.dynamicStateCount = dynamicStateCount;
+	dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+
+	// -- RASTERIZER --
+	rasterizerCreateInfo = {};
+	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizerCreateInfo.depthClampEnable = VK_FALSE;			// Change if fragments beyond near/far planes are clipped (default) or clamped to plane
+	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;	// Whether to discard data and skip rasterizer. Never creates fragments, only suitable for pipeline without framebuffer output
+	rasterizerCreateInfo.polygonMode = desc.polygonMode;		// How to handle filling points between vertices
+	rasterizerCreateInfo.lineWidth = 1.0f;						// How thick lines should be when drawn
+	rasterizerCreateInfo.cullMode = desc.cullMode;				// Which face of a tri to cull
+	rasterizerCreateInfo.frontFace = desc.frontFace;			// Winding to determine which side is front
+	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;			// Whether to add depth bias to fragments (good for stopping "shadow acne" in shadow mapping)
+
+
+	// -- MULTISAMPLING --
+	multisamplingCreateInfo = {};
+	multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;					// Enable multisample shading or not
+	multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;	// Number of samples to use per fragment
+
+
+	// -- BLENDING --
+	// Blending decides how to blend a new colour being written to a fragment, with the old value
+
+	// Blend Attachment State (how blending is handled)
+	colourState = {};
+	colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT	// Colours to apply blending to
+		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colourState.blendEnable = desc.bBlendEnable ? VK_TRUE : VK_FALSE;					// Enable blending
+
+	// Blending uses equation: (srcColorBlendFactor * new colour) colorBlendOp (dstColorBlendFactor * old colour)
+	colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colourState.colorBlendOp = VK_BLEND_OP_ADD;
+
+	// Summarised: (VK_BLEND_FACTOR_SRC_ALPHA * new colour) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * old colour)
+	//			   (new colour alpha * new colour) + ((1 - new colour alpha) * old colour)
+
+	colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colourState.alphaBlendOp = VK_BLEND_OP_ADD;
+	// Summarised: (1 * new alpha) + (0 * old alpha) = new alpha
+
+	colourBlendingCreateInfo = {};
+	colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colourBlendingCreateInfo.logicOpEnable = VK_FALSE;				// Alternative to calculations is to use logical operations
+	colourBlendingCreateInfo.attachmentCount = 1;
+	colourBlendingCreateInfo.pAttachments = &colourState;
+
+
+	// -- DEPTH STENCIL TESTING --
+	// Ignored when the pass has no depth attachment
+	depthStencilCreateInfo = {};
+	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilCreateInfo.depthTestEnable = desc.bDepthTest ? VK_TRUE : VK_FALSE;		// Compare fragments against the depth buffer
+	depthStencilCreateInfo.depthWriteEnable = desc.bDepthWrite ? VK_TRUE : VK_FALSE;	// Write depth of fragments that pass
+	depthStencilCreateInfo.depthCompareOp = desc.depthCompareOp;
+	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
+
+	// -- GRAPHICS PIPELINE CREATION --
+	pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stageCount = stageCount;							// Number of shader stages
+	pipelineCreateInfo.pStages = shaderStages;							// List of shader stages
+	pipelineCreateInfo.pVertexInputState = bMeshShading ? nullptr : &vertexInputCreateInfo;		// All the fixed function pipeline states
+	pipelineCreateInfo.pInputAssemblyState = bMeshShading ? nullptr : &inputAssembly;
+	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+	pipelineCreateInfo.layout = desc.layout;							// Pipeline Layout pipeline should use
+	pipelineCreateInfo.renderPass = desc.renderPass;					// Render pass description the pipeline is compatible with
+	pipelineCreateInfo.subpass = desc.subpass;							// Subpass of render pass to use with pipeline
+
+#ifdef VK_KHR_dynamic_rendering
+	// No render pass: attachment formats come from the description (desc outlives the create call)
+	if (desc.renderPass == VK_NULL_HANDLE)
+	{
+		renderingCreateInfo = {};
+		renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		renderingCreateInfo.colorAttachmentCount = static_cast<uint32_t>(desc.colourFormats.size());
+		renderingCreateInfo.pColorAttachmentFormats = desc.colourFormats.data();
+		renderingCreateInfo.depthAttachmentFormat = desc.depthFormat;
+		renderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+		pipelineCreateInfo.pNext = &renderingCreateInfo;
+		pipelineCreateInfo.subpass = 0;
+	}
+#endif
+
+	// Pipeline Derivatives : Can create multiple pipelines that derive from one another for optimisation
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;	// Existing pipeline to derive from...
+	pipelineCreateInfo.basePipelineIndex = -1;				// or index of pipeline being created to derive from (in case creating multiple at once)
+}
+
+PipelineCompiler::PipelineCompiler(VkDevice device, PipelineCache* pipelineCache, int threadCount)
+	: device(device), pipelineCache(pipelineCache)
+{
+	// Leave one core for the render thread by default
+	if (threadCount <= 0)
+	{
+		threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+	}
+
+	for (int i = 0; i < threadCount; ++i)
+	{
+		workers.emplace_back(&PipelineCompiler::WorkerLoop, this);
+	}
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		bStopping = true;
+
+		// Anything not started yet is cancelled
+		for (auto& request : requests)
+		{
+			request.promise.set_value(VK_NULL_HANDLE);
+		}
+		requests.clear();
+	}
+	queueCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	for (VkPipeline pipeline : compiledPipelines)
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::Compile(const GraphicsPipelineDesc& desc)
+{
+	CompileRequest request;
+	request.desc = desc;
+	std::shared_future<VkPipeline> future = request.promise.get_future().share();
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+
+		// Permutations that only differ in dynamic state share one pipeline
+		// Compatible descriptions always hash the same, so only the (almost always single entry) bucket is checked
+		auto& bucket = queuedPipelines[HashCompatibleState(desc)];
+		for (const auto& queued : bucket)
+		{
+			if (IsCompatible(queued.first, desc))
+			{
+				sharedCount++;
+				return queued.second;
+			}
+		}
+
+		bucket.push_back({ desc, future });
+		requests.push_back(std::move(request));
+	}
+	queueCondition.notify_one();
+
+	return future;
+}
+
+VkPipeline PipelineCompiler::ReadyOr(const std::shared_future<VkPipeline>& pipeline, VkPipeline fallback)
+{
+	if (!pipeline.valid() || pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		return fallback;
+	}
+
+	VkPipeline readyPipeline = pipeline.get();
+	return readyPipeline != VK_NULL_HANDLE ? readyPipeline : fallback;
+}
+
+void PipelineCompiler::CreateGraphicsPipelines(VkDevice device, VkPipelineCache cache, const GraphicsPipelineDesc* descs, uint32_t count, VkPipeline* pipelines)
+{
+	// State must outlive the create call, and must not move once create infos point at it
+	std::vector<GraphicsPipelineState> states(count);
+	std::vector<VkGraphicsPipelineCreateInfo> createInfos(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		states[i].Fill(descs[i], createInfos[i]);
+	}
+
+	if (vkCreateGraphicsPipelines(device, cache, count, createInfos.data(), nullptr, pipelines) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Graphics Pipeline!");
+	}
+}
+
+// Topologies a pipeline with dynamic topology can draw (without dynamicPrimitiveTopologyUnrestricted)
+static int GetTopologyClass(VkPrimitiveTopology topology)
+{
+	switch (topology)
+	{
+	case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+		return 0;
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+		return 1;
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+		return 2;
+	default:
+		// Adjacency and patch lists, only compatible with themselves
+		return 3 + static_cast<int>(topology);
+	}
+}
+
+static bool IsSameVertexLayout(const VertexLayout& a, const VertexLayout& b)
+{
+	const auto& bindingsA = a.GetBindingDescriptions();
+	const auto& bindingsB = b.GetBindingDescriptions();
+	const auto& attributesA = a.GetAttributeDescriptions();
+	const auto& attributesB = b.GetAttributeDescriptions();
+	if (bindingsA.size() != bindingsB.size() || attributesA.size() != attributesB.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < bindingsA.size(); ++i)
+	{
+		if (bindingsA[i].binding != bindingsB[i].binding || bindingsA[i].stride != bindingsB[i].stride || bindingsA[i].inputRate != bindingsB[i].inputRate)
+		{
+			return false;
+		}
+	}
+	for (size_t i = 0; i < attributesA.size(); ++i)
+	{
+		if (attributesA[i].location != attributesB[i].location || attributesA[i].binding != attributesB[i].binding
+			|| attributesA[i].format != attributesB[i].format || attributesA[i].offset != attributesB[i].offset)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t PipelineCompiler::HashCompatibleState(const GraphicsPipelineDesc& desc)
+{
+	uint64_t hash = HashFNV1a(&desc.vertexShader, sizeof(desc.vertexShader));
+	auto hashValue = [&hash](const auto& value) { hash = HashFNV1a(&value, sizeof(value), hash); };
+
+	// Always baked in
+	hashValue(desc.fragmentShader);
+	hashValue(desc.taskShader);
+	hashValue(desc.meshShader);
+	hashValue(desc.layout);
+	hashValue(desc.renderPass);
+	hashValue(desc.subpass);
+	hashValue(desc.colourFormats.size());
+	hash = HashFNV1a(desc.colourFormats.data(), desc.colourFormats.size() * sizeof(VkFormat), hash);
+	hashValue(desc.depthFormat);
+	hashValue(desc.polygonMode);
+	hashValue(desc.bExtendedDynamicState);
+	hashValue(desc.bExtendedDynamicState2);
+	hashValue(desc.bExtendedDynamicState3);
+
+	if (desc.meshShader == VK_NULL_HANDLE)
+	{
+		for (const auto& binding : desc.vertexLayout.GetBindingDescriptions())
+		{
+			hashValue(binding.binding);
+			hashValue(binding.stride);
+			hashValue(binding.inputRate);
+		}
+		for (const auto& attribute : desc.vertexLayout.GetAttributeDescriptions())
+		{
+			hashValue(attribute.location);
+			hashValue(attribute.binding);
+			hashValue(attribute.format);
+			hashValue(attribute.offset);
+		}
+		hashValue(desc.bExtendedDynamicState ? GetTopologyClass(desc.topology) : static_cast<int>(desc.topology));
+		if (!desc.bExtendedDynamicState2)
+		{
+			hashValue(desc.bPrimitiveRestart);
+		}
+	}
+
+	// Only matter when baked in
+	if (!desc.bExtendedDynamicState)
+	{
+		hashValue(desc.cullMode);
+		hashValue(desc.frontFace);
+		hashValue(desc.bDepthTest);
+		hashValue(desc.bDepthWrite);
+		hashValue(desc.depthCompareOp);
+	}
+	if (!desc.bExtendedDynamicState3)
+	{
+		hashValue(desc.bBlendEnable);
+	}
+	return hash;
+}
+
+bool PipelineCompiler::IsCompatible(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b)
+{
+	// Always baked in
+	if (a.vertexShader != b.vertexShader || a.fragmentShader != b.fragmentShader || a.taskShader != b.taskShader || a.meshShader != b.meshShader
+		|| a.layout != b.layout || a.renderPass != b.renderPass || a.subpass != b.subpass
+		|| a.colourFormats != b.colourFormats || a.depthFormat != b.depthFormat || a.polygonMode != b.polygonMode
+		|| a.bExtendedDynamicState != b.bExtendedDynamicState || a.bExtendedDynamicState2 != b.bExtendedDynamicState2
+		|| a.bExtendedDynamicState3 != b.bExtendedDynamicState3)
+	{
+		return false;
+	}
+
+	// Mesh shading pipelines have no vertex input or input assembly
+	bool bMeshShading = a.meshShader != VK_NULL_HANDLE;
+	if (!bMeshShading)
+	{
+		if (!IsSameVertexLayout(a.vertexLayout, b.vertexLayout))
+		{
+			return false;
+		}
+		if (a.bExtendedDynamicState ? GetTopologyClass(a.topology) != GetTopologyClass(b.topology) : a.topology != b.topology)
+		{
+			return false;
+		}
+		if (!a.bExtendedDynamicState2 && a.bPrimitiveRestart != b.bPrimitiveRestart)
+		{
+			return false;
+		}
+	}
+
+	// Only matter when baked in
+	if (!a.bExtendedDynamicState && (a.cullMode != b.cullMode || a.frontFace != b.frontFace || a.bDepthTest != b.bDepthTest
+		|| a.bDepthWrite != b.bDepthWrite || a.depthCompareOp != b.depthCompareOp))
+	{
+		return false;
+	}
+	if (!a.bExtendedDynamicState3 && a.bBlendEnable != b.bBlendEnable)
+	{
+		return false;
+	}
+	return true;
+}
+
+size_t PipelineCompiler::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return requests.size();
+}
+
+size_t PipelineCompiler::GetCompiledCount()
+{
+	std::lock_guard<std::mutex> lock(compiledMutex);
+	return compiledPipelines.size();
+}
+
+size_t PipelineCompiler::GetSharedCount()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return sharedCount;
+}
+
+void PipelineCompiler::WorkerLoop()
+{
+	PROFILE_THREAD_NAME("PipelineCompiler");
+
+	// Own cache per worker, so workers never serialise on the main cache
+	VkPipelineCache workerCache = pipelineCache->CreateWorkerCache();
+
+	while (true)
+	{
+		std::vector<CompileRequest> batch;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return bStopping || !requests.empty(); });
+
+			if (bStopping)
+			{
+				break;
+			}
+
+			// Take as many queued requests as fit in one batch
+			while (!requests.empty() && batch.size() < MAX_BATCH_SIZE)
+			{
+				batch.push_back(std::move(requests.front()));
+				requests.pop_front();
+			}
+		}
+
+		CompileBatch(batch, workerCache);
+	}
+
+	pipelineCache->MergeWorkerCache(workerCache);
+}
+
+void PipelineCompiler::CompileBatch(std::vector<CompileRequest>& batch, VkPipelineCache workerCache)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<GraphicsPipelineDesc> descs;
+	descs.reserve(batch.size());
+	for (const auto& request : batch)
+	{
+		descs.push_back(request.desc);
+	}
+
+	std::vector<VkPipeline> pipelines(batch.size(), VK_NULL_HANDLE);
+	try
+	{
+		CreateGraphicsPipelines(device, workerCache, descs.data(), static_cast<uint32_t>(descs.size()), pipelines.data());
+	}
+	catch (const std::runtime_error&)
+	{
+		// Keep whatever did compile, failed entries stay VK_NULL_HANDLE
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(compiledMutex);
+		for (VkPipeline pipeline : pipelines)
+		{
+			if (pipeline != VK_NULL_HANDLE)
+			{
+				compiledPipelines.push_back(pipeline);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		batch[i].promise.set_value(pipelines[i]);
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <deque>
+#include <future>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "PipelineCache.h"
+#include "VertexLayout.h"
+
+// Everything needed to build one graphics pipeline permutation
+// Referenced objects (shader modules, layout, render pass) must stay alive until the pipeline is ready
+struct GraphicsPipelineDesc
+{
+	VkShaderModule			vertexShader = VK_NULL_HANDLE;
+	VkShaderModule			fragmentShader = VK_NULL_HANDLE;
+	// Set meshShader (and optionally taskShader) instead of vertexShader for a mesh shading pipeline (VK_EXT_mesh_shader),
+	// which has no vertex input or input assembly state
+	VkShaderModule			taskShader = VK_NULL_HANDLE;
+	VkShaderModule			meshShader = VK_NULL_HANDLE;
+	VkPipelineLayout		layout = VK_NULL_HANDLE;
+	VkRenderPass			renderPass = VK_NULL_HANDLE;
+	uint32_t				subpass = 0;
+	// With no render pass (VK_KHR_dynamic_rendering) the pipeline is described by the formats of the attachments it renders to
+	std::vector<VkFormat>	colourFormats;
+	VkFormat				depthFormat = VK_FORMAT_UNDEFINED;
+	VertexLayout			vertexLayout;				// Must match the streams of the meshes drawn with the pipeline
+
+	// Viewport and scissor are always dynamic state, set when recording
+	VkPrimitiveTopology		topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	bool					bPrimitiveRestart = false;
+	VkPolygonMode			polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags			cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace				frontFace = VK_FRONT_FACE_CLOCKWISE;
+	bool					bDepthTest = false;			// Only used in passes with a depth attachment
+	bool					bDepthWrite = false;
+	VkCompareOp				depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	bool					bBlendEnable = true;
+
+	// Extended dynamic state to use (only what the device supports, see DeviceSupport)
+	// States it covers are left to the command buffer (see RecordDynamicState), so they no longer tell pipelines apart
+	bool					bExtendedDynamicState = false;		// Cull mode, front face, topology (within its class), depth test, write and compare
+	bool					bExtendedDynamicState2 = false;		// Primitive restart
+	bool					bExtendedDynamicState3 = false;		// Blend enable
+};
+
+// Background pipeline compilation service
+// Descriptions are queued and compiled on worker threads in batches (one vkCreateGraphicsPipelines call per batch),
+// each worker using its own pipeline cache that is merged back into the main one on shutdown.
+class PipelineCompiler
+{
+public:
+	PipelineCompiler(VkDevice device, PipelineCache* pipelineCache, int threadCount = 0);
+	~PipelineCompiler();
+
+	// Queue a pipeline for compilation. Future holds VK_NULL_HANDLE if compilation failed or was cancelled.
+	// Pipelines are owned by the compiler and destroyed with it.
+	// A description compatible with one already queued shares its pipeline instead of compiling another.
+	std::shared_future<VkPipeline>	Compile(const GraphicsPipelineDesc& desc);
+
+	// Pipeline if it has finished compiling, otherwise the fallback (never blocks)
+	static VkPipeline				ReadyOr(const std::shared_future<VkPipeline>& pipeline, VkPipeline fallback);
+
+	// Synchronous batch creation on the calling thread
+	static void						CreateGraphicsPipelines(VkDevice device, VkPipelineCache cache, const GraphicsPipelineDesc* descs, uint32_t count, VkPipeline* pipelines);
+
+	// Descriptions that only differ in state the pipelines leave dynamic can be drawn with the same pipeline
+	static bool						IsCompatible(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b);
+
+	size_t							GetPendingCount();
+	size_t							GetCompiledCount();
+	size_t							GetSharedCount();		// Compile calls given a pipeline already queued
+
+private:
+	struct CompileRequest
+	{
+		GraphicsPipelineDesc		desc;
+		std::promise<VkPipeline>	promise;
+	};
+
+	// Max pipelines handed to the driver in a single call
+	static const size_t				MAX_BATCH_SIZE = 16;
+
+	VkDevice						device;
+	PipelineCache*					pipelineCache;
+
+	std::vector<std::thread>		workers;
+	std::deque<CompileRequest>		requests;
+	// Everything ever queued, keyed by a hash of the state IsCompatible compares (colliding descriptions share a bucket)
+	std::unordered_map<uint64_t, std::vector<std::pair<GraphicsPipelineDesc, std::shared_future<VkPipeline>>>> queuedPipelines;
+	size_t							sharedCount = 0;
+	std::mutex						queueMutex;
+	std::condition_variable			queueCondition;
+	bool							bStopping = false;
+
+	std::vector<VkPipeline>			compiledPipelines;
+	std::mutex						compiledMutex;
+
+	// Hash of exactly the state IsCompatible compares, so compatible descriptions always get the same key
+	static uint64_t					HashCompatibleState(const GraphicsPipelineDesc& desc);
+
+	void							WorkerLoop();
+	void							CompileBatch(std::vector<CompileRequest>& batch, VkPipelineCache workerCache);
+};
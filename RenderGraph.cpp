@@ -0,0 +1,888 @@
+#include "RenderGraph.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+// Accesses that make earlier results visible to later ones, only these go in a barrier's source access mask
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+	| VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+RenderGraph::RenderGraph(VkDevice device, GpuAllocator* allocator, GpuProfiler* profiler, bool bDynamicRendering)
+	: device(device), allocator(allocator), profiler(profiler)
+{
+#ifdef VK_KHR_dynamic_rendering
+	// Extension entry points, render passes are used if they can't be loaded
+	if (bDynamicRendering)
+	{
+		pfnCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+		pfnCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+		this->bDynamicRendering = pfnCmdBeginRendering != nullptr && pfnCmdEndRendering != nullptr;
+	}
+#endif
+}
+
+RenderGraph::~RenderGraph()
+{
+	// Owner has waited for the device, nothing is in flight
+	Reset(0);
+	Reclaim(UINT64_MAX);
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportImage(const std::string& name, const ImageDesc& desc, const ImageState& initialState, const ImageState& finalState)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.bImported = true;
+	resource.initialState = initialState;
+	resource.finalState = finalState;
+	resources.push_back(resource);
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateImage(const std::string& name, const ImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.bImported = false;
+	resources.push_back(resource);
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(const std::string& name, bool bGraphics, const ExecuteFunction& execute, bool bSideEffects)
+{
+	Pass pass;
+	pass.name = name;
+	pass.bGraphics = bGraphics;
+	pass.bSideEffects = bSideEffects;
+	pass.execute = execute;
+	passes.push_back(pass);
+	return static_cast<PassHandle>(passes.size() - 1);
+}
+
+void RenderGraph::Read(PassHandle pass, ResourceHandle resource, Usage usage)
+{
+	passes[pass].uses.push_back({ resource, usage, false, false, {} });
+}
+
+void RenderGraph::Write(PassHandle pass, ResourceHandle resource, Usage usage, const VkClearValue* clear)
+{
+	passes[pass].uses.push_back({ resource, usage, true, clear != nullptr, clear != nullptr ? *clear : VkClearValue{} });
+}
+
+void RenderGraph::Compile()
+{
+	PROFILE_FUNCTION();
+
+	stats = Stats();
+	stats.passCount = static_cast<uint32_t>(passes.size());
+
+	CullPasses();
+	ComputeLifetimes();
+	CreateTransientImages();
+	ComputeBarriers();
+	CreateRenderPasses();
+
+	bCompiled = true;
+}
+
+void RenderGraph::Reset(uint64_t serial)
+{
+	for (auto& framebuffer : framebufferCache)
+	{
+		compiled.framebuffers.push_back(framebuffer.second);
+	}
+	framebufferCache.clear();
+
+	// Frames up to serial may still use them
+	compiled.serial = serial;
+	retired.push_back(std::move(compiled));
+	compiled = CompiledObjects();
+
+	passes.clear();
+	resources.clear();
+	finalBarriers.clear();
+	stats = Stats();
+	bCompiled = false;
+}
+
+void RenderGraph::Reclaim(uint64_t completedSerial)
+{
+	for (size_t i = 0; i < retired.size();)
+	{
+		if (retired[i].serial > completedSerial)
+		{
+			++i;
+			continue;
+		}
+
+		DestroyCompiled(retired[i]);
+		retired.erase(retired.begin() + i);
+	}
+}
+
+void RenderGraph::SetImportedImage(ResourceHandle resource, VkImage image, VkImageView imageView)
+{
+	resources[resource].image = image;
+	resources[resource].imageView = imageView;
+}
+
+void RenderGraph::SetPassContents(PassHandle pass, VkSubpassContents contents)
+{
+	passes[pass].contents = contents;
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+{
+	PROFILE_FUNCTION();
+
+	if (!bCompiled)
+	{
+		throw std::runtime_error("Failed to execute an uncompiled Render Graph!");
+	}
+
+	for (PassHandle p = 0; p < passes.size(); ++p)
+	{
+		Pass& pass = passes[p];
+		if (pass.bCulled)
+		{
+			continue;
+		}
+
+		RecordBarriers(commandBuffer, pass.barriers);
+
+		// Timestamps around the whole pass, written when the scope closes after the render pass ends
+		GpuProfileScope passScope(profiler, commandBuffer, pass.name);
+
+		PassContext context;
+		context.commandBuffer = commandBuffer;
+		context.extent = pass.extent;
+		if (pass.bGraphics)
+		{
+			BeginPass(commandBuffer, p, context);
+		}
+
+		pass.execute(context);
+
+		if (pass.bGraphics)
+		{
+			EndPass(commandBuffer);
+		}
+	}
+
+	// Imported images are handed back in the state they were imported with
+	RecordBarriers(commandBuffer, finalBarriers);
+}
+
+void RenderGraph::PrintSummary() const
+{
+	std::cout << "Render graph: " << stats.passCount - stats.culledPassCount << " of " << stats.passCount << " passes live, "
+		<< stats.barrierCount << " image barriers in " << stats.barrierBatchCount << " batches, "
+		<< (bDynamicRendering ? "dynamic rendering" : std::to_string(stats.renderPassCount) + " render passes, " + std::to_string(stats.framebufferCount) + " framebuffers") << "\n";
+	for (const Pass& pass : passes)
+	{
+		std::cout << "  " << (pass.bCulled ? "[culled] " : "") << pass.name;
+		if (!pass.bCulled)
+		{
+			std::cout << " (" << pass.barriers.size() << " barriers)";
+		}
+		std::cout << "\n";
+	}
+
+	for (const Resource& resource : resources)
+	{
+		if (resource.bImported || resource.firstPass == UINT32_MAX)
+		{
+			continue;
+		}
+		std::cout << "  " << resource.name << ": passes " << resource.firstPass << "-" << resource.lastPass << ", "
+			<< resource.memoryRequirements.size / 1024 << " KB at offset " << resource.memoryOffset / 1024 << " KB\n";
+	}
+
+	std::cout << "  Transient memory: " << stats.transientCount << " images, " << stats.transientBytes / (1024.0 * 1024.0) << " MB without aliasing, "
+		<< stats.aliasedBytes / (1024.0 * 1024.0) << " MB aliased\n";
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk back from the outputs: imported images are observed outside the graph, so their writers are live
+	std::vector<bool> bNeeded(resources.size(), false);
+	for (size_t r = 0; r < resources.size(); ++r)
+	{
+		bNeeded[r] = resources[r].bImported;
+	}
+
+	for (size_t p = passes.size(); p-- > 0;)
+	{
+		Pass& pass = passes[p];
+
+		bool bLive = pass.bSideEffects;
+		for (const ResourceUse& use : pass.uses)
+		{
+			bLive = bLive || (use.bWrite && bNeeded[use.resource]);
+		}
+
+		pass.bCulled = !bLive;
+		if (pass.bCulled)
+		{
+			stats.culledPassCount++;
+			continue;
+		}
+
+		// Before this pass, what it clears is dead, and what it reads or loads is needed
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (use.bWrite && use.bClear)
+			{
+				bNeeded[use.resource] = false;
+			}
+		}
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (!use.bWrite || !use.bClear)
+			{
+				bNeeded[use.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (uint32_t p = 0; p < passes.size(); ++p)
+	{
+		if (passes[p].bCulled)
+		{
+			continue;
+		}
+
+		for (const ResourceUse& use : passes[p].uses)
+		{
+			Resource& resource = resources[use.resource];
+			resource.firstPass = std::min(resource.firstPass, p);
+			resource.lastPass = std::max(resource.lastPass, p);
+			resource.usage |= GetImageUsage(use.usage);
+		}
+	}
+}
+
+void RenderGraph::CreateTransientImages()
+{
+	PROFILE_FUNCTION();
+
+	std::vector<ResourceHandle> transients;
+	for (ResourceHandle r = 0; r < resources.size(); ++r)
+	{
+		Resource& resource = resources[r];
+		if (resource.bImported || resource.firstPass == UINT32_MAX)
+		{
+			continue;
+		}
+
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.format = resource.desc.format;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.usage = resource.usage;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &imageCreateInfo, nullptr, &resource.image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a transient Image!");
+		}
+		compiled.images.push_back(resource.image);
+
+		vkGetImageMemoryRequirements(device, resource.image, &resource.memoryRequirements);
+		transients.push_back(r);
+	}
+
+	stats.transientCount = static_cast<uint32_t>(transients.size());
+	if (transients.empty())
+	{
+		return;
+	}
+
+	// Largest first, each at the lowest offset clear of every image placed so far whose lifetime overlaps its own
+	std::sort(transients.begin(), transients.end(), [this](ResourceHandle a, ResourceHandle b)
+	{
+		return resources[a].memoryRequirements.size > resources[b].memoryRequirements.size;
+	});
+
+	VkMemoryRequirements heapRequirements = {};
+	heapRequirements.alignment = 1;
+	heapRequirements.memoryTypeBits = ~0u;
+	std::vector<ResourceHandle> placed;
+	for (ResourceHandle r : transients)
+	{
+		Resource& resource = resources[r];
+		const VkMemoryRequirements& requirements = resource.memoryRequirements;
+
+		std::vector<ResourceHandle> live;
+		for (ResourceHandle other : placed)
+		{
+			if (resources[other].firstPass <= resource.lastPass && resource.firstPass <= resources[other].lastPass)
+			{
+				live.push_back(other);
+			}
+		}
+		std::sort(live.begin(), live.end(), [this](ResourceHandle a, ResourceHandle b) { return resources[a].memoryOffset < resources[b].memoryOffset; });
+
+		VkDeviceSize offset = 0;
+		for (ResourceHandle other : live)
+		{
+			if (offset + requirements.size <= resources[other].memoryOffset)
+			{
+				break;
+			}
+			offset = std::max(offset, AlignUp(resources[other].memoryOffset + resources[other].memoryRequirements.size, requirements.alignment));
+		}
+		resource.memoryOffset = offset;
+		placed.push_back(r);
+
+		heapRequirements.size = std::max(heapRequirements.size, offset + requirements.size);
+		heapRequirements.alignment = std::max(heapRequirements.alignment, requirements.alignment);
+		heapRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+		stats.transientBytes += AlignUp(requirements.size, requirements.alignment);
+	}
+	stats.aliasedBytes = heapRequirements.size;
+
+	if (heapRequirements.memoryTypeBits == 0)
+	{
+		throw std::runtime_error("Failed to find a memory type every transient Image can use!");
+	}
+
+	// One range holds every transient image
+	compiled.memory = allocator->Allocate(heapRequirements, MemoryUsage::GpuOnly, false);
+	if (compiled.memory.memory == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("Failed to allocate transient Image memory!");
+	}
+
+	for (ResourceHandle r : transients)
+	{
+		Resource& resource = resources[r];
+		vkBindImageMemory(device, resource.image, compiled.memory.memory, compiled.memory.offset + resource.memoryOffset);
+
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = resource.image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = resource.desc.format;
+		viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+		viewCreateInfo.subresourceRange.aspectMask = IsDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCreateInfo.subresourceRange.levelCount = 1;
+		viewCreateInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &viewCreateInfo, nullptr, &resource.imageView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a transient Image View!");
+		}
+		compiled.imageViews.push_back(resource.imageView);
+	}
+}
+
+void RenderGraph::ComputeBarriers()
+{
+	// State each pass leaves an image in: a read after a read in the same layout needs no barrier, so readers accumulate
+	auto apply = [](ImageState& state, const ImageState& use) -> bool
+	{
+		bool bBarrier = state.layout != use.layout || (state.access & WRITE_ACCESS) != 0 || (use.access & WRITE_ACCESS) != 0;
+		if (bBarrier)
+		{
+			state = use;
+		}
+		else
+		{
+			state.stages |= use.stages;
+			state.access |= use.access;
+		}
+		return bBarrier;
+	};
+
+	// What each pass needs of every image it uses (all of its uses must agree on the layout)
+	std::vector<std::vector<std::pair<ResourceHandle, ImageState>>> passStates(passes.size());
+	for (size_t p = 0; p < passes.size(); ++p)
+	{
+		if (passes[p].bCulled)
+		{
+			continue;
+		}
+
+		for (const ResourceUse& use : passes[p].uses)
+		{
+			ImageState state = GetUsageState(use.usage);
+			auto existing = std::find_if(passStates[p].begin(), passStates[p].end(), [&](const auto& entry) { return entry.first == use.resource; });
+			if (existing == passStates[p].end())
+			{
+				passStates[p].push_back({ use.resource, state });
+			}
+			else if (existing->second.layout != state.layout)
+			{
+				throw std::runtime_error("Failed to compile Render Graph: " + resources[use.resource].name + " used in two layouts by " + passes[p].name + "!");
+			}
+			else
+			{
+				existing->second.stages |= state.stages;
+				existing->second.access |= state.access;
+			}
+		}
+	}
+
+	// Last state of every image in a frame: an image aliasing a transient must wait for it, in this frame or the one before
+	std::vector<ImageState> endStates(resources.size());
+	std::vector<bool> bUsed(resources.size(), false);
+	for (size_t p = 0; p < passes.size(); ++p)
+	{
+		for (const auto& entry : passStates[p])
+		{
+			if (!bUsed[entry.first])
+			{
+				endStates[entry.first] = entry.second;
+				bUsed[entry.first] = true;
+			}
+			else
+			{
+				apply(endStates[entry.first], entry.second);
+			}
+		}
+	}
+
+	std::vector<ImageState> states(resources.size());
+	std::fill(bUsed.begin(), bUsed.end(), false);
+	for (size_t p = 0; p < passes.size(); ++p)
+	{
+		for (const auto& entry : passStates[p])
+		{
+			const Resource& resource = resources[entry.first];
+			ImageState& state = states[entry.first];
+			ImageState src = state;
+			bool bBarrier;
+
+			if (!bUsed[entry.first] && !resource.bImported)
+			{
+				// Contents start undefined, but the memory may still be in use by the images sharing it
+				src = ImageState();
+				src.stages = 0;
+				for (ResourceHandle other = 0; other < resources.size(); ++other)
+				{
+					const Resource& alias = resources[other];
+					if (alias.bImported || alias.firstPass == UINT32_MAX
+						|| alias.memoryOffset >= resource.memoryOffset + resource.memoryRequirements.size
+						|| resource.memoryOffset >= alias.memoryOffset + alias.memoryRequirements.size)
+					{
+						continue;
+					}
+					src.stages |= endStates[other].stages;
+					src.access |= endStates[other].access;
+				}
+				state = entry.second;
+				bBarrier = true;
+			}
+			else
+			{
+				if (!bUsed[entry.first])
+				{
+					state = resource.initialState;
+					src = state;
+				}
+				bBarrier = apply(state, entry.second);
+			}
+			bUsed[entry.first] = true;
+
+			if (bBarrier)
+			{
+				src.access &= WRITE_ACCESS;
+				passes[p].barriers.push_back({ entry.first, src, entry.second });
+			}
+		}
+
+		if (!passes[p].barriers.empty())
+		{
+			stats.barrierCount += static_cast<uint32_t>(passes[p].barriers.size());
+			stats.barrierBatchCount++;
+		}
+	}
+
+	// Imported images go back to the state the frame hands them on in (written results must be made visible)
+	for (ResourceHandle r = 0; r < resources.size(); ++r)
+	{
+		const Resource& resource = resources[r];
+		if (!resource.bImported)
+		{
+			continue;
+		}
+
+		ImageState state = bUsed[r] ? states[r] : resource.initialState;
+		if (state.layout != resource.finalState.layout || (state.access & WRITE_ACCESS) != 0)
+		{
+			state.access &= WRITE_ACCESS;
+			finalBarriers.push_back({ r, state, resource.finalState });
+		}
+	}
+	if (!finalBarriers.empty())
+	{
+		stats.barrierCount += static_cast<uint32_t>(finalBarriers.size());
+		stats.barrierBatchCount++;
+	}
+}
+
+void RenderGraph::CreateRenderPasses()
+{
+	PROFILE_FUNCTION();
+
+	for (uint32_t p = 0; p < passes.size(); ++p)
+	{
+		Pass& pass = passes[p];
+		if (pass.bCulled || !pass.bGraphics)
+		{
+			continue;
+		}
+
+		// Attachments, and how they are loaded and stored, are worked out for both paths
+		std::vector<VkAttachmentDescription> attachmentDescs;
+		std::vector<VkAttachmentReference> colourReferences;
+		VkAttachmentReference depthReference = {};
+		bool bDepth = false;
+
+		for (const ResourceUse& use : pass.uses)
+		{
+			bool bColour = use.usage == Usage::ColourAttachment;
+			if (!bColour && use.usage != Usage::DepthAttachment && use.usage != Usage::DepthRead)
+			{
+				continue;
+			}
+
+			const Resource& resource = resources[use.resource];
+			if (!bColour && bDepth)
+			{
+				throw std::runtime_error("Failed to compile Render Graph: " + pass.name + " has two depth attachments!");
+			}
+			if (pass.attachments.empty())
+			{
+				pass.extent = resource.desc.extent;
+			}
+			else if (pass.extent.width != resource.desc.extent.width || pass.extent.height != resource.desc.extent.height)
+			{
+				throw std::runtime_error("Failed to compile Render Graph: attachments of " + pass.name + " differ in size!");
+			}
+
+			// Earlier contents are only loaded if something wrote them, and results only stored if something uses them later
+			bool bEarlierContents = resource.bImported ? resource.initialState.layout != VK_IMAGE_LAYOUT_UNDEFINED : resource.firstPass < p;
+			bool bLaterUse = resource.bImported || resource.lastPass > p;
+			VkImageLayout layout = GetUsageState(use.usage).layout;
+
+			VkAttachmentDescription attachmentDesc = {};
+			attachmentDesc.format = resource.desc.format;
+			attachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDesc.loadOp = use.bClear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (bEarlierContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+			attachmentDesc.storeOp = bLaterUse ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+			// The graph's barriers do every transition, the pass itself keeps the layout
+			attachmentDesc.initialLayout = layout;
+			attachmentDesc.finalLayout = layout;
+
+			VkAttachmentReference reference = { static_cast<uint32_t>(attachmentDescs.size()), layout };
+			if (bColour)
+			{
+				colourReferences.push_back(reference);
+				pass.colourFormats.push_back(resource.desc.format);
+			}
+			else
+			{
+				depthReference = reference;
+				pass.depthFormat = resource.desc.format;
+				bDepth = true;
+			}
+
+			attachmentDescs.push_back(attachmentDesc);
+			pass.attachments.push_back({ use.resource, layout, attachmentDesc.loadOp, attachmentDesc.storeOp, !bColour });
+			pass.clearValues.push_back(use.clearValue);
+		}
+
+		if (pass.attachments.empty())
+		{
+			throw std::runtime_error("Failed to compile Render Graph: graphics pass " + pass.name + " has no attachments!");
+		}
+
+		// Rendering is begun on the attachment views themselves
+		if (bDynamicRendering)
+		{
+			continue;
+		}
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colourReferences.size());
+		subpass.pColorAttachments = colourReferences.data();
+		subpass.pDepthStencilAttachment = bDepth ? &depthReference : nullptr;
+
+		// No subpass dependencies: the barriers recorded before the pass already order it against everything else
+		VkRenderPassCreateInfo renderPassCreateInfo = {};
+		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
+		renderPassCreateInfo.pAttachments = attachmentDescs.data();
+		renderPassCreateInfo.subpassCount = 1;
+		renderPassCreateInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &pass.renderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Render Pass!");
+		}
+		compiled.renderPasses.push_back(pass.renderPass);
+		stats.renderPassCount++;
+	}
+}
+
+void RenderGraph::BeginPass(VkCommandBuffer commandBuffer, PassHandle passHandle, PassContext& context)
+{
+	const Pass& pass = passes[passHandle];
+	context.colourFormatCount = static_cast<uint32_t>(pass.colourFormats.size());
+	context.colourFormats = pass.colourFormats.data();
+	context.depthFormat = pass.depthFormat;
+
+#ifdef VK_KHR_dynamic_rendering
+	if (bDynamicRendering)
+	{
+		std::vector<VkRenderingAttachmentInfoKHR> colourAttachments;
+		VkRenderingAttachmentInfoKHR depthAttachment = {};
+		bool bDepth = false;
+		for (size_t a = 0; a < pass.attachments.size(); ++a)
+		{
+			const Attachment& attachment = pass.attachments[a];
+			const Resource& resource = resources[attachment.resource];
+			if (resource.imageView == VK_NULL_HANDLE)
+			{
+				throw std::runtime_error("Failed to execute Render Graph: " + resource.name + " is not bound!");
+			}
+
+			VkRenderingAttachmentInfoKHR attachmentInfo = {};
+			attachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			attachmentInfo.imageView = resource.imageView;
+			attachmentInfo.imageLayout = attachment.layout;
+			attachmentInfo.resolveMode = VK_RESOLVE_MODE_NONE;
+			attachmentInfo.loadOp = attachment.loadOp;
+			attachmentInfo.storeOp = attachment.storeOp;
+			attachmentInfo.clearValue = pass.clearValues[a];
+			if (attachment.bDepth)
+			{
+				depthAttachment = attachmentInfo;
+				bDepth = true;
+			}
+			else
+			{
+				colourAttachments.push_back(attachmentInfo);
+			}
+		}
+
+		VkRenderingInfoKHR renderingInfo = {};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.flags = pass.contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = pass.extent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colourAttachments.size());
+		renderingInfo.pColorAttachments = colourAttachments.data();
+		renderingInfo.pDepthAttachment = bDepth ? &depthAttachment : nullptr;
+		renderingInfo.pStencilAttachment = nullptr;
+		pfnCmdBeginRendering(commandBuffer, &renderingInfo);
+		return;
+	}
+#endif
+
+	context.renderPass = pass.renderPass;
+	context.framebuffer = GetFramebuffer(passHandle);
+
+	VkRenderPassBeginInfo renderPassBeginInfo = {};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.renderPass = context.renderPass;
+	renderPassBeginInfo.framebuffer = context.framebuffer;
+	renderPassBeginInfo.renderArea.offset = { 0, 0 };
+	renderPassBeginInfo.renderArea.extent = pass.extent;
+	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+	renderPassBeginInfo.pClearValues = pass.clearValues.data();
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, pass.contents);
+}
+
+void RenderGraph::EndPass(VkCommandBuffer commandBuffer)
+{
+#ifdef VK_KHR_dynamic_rendering
+	if (bDynamicRendering)
+	{
+		pfnCmdEndRendering(commandBuffer);
+		return;
+	}
+#endif
+
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+VkFramebuffer RenderGraph::GetFramebuffer(PassHandle passHandle)
+{
+	const Pass& pass = passes[passHandle];
+
+	std::vector<VkImageView> views;
+	for (const Attachment& attachment : pass.attachments)
+	{
+		const Resource& resource = resources[attachment.resource];
+		if (resource.imageView == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("Failed to execute Render Graph: " + resource.name + " is not bound!");
+		}
+		views.push_back(resource.imageView);
+	}
+
+	auto key = std::make_pair(passHandle, views);
+	auto cached = framebufferCache.find(key);
+	if (cached != framebufferCache.end())
+	{
+		return cached->second;
+	}
+
+	VkFramebufferCreateInfo framebufferCreateInfo = {};
+	framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferCreateInfo.renderPass = pass.renderPass;
+	framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(views.size());
+	framebufferCreateInfo.pAttachments = views.data();
+	framebufferCreateInfo.width = pass.extent.width;
+	framebufferCreateInfo.height = pass.extent.height;
+	framebufferCreateInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Framebuffer!");
+	}
+	framebufferCache[key] = framebuffer;
+	stats.framebufferCount++;
+	return framebuffer;
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers)
+{
+	if (barriers.empty())
+	{
+		return;
+	}
+
+	// One call for every barrier before a pass
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	VkPipelineStageFlags srcStages = 0;
+	VkPipelineStageFlags dstStages = 0;
+	for (const Barrier& barrier : barriers)
+	{
+		const Resource& resource = resources[barrier.resource];
+		if (resource.image == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("Failed to execute Render Graph: " + resource.name + " is not bound!");
+		}
+
+		VkImageMemoryBarrier imageBarrier = {};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.oldLayout = barrier.src.layout;
+		imageBarrier.newLayout = barrier.dst.layout;
+		imageBarrier.srcAccessMask = barrier.src.access;
+		imageBarrier.dstAccessMask = barrier.dst.access;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = resource.image;
+		imageBarrier.subresourceRange.aspectMask = IsDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		imageBarrier.subresourceRange.levelCount = 1;
+		imageBarrier.subresourceRange.layerCount = 1;
+		imageBarriers.push_back(imageBarrier);
+
+		srcStages |= barrier.src.stages;
+		dstStages |= barrier.dst.stages;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void RenderGraph::DestroyCompiled(CompiledObjects& objects)
+{
+	for (VkFramebuffer framebuffer : objects.framebuffers)
+	{
+		vkDestroyFramebuffer(device, framebuffer, nullptr);
+	}
+	for (VkRenderPass renderPass : objects.renderPasses)
+	{
+		vkDestroyRenderPass(device, renderPass, nullptr);
+	}
+	for (VkImageView imageView : objects.imageViews)
+	{
+		vkDestroyImageView(device, imageView, nullptr);
+	}
+	for (VkImage image : objects.images)
+	{
+		vkDestroyImage(device, image, nullptr);
+	}
+	if (objects.memory.memory != VK_NULL_HANDLE)
+	{
+		allocator->Free(objects.memory);
+	}
+}
+
+RenderGraph::ImageState RenderGraph::GetUsageState(Usage usage)
+{
+	switch (usage)
+	{
+	case Usage::ColourAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+	case Usage::DepthAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+	case Usage::DepthRead:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT };
+	case Usage::Sampled:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	case Usage::StorageRead:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	case Usage::StorageWrite:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+	case Usage::TransferSrc:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+	case Usage::TransferDst:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+	}
+	return {};
+}
+
+VkImageUsageFlags RenderGraph::GetImageUsage(Usage usage)
+{
+	switch (usage)
+	{
+	case Usage::ColourAttachment:	return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	case Usage::DepthAttachment:
+	case Usage::DepthRead:			return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	case Usage::Sampled:			return VK_IMAGE_USAGE_SAMPLED_BIT;
+	case Usage::StorageRead:
+	case Usage::StorageWrite:		return VK_IMAGE_USAGE_STORAGE_BIT;
+	case Usage::TransferSrc:		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	case Usage::TransferDst:		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	return 0;
+}
+
+bool RenderGraph::IsDepthFormat(VkFormat format)
+{
+	return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT
+		|| format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
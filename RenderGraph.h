@@ -0,0 +1,242 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "GpuAllocator.h"
+
+class GpuProfiler;
+
+// Frame graph
+// Passes are declared in submission order with the images they read and write. Compile culls passes nothing depends on,
+// works out every layout transition and pipeline barrier once, and places transient images whose lifetimes don't overlap
+// in the same memory. Execute then only replays the barriers and render passes around each pass's recording.
+// Imported images (the swapchain) are bound again every frame and left in the state they were imported with.
+// With VK_KHR_dynamic_rendering graphics passes begin rendering straight on their attachment views, so no render pass
+// or framebuffer objects are created at all; otherwise each pass gets a render pass and framebuffers are cached per view set.
+class RenderGraph
+{
+public:
+	using ResourceHandle = uint32_t;
+	using PassHandle = uint32_t;
+
+	// How a pass uses an image, decides its layout and the stages and accesses synchronised around it
+	enum class Usage
+	{
+		ColourAttachment,
+		DepthAttachment,
+		DepthRead,				// Read-only depth attachment (tested, not written)
+		Sampled,				// Fragment or compute shader reads
+		StorageRead,
+		StorageWrite,
+		TransferSrc,
+		TransferDst
+	};
+
+	// Layout and last stages/accesses of an image between passes
+	struct ImageState
+	{
+		VkImageLayout			layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags	stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkAccessFlags			access = 0;
+	};
+
+	struct ImageDesc
+	{
+		VkFormat				format = VK_FORMAT_UNDEFINED;
+		VkExtent2D				extent = {};
+	};
+
+	// What a pass's recording function is given (render pass and framebuffer are null for non graphics passes,
+	// and for graphics passes under dynamic rendering, which are described by their attachment formats instead)
+	struct PassContext
+	{
+		VkCommandBuffer			commandBuffer = VK_NULL_HANDLE;
+		VkRenderPass			renderPass = VK_NULL_HANDLE;
+		VkFramebuffer			framebuffer = VK_NULL_HANDLE;
+		VkExtent2D				extent = {};
+		uint32_t				colourFormatCount = 0;
+		const VkFormat*			colourFormats = nullptr;
+		VkFormat				depthFormat = VK_FORMAT_UNDEFINED;
+	};
+	using ExecuteFunction = std::function<void(const PassContext& context)>;
+
+	struct Stats
+	{
+		uint32_t				passCount = 0;
+		uint32_t				culledPassCount = 0;
+		uint32_t				barrierCount = 0;			// Image barriers per frame
+		uint32_t				barrierBatchCount = 0;		// vkCmdPipelineBarrier calls per frame
+		uint32_t				transientCount = 0;
+		VkDeviceSize			transientBytes = 0;			// Peak transient memory if every image had its own
+		VkDeviceSize			aliasedBytes = 0;			// Peak transient memory with aliasing
+		uint32_t				renderPassCount = 0;		// Created by Compile (none with dynamic rendering)
+		uint32_t				framebufferCount = 0;		// Created since Compile, one per pass and attachment view set
+	};
+
+	// profiler may be null, otherwise every pass is timed under its name
+	// bDynamicRendering: VK_KHR_dynamic_rendering is enabled on the device (ignored if the headers don't have it)
+	RenderGraph(VkDevice device, GpuAllocator* allocator, GpuProfiler* profiler = nullptr, bool bDynamicRendering = false);
+	~RenderGraph();
+
+	// -- Declaration --
+	// Image owned outside the graph: it is in initialState when the frame starts and is left in finalState
+	ResourceHandle		ImportImage(const std::string& name, const ImageDesc& desc, const ImageState& initialState, const ImageState& finalState);
+
+	// Image only the graph uses, created (and aliased) by Compile, contents don't survive the frame
+	ResourceHandle		CreateImage(const std::string& name, const ImageDesc& desc);
+
+	// bGraphics: the pass's attachments are begun as a render pass around its recording
+	// bSideEffects: never culled, even if nothing reads what it writes
+	PassHandle			AddPass(const std::string& name, bool bGraphics, const ExecuteFunction& execute, bool bSideEffects = false);
+
+	// Colour and depth attachments are bound in the order they are written
+	// clear: clear the attachment when the pass begins (otherwise it is loaded, or left undefined if nothing wrote it before)
+	void				Read(PassHandle pass, ResourceHandle resource, Usage usage);
+	void				Write(PassHandle pass, ResourceHandle resource, Usage usage, const VkClearValue* clear = nullptr);
+
+	// -- Compilation --
+	// Throws if transient memory can't be allocated
+	void				Compile();
+
+	// Retire everything compiled and every declaration, so the graph can be declared again (after a resize)
+	// Objects are kept until the frame serial has completed
+	void				Reset(uint64_t serial);
+	void				Reclaim(uint64_t completedSerial);
+
+	// -- Execution --
+	// Imported images must be bound before every Execute
+	void				SetImportedImage(ResourceHandle resource, VkImage image, VkImageView imageView);
+
+	// SECONDARY_COMMAND_BUFFERS if the pass records in to secondary buffers this frame
+	void				SetPassContents(PassHandle pass, VkSubpassContents contents);
+
+	void				Execute(VkCommandBuffer commandBuffer);
+
+	bool				IsCompiled() const { return bCompiled; }
+	bool				UsesDynamicRendering() const { return bDynamicRendering; }
+	bool				IsCulled(PassHandle pass) const { return passes[pass].bCulled; }
+	const Stats&		GetStats() const { return stats; }
+
+	// Pass order, culled passes, transient lifetimes and memory placement
+	void				PrintSummary() const;
+
+private:
+	struct ResourceUse
+	{
+		ResourceHandle			resource;
+		Usage					usage;
+		bool					bWrite;
+		bool					bClear;
+		VkClearValue			clearValue;
+	};
+
+	// Layout transition or dependency recorded before a pass (or after the last one, for imported images)
+	struct Barrier
+	{
+		ResourceHandle			resource;
+		ImageState				src;
+		ImageState				dst;
+	};
+
+	// Colour or depth attachment of a graphics pass, in binding order
+	struct Attachment
+	{
+		ResourceHandle			resource;
+		VkImageLayout			layout;
+		VkAttachmentLoadOp		loadOp;
+		VkAttachmentStoreOp		storeOp;
+		bool					bDepth;
+	};
+
+	struct Pass
+	{
+		std::string				name;
+		bool					bGraphics;
+		bool					bSideEffects;
+		ExecuteFunction			execute;
+		std::vector<ResourceUse> uses;
+		VkSubpassContents		contents = VK_SUBPASS_CONTENTS_INLINE;
+
+		// Compiled
+		bool					bCulled = false;
+		std::vector<Barrier>	barriers;
+		VkRenderPass			renderPass = VK_NULL_HANDLE;
+		std::vector<Attachment>	attachments;
+		std::vector<VkClearValue> clearValues;		// One per attachment
+		std::vector<VkFormat>	colourFormats;
+		VkFormat				depthFormat = VK_FORMAT_UNDEFINED;
+		VkExtent2D				extent = {};
+	};
+
+	struct Resource
+	{
+		std::string				name;
+		ImageDesc				desc;
+		bool					bImported;
+		ImageState				initialState;			// Imported only
+		ImageState				finalState;
+		VkImageUsageFlags		usage = 0;
+
+		// Compiled (transient) or bound every frame (imported)
+		VkImage					image = VK_NULL_HANDLE;
+		VkImageView				imageView = VK_NULL_HANDLE;
+		uint32_t				firstPass = UINT32_MAX;	// Lifetime over live passes
+		uint32_t				lastPass = 0;
+		VkDeviceSize			memoryOffset = 0;
+		VkMemoryRequirements	memoryRequirements = {};
+	};
+
+	// Everything created by Compile, destroyed once the frames using it have completed
+	struct CompiledObjects
+	{
+		std::vector<VkRenderPass>	renderPasses;
+		std::vector<VkFramebuffer>	framebuffers;
+		std::vector<VkImageView>	imageViews;
+		std::vector<VkImage>		images;
+		MemoryAllocation			memory;
+		uint64_t					serial = 0;
+	};
+
+	VkDevice			device;
+	GpuAllocator*		allocator;
+	GpuProfiler*		profiler;
+	bool				bDynamicRendering = false;
+
+#ifdef VK_KHR_dynamic_rendering
+	PFN_vkCmdBeginRenderingKHR	pfnCmdBeginRendering = nullptr;
+	PFN_vkCmdEndRenderingKHR	pfnCmdEndRendering = nullptr;
+#endif
+
+	std::vector<Pass>	passes;
+	std::vector<Resource> resources;
+	std::vector<Barrier> finalBarriers;
+	bool				bCompiled = false;
+	Stats				stats;
+
+	// Framebuffers of graphics passes, by pass and attachment views (imported views change every frame)
+	std::map<std::pair<PassHandle, std::vector<VkImageView>>, VkFramebuffer> framebufferCache;
+
+	CompiledObjects		compiled;
+	std::vector<CompiledObjects> retired;
+
+	void				CullPasses();
+	void				ComputeLifetimes();
+	void				ComputeBarriers();
+	void				CreateTransientImages();
+	void				CreateRenderPasses();
+	void				BeginPass(VkCommandBuffer commandBuffer, PassHandle pass, PassContext& context);
+	void				EndPass(VkCommandBuffer commandBuffer);
+	VkFramebuffer		GetFramebuffer(PassHandle pass);
+	void				RecordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers);
+	void				DestroyCompiled(CompiledObjects& objects);
+
+	static ImageState	GetUsageState(Usage usage);
+	static VkImageUsageFlags GetImageUsage(Usage usage);
+	static bool			IsDepthFormat(VkFormat format);
+};
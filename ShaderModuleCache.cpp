@@ -0,0 +1,96 @@
+#include "ShaderModuleCache.h"
+
+#include <vector>
+#include <stdexcept>
+
+#include "MappedFile.h"
+#include "Utilities.h"
+
+ShaderModuleCache::ShaderModuleCache(VkDevice device)
+	: device(device)
+{
+}
+
+ShaderModuleCache::~ShaderModuleCache()
+{
+	for (auto& module : modules)
+	{
+		vkDestroyShaderModule(device, module.second, nullptr);
+	}
+}
+
+VkShaderModule ShaderModuleCache::GetModule(const std::string& fileName)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	auto file = fileModules.find(fileName);
+	if (file != fileModules.end())
+	{
+		++hits;
+		return file->second;
+	}
+
+	// Map SPIR-V code of shader (no copy, mapping is aligned for 32-bit SPIR-V words)
+	MappedFile code(fileName);
+	VkShaderModule module = GetModuleLocked(code.GetDataAs<uint32_t>(), code.GetSize());
+	fileModules[fileName] = module;
+
+	return module;
+}
+
+VkShaderModule ShaderModuleCache::GetModule(const uint32_t* code, size_t codeSize)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return GetModuleLocked(code, codeSize);
+}
+
+ShaderModuleCache::Stats ShaderModuleCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	Stats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.moduleCount = modules.size();
+	return stats;
+}
+
+VkShaderModule ShaderModuleCache::GetModuleLocked(const uint32_t* code, size_t codeSize)
+{
+	// Size is part of the key, so a hash collision also needs an identical length
+	std::pair<uint64_t, size_t> key = { HashFNV1a(code, codeSize), codeSize };
+
+	auto module = modules.find(key);
+	if (module != modules.end())
+	{
+		++hits;
+		return module->second;
+	}
+
+	++misses;
+	VkShaderModule shaderModule = CreateShaderModule(code, codeSize);
+	modules[key] = shaderModule;
+
+	return shaderModule;
+}
+
+VkShaderModule ShaderModuleCache::CreateShaderModule(const uint32_t* code, size_t codeSize)
+{
+	// SPIR-V is a stream of 32-bit words starting with the magic number
+	if (codeSize < sizeof(uint32_t) || codeSize % sizeof(uint32_t) != 0 || code[0] != SPIRV_MAGIC_NUMBER)
+	{
+		throw std::runtime_error("Shader code is not valid SPIR-V!");
+	}
+
+	VkShaderModuleCreateInfo shaderModuleCrateInfo = {};
+	shaderModuleCrateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCrateInfo.codeSize = codeSize;
+	shaderModuleCrateInfo.pCode = code;
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &shaderModuleCrateInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shader module!");
+	}
+	return shaderModule;
+}
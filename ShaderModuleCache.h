@@ -0,0 +1,47 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Shader module registry
+// Modules are keyed by a hash of their SPIR-V, so every pipeline using the same code shares one VkShaderModule.
+// Files already loaded once are looked up by name and never read again.
+class ShaderModuleCache
+{
+public:
+	struct Stats
+	{
+		uint64_t			hits = 0;			// Requests served by an existing module
+		uint64_t			misses = 0;			// Requests that had to create a module
+		size_t				moduleCount = 0;	// Unique modules alive
+	};
+
+	ShaderModuleCache(VkDevice device);
+	~ShaderModuleCache();
+
+	// Modules are owned by the cache and live until it is destroyed
+	VkShaderModule			GetModule(const std::string& fileName);
+	VkShaderModule			GetModule(const uint32_t* code, size_t codeSize);
+
+	Stats					GetStats();
+
+private:
+	VkDevice				device;
+	std::mutex				cacheMutex;
+
+	// Content hash + size -> module
+	std::map<std::pair<uint64_t, size_t>, VkShaderModule>	modules;
+	// File name -> module, so known files skip reading and hashing entirely
+	std::unordered_map<std::string, VkShaderModule>			fileModules;
+
+	uint64_t				hits = 0;
+	uint64_t				misses = 0;
+
+	VkShaderModule			GetModuleLocked(const uint32_t* code, size_t codeSize);
+	VkShaderModule			CreateShaderModule(const uint32_t* code, size_t codeSize);
+};
@@ -0,0 +1,46 @@
+// Shared by the cluster culling shaders (compute fallback and task shader)
+
+// Must match Meshlet in Utilities.h
+struct Meshlet
+{
+	vec3 center;
+	float radius;
+	vec3 coneApex;
+	float coneCutoff;
+	vec3 coneAxis;
+	uint firstIndex;
+	uint vertexOffset;
+	uint vertexCount;
+	uint triangleOffset;
+	uint triangleCount;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Meshlets
+{
+	Meshlet meshlets[];
+};
+
+// Must match ClusterCullParams in ClusterRenderer.h
+layout(push_constant) uniform CullParams
+{
+	vec4 frustumPlanes[6];		// xyz = inward normal, w = distance (visible where dot(n, p) + w >= 0)
+	vec4 camera;				// w = 1: xyz = position (perspective), w = 0: xyz = view direction (orthographic)
+	uint meshletCount;
+	uint bCompact;				// Compute path: compact visible draws (draw count buffer) instead of zeroing culled ones
+} params;
+
+bool IsMeshletVisible(Meshlet meshlet)
+{
+	// Frustum: bounding sphere entirely outside any plane
+	for (int i = 0; i < 6; ++i)
+	{
+		if (dot(params.frustumPlanes[i].xyz, meshlet.center) + params.frustumPlanes[i].w < -meshlet.radius)
+		{
+			return false;
+		}
+	}
+
+	// Backface: camera inside the cone every triangle faces away from
+	vec3 direction = params.camera.w != 0.0 ? normalize(meshlet.coneApex - params.camera.xyz) : params.camera.xyz;
+	return dot(direction, meshlet.coneAxis) < meshlet.coneCutoff;
+}
@@ -1,3 +1,9 @@
 C:/VulkanSDK/1.2.162.0/Bin32/glslangValidator.exe -V shader.vert
 C:/VulkanSDK/1.2.162.0/Bin32/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.2.162.0/Bin32/glslangValidator.exe -V depth.vert -o depth.spv
+C:/VulkanSDK/1.2.162.0/Bin32/glslangValidator.exe -V cluster_cull.comp -o cluster_cull.spv
+C:/VulkanSDK/1.2.162.0/Bin32/glslangValidator.exe -V mip_downsample.comp -o mip_downsample.spv
+REM Mesh shaders need glslangValidator from SDK 1.3.226 or later (GL_EXT_mesh_shader, SPIR-V 1.4), VULKAN_SDK must point at one
+%VULKAN_SDK%/Bin/glslangValidator.exe -V --target-env spirv1.4 meshlet.task -o meshlet_task.spv
+%VULKAN_SDK%/Bin/glslangValidator.exe -V --target-env spirv1.4 meshlet.mesh -o meshlet_mesh.spv
 pause
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 450 		// Use GLSL 4.5
+
+// Position only: reads nothing but stream 0 of a split vertex layout (depth/shadow passes)
+layout(location = 0) in vec3 position;
+
+layout(location = 0) out vec3 fragColour;	// Constant colour, so it still works with the colour fragment shader
+
+void main() {
+	gl_Position = vec4(position, 1.0);
+	fragColour = vec3(1.0);
+}
\ No newline at end of file
@@ -1,22 +1,12 @@
 #version 450 		// Use GLSL 4.5
 
-layout(location = 0) out vec3 fragColour;	// Output colour for vertex (location is required)
-
-// Triangle vertex positions (will put in to vertex buffer later!)
-vec3 positions[3] = vec3[](
-	vec3(0.0, -0.4, 0.0),
-	vec3(0.4, 0.4, 0.0),
-	vec3(-0.4, 0.4, 0.0)
-);
+// Per vertex attributes (locations must match the vertex layout)
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 colour;
 
-// Triangle vertex colours
-vec3 colours[3] = vec3[](
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-);
+layout(location = 0) out vec3 fragColour;	// Output colour for vertex (location is required)
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 1.0);
-	fragColour = colours[gl_VertexIndex];
+	gl_Position = vec4(position, 1.0);
+	fragColour = colour;
 }
\ No newline at end of file
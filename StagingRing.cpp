@@ -0,0 +1,238 @@
+#include "StagingRing.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+StagingRing::StagingRing(VkDevice device, GpuAllocator* allocator, VkDeviceSize capacity, VkDeviceSize imageCopyAlignment)
+	: device(device), allocator(allocator), capacity(capacity), imageCopyAlignment(std::max<VkDeviceSize>(imageCopyAlignment, 4))
+{
+	// Host visible, coherent and mapped for the ring's whole life, so writes never need a flush
+	buffer = allocator->CreateBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::CpuToGpu, &allocation);
+	if (allocation.pMapped == nullptr)
+	{
+		throw std::runtime_error("Failed to map the staging ring Buffer!");
+	}
+}
+
+StagingRing::~StagingRing()
+{
+	allocator->DestroyBuffer(buffer, allocation);
+}
+
+bool StagingRing::UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	VkDeviceSize ringOffset;
+	if (!Allocate(size, 4, &ringOffset))
+	{
+		return false;
+	}
+	memcpy(static_cast<char*>(allocation.pMapped) + ringOffset, data, static_cast<size_t>(size));
+
+	// Consecutive uploads to the same buffer end up in the same copy command
+	BufferCopy copy;
+	copy.buffer = dstBuffer;
+	copy.region.srcOffset = ringOffset;
+	copy.region.dstOffset = offset;
+	copy.region.size = size;
+	bufferCopies.push_back(copy);
+
+	++stats.uploadCount;
+	stats.uploadedBytes += size;
+	return true;
+}
+
+bool StagingRing::UploadToImage(VkImage image, const VkBufferImageCopy& region, const void* data, VkDeviceSize size)
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	// Buffer offset of an image copy must be a multiple of the texel size and of 4
+	VkDeviceSize ringOffset;
+	if (!Allocate(size, imageCopyAlignment, &ringOffset))
+	{
+		return false;
+	}
+	memcpy(static_cast<char*>(allocation.pMapped) + ringOffset, data, static_cast<size_t>(size));
+
+	ImageCopy copy;
+	copy.image = image;
+	copy.region = region;
+	copy.region.bufferOffset = ringOffset;
+	imageCopies.push_back(copy);
+
+	++stats.uploadCount;
+	stats.uploadedBytes += size;
+	return true;
+}
+
+void StagingRing::RecordCopies(VkCommandBuffer commandBuffer, uint64_t serial)
+{
+	RecordCopies(commandBuffer, serial, VK_NULL_HANDLE);
+}
+
+void StagingRing::RecordCopies(VkCommandBuffer commandBuffer, VkFence fence)
+{
+	RecordCopies(commandBuffer, 0, fence);
+}
+
+bool StagingRing::HasPendingCopies()
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+	return !bufferCopies.empty() || !imageCopies.empty();
+}
+
+void StagingRing::Reclaim(uint64_t completedSerial)
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	// Batches complete in the order they were recorded, stop at the first one still in use
+	while (!batches.empty())
+	{
+		const Batch& batch = batches.front();
+		bool bComplete = batch.fence != VK_NULL_HANDLE
+			? vkGetFenceStatus(device, batch.fence) == VK_SUCCESS
+			: batch.serial <= completedSerial;
+		if (!bComplete)
+		{
+			break;
+		}
+
+		tail = batch.endPosition;
+		batches.pop_front();
+	}
+}
+
+StagingRing::Stats StagingRing::GetStats()
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+	return stats;
+}
+
+bool StagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+	if (size > capacity)
+	{
+		throw std::runtime_error("Upload is bigger than the staging ring!");
+	}
+
+	// Align, and skip to the start of the buffer if the range would run off its end
+	uint64_t start = (head + alignment - 1) / alignment * alignment;
+	if (start % capacity + size > capacity)
+	{
+		start = (start / capacity + 1) * capacity;
+	}
+
+	// Would overwrite data the GPU may still be copying from
+	if (start + size - tail > capacity)
+	{
+		++stats.fullCount;
+		return false;
+	}
+
+	head = start + size;
+	stats.peakUsedBytes = std::max<VkDeviceSize>(stats.peakUsedBytes, head - tail);
+
+	*offset = start % capacity;
+	return true;
+}
+
+void StagingRing::RecordCopies(VkCommandBuffer commandBuffer, uint64_t serial, VkFence fence)
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	if (bufferCopies.empty() && imageCopies.empty())
+	{
+		return;
+	}
+
+	// One copy command per destination, with all of its regions
+	// Regions of one copy command must not overlap, so a write overlapping one queued earlier for the same
+	// destination goes in a later pass, after a barrier, and lands on top of it as if uploaded in order
+	std::stable_sort(bufferCopies.begin(), bufferCopies.end(), [](const BufferCopy& a, const BufferCopy& b) { return a.buffer < b.buffer; });
+	std::vector<uint32_t> bufferPasses(bufferCopies.size(), 0);
+	uint32_t passCount = bufferCopies.empty() ? 0 : 1;
+	for (size_t i = 0; i < bufferCopies.size(); ++i)
+	{
+		const VkBufferCopy& region = bufferCopies[i].region;
+		for (size_t j = i; j-- > 0 && bufferCopies[j].buffer == bufferCopies[i].buffer;)
+		{
+			const VkBufferCopy& earlier = bufferCopies[j].region;
+			if (region.dstOffset < earlier.dstOffset + earlier.size && earlier.dstOffset < region.dstOffset + region.size)
+			{
+				bufferPasses[i] = std::max(bufferPasses[i], bufferPasses[j] + 1);
+			}
+		}
+		passCount = std::max(passCount, bufferPasses[i] + 1);
+	}
+
+	std::vector<VkBufferCopy> bufferRegions;
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		// Previous pass's writes must be done before this one overwrites them
+		if (pass > 0)
+		{
+			VkMemoryBarrier passBarrier = {};
+			passBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			passBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			passBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &passBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		for (size_t i = 0; i < bufferCopies.size();)
+		{
+			size_t end = i;
+			bufferRegions.clear();
+			while (end < bufferCopies.size() && bufferCopies[end].buffer == bufferCopies[i].buffer)
+			{
+				if (bufferPasses[end] == pass)
+				{
+					bufferRegions.push_back(bufferCopies[end].region);
+				}
+				++end;
+			}
+
+			if (!bufferRegions.empty())
+			{
+				vkCmdCopyBuffer(commandBuffer, buffer, bufferCopies[i].buffer, static_cast<uint32_t>(bufferRegions.size()), bufferRegions.data());
+			}
+			i = end;
+		}
+	}
+
+	std::stable_sort(imageCopies.begin(), imageCopies.end(), [](const ImageCopy& a, const ImageCopy& b) { return a.image < b.image; });
+	std::vector<VkBufferImageCopy> imageRegions;
+	for (size_t i = 0; i < imageCopies.size();)
+	{
+		size_t end = i;
+		imageRegions.clear();
+		while (end < imageCopies.size() && imageCopies[end].image == imageCopies[i].image)
+		{
+			imageRegions.push_back(imageCopies[end].region);
+			++end;
+		}
+
+		vkCmdCopyBufferToImage(commandBuffer, buffer, imageCopies[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+		i = end;
+	}
+
+	// Copies must finish before anything later in the queue reads the destinations
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	bufferCopies.clear();
+	imageCopies.clear();
+
+	Batch batch;
+	batch.endPosition = head;
+	batch.serial = serial;
+	batch.fence = fence;
+	batches.push_back(batch);
+
+	++stats.batchCount;
+}
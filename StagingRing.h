@@ -0,0 +1,100 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <deque>
+#include <vector>
+
+#include "GpuAllocator.h"
+
+// Staging ring buffer for uploads to device local buffers and images
+// One persistently mapped buffer: uploads are written at the head, copies for them are recorded in batches,
+// and the space is given back once the GPU has finished those copies (by frame serial or by fence).
+// No temporary buffer is ever created per upload.
+class StagingRing
+{
+public:
+	struct Stats
+	{
+		uint64_t			uploadCount = 0;
+		uint64_t			uploadedBytes = 0;
+		uint64_t			batchCount = 0;
+		uint64_t			fullCount = 0;			// Uploads refused because the ring was full
+		VkDeviceSize		peakUsedBytes = 0;
+	};
+
+	StagingRing(VkDevice device, GpuAllocator* allocator, VkDeviceSize capacity = DEFAULT_CAPACITY, VkDeviceSize imageCopyAlignment = 16);
+	~StagingRing();
+
+	// Copy data in to the ring and queue a copy to the destination
+	// Returns false if the ring has no room until earlier batches complete (nothing is queued then)
+	bool				UploadToBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+	// Image must be in TRANSFER_DST_OPTIMAL layout when the copies execute, bufferOffset of region is filled in
+	bool				UploadToImage(VkImage image, const VkBufferImageCopy& region, const void* data, VkDeviceSize size);
+
+	// Record every queued copy in to a command buffer (outside a render pass), grouped in to one copy command
+	// per destination, followed by a barrier making them visible to every later command.
+	// Buffer writes overlapping earlier ones are split in to later copy commands, so the last queued write wins.
+	// Image regions queued for one image must not overlap.
+	// The batch is complete once the work tagged "serial" has finished (see Reclaim).
+	void				RecordCopies(VkCommandBuffer commandBuffer, uint64_t serial);
+
+	// As above, but the batch is complete once the fence has signalled
+	void				RecordCopies(VkCommandBuffer commandBuffer, VkFence fence);
+
+	bool				HasPendingCopies();
+
+	// Give back space of every batch whose serial is <= completedSerial or whose fence has signalled
+	void				Reclaim(uint64_t completedSerial);
+
+	Stats				GetStats();
+
+	static constexpr VkDeviceSize DEFAULT_CAPACITY = 32ULL * 1024 * 1024;
+
+private:
+	struct BufferCopy
+	{
+		VkBuffer			buffer;
+		VkBufferCopy		region;
+	};
+
+	struct ImageCopy
+	{
+		VkImage				image;
+		VkBufferImageCopy	region;
+	};
+
+	// Recorded batch still in use by the GPU
+	struct Batch
+	{
+		uint64_t			endPosition;			// Head position when the batch was recorded
+		uint64_t			serial;
+		VkFence				fence;
+	};
+
+	VkDevice			device;
+	GpuAllocator*		allocator;
+
+	VkBuffer			buffer = VK_NULL_HANDLE;
+	MemoryAllocation	allocation;
+	VkDeviceSize		capacity;
+	VkDeviceSize		imageCopyAlignment;
+
+	// Positions grow forever, offset in the buffer is position % capacity
+	uint64_t			head = 0;
+	uint64_t			tail = 0;
+
+	std::vector<BufferCopy> bufferCopies;
+	std::vector<ImageCopy>	imageCopies;
+	std::deque<Batch>	batches;
+
+	Stats				stats;
+	std::mutex			ringMutex;
+
+	// Offset in the buffer of a new range, or false if it doesn't fit
+	bool				Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+	void				RecordCopies(VkCommandBuffer commandBuffer, uint64_t serial, VkFence fence);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <chrono>
+
+#include "GpuAllocator.h"
+
+enum class TextureState
+{
+	Decoding,		// Queued on or being decoded by a loader thread
+	Uploading,		// Decoded, waiting for staging space or for its copies and mip generation to finish
+	Ready,			// Every mip is resident and in SHADER_READ_ONLY_OPTIMAL layout
+	Failed			// Decoding or creation failed, image is VK_NULL_HANDLE
+};
+
+// Sampled 2D texture (array) with a full mip chain in device local memory
+// Created and destroyed through the renderer, which decodes it on a loader thread, uploads it through the staging ring
+// and generates its mips on the GPU. Image and view are only valid once the texture is Ready.
+struct Texture
+{
+	std::string						name;
+	TextureState					state = TextureState::Decoding;
+	bool							bSRGB = true;			// Colour data (sRGB format), otherwise linear (UNORM)
+
+	VkImage							image = VK_NULL_HANDLE;
+	MemoryAllocation				allocation;
+	VkImageView						imageView = VK_NULL_HANDLE;	// Every mip and layer
+	VkFormat						format = VK_FORMAT_UNDEFINED;
+	uint32_t						width = 0;
+	uint32_t						height = 0;
+	uint32_t						mipLevels = 0;
+	uint32_t						layerCount = 0;
+	bool							bComputeMips = false;	// Mips downsampled by compute, format isn't blittable
+
+	// Streaming: image holds mips residentMip.. of the full chain (size and mip count above are the image's)
+	// Image, allocation and view are replaced whenever mips stream in or out, so read them each frame
+	bool							bStreamed = false;
+	uint32_t						residentMip = 0;
+
+	// Load timing
+	std::chrono::high_resolution_clock::time_point	requestTime;
+	double							decodeMs = 0.0;			// On the loader thread
+	double							loadMs = 0.0;			// Request until the GPU finished its mips
+	uint64_t						uploadSerial = 0;		// Frame its mips were generated in
+};
@@ -0,0 +1,472 @@
+#include "TextureLoader.h"
+#include "MappedFile.h"
+#include "CpuProfiler.h"
+
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+// Largest image dimension accepted (the device limit is checked again when the image is created)
+static const uint32_t MAX_IMAGE_DIMENSION = 16384;
+
+static uint16_t ReadU16(const uint8_t* data)
+{
+	return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static uint32_t ReadU32(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static void CheckDimensions(uint32_t width, uint32_t height, const std::string& fileName)
+{
+	if (width == 0 || height == 0 || width > MAX_IMAGE_DIMENSION || height > MAX_IMAGE_DIMENSION)
+	{
+		throw std::runtime_error("Failed to decode image, unsupported dimensions: " + fileName);
+	}
+}
+
+// Truevision TGA: types 2/3 (true colour/greyscale) and 10/11 (their RLE variants), 8/24/32 bits per pixel
+static void DecodeTGA(const uint8_t* data, size_t size, const std::string& fileName, uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels)
+{
+	if (size < 18)
+	{
+		throw std::runtime_error("Failed to decode TGA, file is truncated: " + fileName);
+	}
+
+	uint8_t imageType = data[2];
+	bool bRLE = imageType == 10 || imageType == 11;
+	bool bGrey = imageType == 3 || imageType == 11;
+	uint32_t bytesPerPixel = data[16] / 8;
+	if (data[1] != 0 || (imageType != 2 && imageType != 3 && !bRLE)
+		|| (bGrey ? bytesPerPixel != 1 : (bytesPerPixel != 3 && bytesPerPixel != 4)))
+	{
+		throw std::runtime_error("Failed to decode TGA, colour mapped or unsupported pixel format: " + fileName);
+	}
+
+	width = ReadU16(data + 12);
+	height = ReadU16(data + 14);
+	CheckDimensions(width, height, fileName);
+	bool bTopDown = (data[17] & 0x20) != 0;
+	bool bRightToLeft = (data[17] & 0x10) != 0;
+
+	// Pixels are decoded in file order first, then placed
+	size_t pixelCount = static_cast<size_t>(width) * height;
+	std::vector<uint8_t> filePixels(pixelCount * 4);
+	auto WritePixel = [&](size_t index, const uint8_t* source)
+	{
+		uint8_t* target = &filePixels[index * 4];
+		if (bGrey)
+		{
+			target[0] = target[1] = target[2] = source[0];
+			target[3] = 255;
+		}
+		else
+		{
+			// Stored BGR(A)
+			target[0] = source[2];
+			target[1] = source[1];
+			target[2] = source[0];
+			target[3] = bytesPerPixel == 4 ? source[3] : 255;
+		}
+	};
+
+	size_t position = 18 + static_cast<size_t>(data[0]);
+	if (!bRLE)
+	{
+		if (position + pixelCount * bytesPerPixel > size)
+		{
+			throw std::runtime_error("Failed to decode TGA, pixel data is truncated: " + fileName);
+		}
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			WritePixel(i, data + position + i * bytesPerPixel);
+		}
+	}
+	else
+	{
+		// Packets: header byte, then one pixel repeated (top bit set) or count raw pixels
+		for (size_t i = 0; i < pixelCount;)
+		{
+			if (position >= size)
+			{
+				throw std::runtime_error("Failed to decode TGA, pixel data is truncated: " + fileName);
+			}
+			uint8_t header = data[position++];
+			size_t count = std::min<size_t>((header & 0x7F) + 1, pixelCount - i);
+			bool bRepeat = (header & 0x80) != 0;
+			size_t packetSize = (bRepeat ? 1 : count) * bytesPerPixel;
+			if (position + packetSize > size)
+			{
+				throw std::runtime_error("Failed to decode TGA, pixel data is truncated: " + fileName);
+			}
+			for (size_t p = 0; p < count; ++p)
+			{
+				WritePixel(i + p, data + position + (bRepeat ? 0 : p * bytesPerPixel));
+			}
+			position += packetSize;
+			i += count;
+		}
+	}
+
+	// Origin is bottom left unless the descriptor says otherwise
+	pixels.resize(pixelCount * 4);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		uint32_t fileRow = bTopDown ? y : height - 1 - y;
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint32_t fileColumn = bRightToLeft ? width - 1 - x : x;
+			memcpy(&pixels[(static_cast<size_t>(y) * width + x) * 4], &filePixels[(static_cast<size_t>(fileRow) * width + fileColumn) * 4], 4);
+		}
+	}
+}
+
+// Windows bitmap: uncompressed 24 bit, or 32 bit (BI_RGB, or BI_BITFIELDS with BGRA masks)
+static void DecodeBMP(const uint8_t* data, size_t size, const std::string& fileName, uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels)
+{
+	if (size < 54 || data[0] != 'B' || data[1] != 'M' || ReadU32(data + 14) < 40)
+	{
+		throw std::runtime_error("Failed to decode BMP, unknown header: " + fileName);
+	}
+
+	uint32_t dataOffset = ReadU32(data + 10);
+	uint32_t headerSize = ReadU32(data + 14);
+	int32_t signedWidth = static_cast<int32_t>(ReadU32(data + 18));
+	int32_t signedHeight = static_cast<int32_t>(ReadU32(data + 22));
+	uint32_t bitsPerPixel = ReadU16(data + 28);
+	uint32_t compression = ReadU32(data + 30);
+
+	// BI_BITFIELDS masks follow a 40 byte header, or are part of the larger ones
+	bool bAlpha = false;
+	if (compression == 3 && bitsPerPixel == 32 && size >= 66
+		&& ReadU32(data + 54) == 0x00FF0000 && ReadU32(data + 58) == 0x0000FF00 && ReadU32(data + 62) == 0x000000FF)
+	{
+		bAlpha = headerSize >= 56 && size >= 70 && ReadU32(data + 66) == 0xFF000000;
+	}
+	else if (compression != 0 || (bitsPerPixel != 24 && bitsPerPixel != 32))
+	{
+		throw std::runtime_error("Failed to decode BMP, compressed or unsupported pixel format: " + fileName);
+	}
+
+	if (signedWidth <= 0 || signedHeight == 0 || signedHeight == INT32_MIN)
+	{
+		throw std::runtime_error("Failed to decode BMP, unsupported dimensions: " + fileName);
+	}
+	width = static_cast<uint32_t>(signedWidth);
+	height = static_cast<uint32_t>(signedHeight < 0 ? -signedHeight : signedHeight);
+	CheckDimensions(width, height, fileName);
+	bool bTopDown = signedHeight < 0;
+
+	// Rows are padded to 4 bytes
+	uint32_t bytesPerPixel = bitsPerPixel / 8;
+	size_t rowStride = (static_cast<size_t>(width) * bitsPerPixel + 31) / 32 * 4;
+	if (dataOffset > size || rowStride * height > size - dataOffset)
+	{
+		throw std::runtime_error("Failed to decode BMP, pixel data is truncated: " + fileName);
+	}
+
+	pixels.resize(static_cast<size_t>(width) * height * 4);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* row = data + dataOffset + rowStride * (bTopDown ? y : height - 1 - y);
+		uint8_t* target = &pixels[static_cast<size_t>(y) * width * 4];
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint8_t* source = row + static_cast<size_t>(x) * bytesPerPixel;
+			target[x * 4 + 0] = source[2];
+			target[x * 4 + 1] = source[1];
+			target[x * 4 + 2] = source[0];
+			target[x * 4 + 3] = bAlpha ? source[3] : 255;
+		}
+	}
+}
+
+// Netpbm: binary greyscale (P5) and colour (P6), up to 8 bits per sample
+static void DecodePNM(const uint8_t* data, size_t size, const std::string& fileName, uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels)
+{
+	if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+	{
+		throw std::runtime_error("Failed to decode PNM, only binary PGM/PPM are supported: " + fileName);
+	}
+	uint32_t channels = data[1] == '6' ? 3 : 1;
+
+	// Width, height and max value as text, separated by whitespace and comments
+	size_t position = 2;
+	uint32_t fields[3] = {};
+	for (uint32_t& field : fields)
+	{
+		while (position < size && (isspace(data[position]) || data[position] == '#'))
+		{
+			if (data[position] == '#')
+			{
+				while (position < size && data[position] != '\n')
+				{
+					++position;
+				}
+			}
+			else
+			{
+				++position;
+			}
+		}
+		if (position >= size || !isdigit(data[position]))
+		{
+			throw std::runtime_error("Failed to decode PNM, header is malformed: " + fileName);
+		}
+		while (position < size && isdigit(data[position]) && field <= MAX_IMAGE_DIMENSION * 10)
+		{
+			field = field * 10 + (data[position++] - '0');
+		}
+	}
+	// Exactly one whitespace character before the samples
+	++position;
+
+	width = fields[0];
+	height = fields[1];
+	uint32_t maxValue = fields[2];
+	CheckDimensions(width, height, fileName);
+	if (maxValue == 0 || maxValue > 255)
+	{
+		throw std::runtime_error("Failed to decode PNM, only 8 bit samples are supported: " + fileName);
+	}
+
+	size_t pixelCount = static_cast<size_t>(width) * height;
+	if (position > size || pixelCount * channels > size - position)
+	{
+		throw std::runtime_error("Failed to decode PNM, pixel data is truncated: " + fileName);
+	}
+
+	pixels.resize(pixelCount * 4);
+	const uint8_t* samples = data + position;
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			uint32_t sample = samples[i * channels + (channels == 3 ? c : 0)];
+			pixels[i * 4 + c] = static_cast<uint8_t>(maxValue == 255 ? sample : (sample * 255 + maxValue / 2) / maxValue);
+		}
+		pixels[i * 4 + 3] = 255;
+	}
+}
+
+TextureLoader::TextureLoader(int threadCount)
+{
+	// Leave one core for the render thread by default
+	if (threadCount <= 0)
+	{
+		threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+	}
+
+	for (int i = 0; i < threadCount; ++i)
+	{
+		workers.emplace_back(&TextureLoader::WorkerLoop, this);
+	}
+}
+
+TextureLoader::~TextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		bStopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void TextureLoader::Load(Texture* texture, const std::vector<std::string>& fileNames, bool bMipChain)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		requests.push_back({ texture, fileNames, bMipChain });
+	}
+	queueCondition.notify_one();
+}
+
+void TextureLoader::CollectResults(std::vector<Result>& collected)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	for (auto& result : results)
+	{
+		collected.push_back(std::move(result));
+	}
+	results.clear();
+}
+
+void TextureLoader::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(queueMutex);
+	idleCondition.wait(lock, [this] { return requests.empty() && busyCount == 0; });
+}
+
+void TextureLoader::DecodeImage(const std::string& fileName, ImageData& image)
+{
+	PROFILE_FUNCTION();
+
+	MappedFile file(fileName);
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(file.GetData());
+	size_t size = file.GetSize();
+
+	// TGA has no magic number, it is whatever isn't recognised by its header
+	image.layerCount = 1;
+	if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+	{
+		DecodeBMP(data, size, fileName, image.width, image.height, image.pixels);
+	}
+	else if (size >= 2 && data[0] == 'P' && isdigit(data[1]))
+	{
+		DecodePNM(data, size, fileName, image.width, image.height, image.pixels);
+	}
+	else
+	{
+		std::string extension = fileName.substr(std::min(fileName.size(), fileName.find_last_of('.') + 1));
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+		if (extension != "tga")
+		{
+			throw std::runtime_error("Failed to decode image, unsupported format: " + fileName);
+		}
+		DecodeTGA(data, size, fileName, image.width, image.height, image.pixels);
+	}
+}
+
+void TextureLoader::BuildMip(const ImageData& source, bool bSRGB, ImageData& mip)
+{
+	// sRGB to linear of every 8 bit value, linear to sRGB is only needed once per output texel
+	static float toLinear[256];
+	static bool bToLinear = [] {
+		for (int i = 0; i < 256; ++i)
+		{
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return true;
+	}();
+	(void)bToLinear;
+
+	mip.width = std::max(1u, source.width / 2);
+	mip.height = std::max(1u, source.height / 2);
+	mip.layerCount = source.layerCount;
+	mip.pixels.resize(static_cast<size_t>(mip.width) * mip.height * mip.layerCount * 4);
+
+	// Odd sizes clamp the second texel, as the compute downsampler does
+	for (uint32_t layer = 0; layer < mip.layerCount; ++layer)
+	{
+		const uint8_t* sourceLayer = source.pixels.data() + static_cast<size_t>(layer) * source.width * source.height * 4;
+		uint8_t* mipLayer = mip.pixels.data() + static_cast<size_t>(layer) * mip.width * mip.height * 4;
+		for (uint32_t y = 0; y < mip.height; ++y)
+		{
+			uint32_t y0 = std::min(y * 2, source.height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+			for (uint32_t x = 0; x < mip.width; ++x)
+			{
+				uint32_t x0 = std::min(x * 2, source.width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+				const uint8_t* texels[4] = {
+					sourceLayer + (static_cast<size_t>(y0) * source.width + x0) * 4, sourceLayer + (static_cast<size_t>(y0) * source.width + x1) * 4,
+					sourceLayer + (static_cast<size_t>(y1) * source.width + x0) * 4, sourceLayer + (static_cast<size_t>(y1) * source.width + x1) * 4 };
+
+				uint8_t* target = mipLayer + (static_cast<size_t>(y) * mip.width + x) * 4;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					// Alpha is always linear
+					if (bSRGB && c < 3)
+					{
+						float linear = (toLinear[texels[0][c]] + toLinear[texels[1][c]] + toLinear[texels[2][c]] + toLinear[texels[3][c]]) * 0.25f;
+						float encoded = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+						target[c] = static_cast<uint8_t>(std::min(255.0f, encoded * 255.0f + 0.5f));
+					}
+					else
+					{
+						target[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+}
+
+void TextureLoader::DecodeLayers(const std::vector<std::string>& fileNames, ImageData& image)
+{
+	if (fileNames.empty())
+	{
+		throw std::runtime_error("Failed to decode texture, no files given!");
+	}
+
+	DecodeImage(fileNames[0], image);
+	for (size_t i = 1; i < fileNames.size(); ++i)
+	{
+		ImageData layer;
+		DecodeImage(fileNames[i], layer);
+		if (layer.width != image.width || layer.height != image.height)
+		{
+			throw std::runtime_error("Failed to decode texture, layers differ in size: " + fileNames[i]);
+		}
+		image.pixels.insert(image.pixels.end(), layer.pixels.begin(), layer.pixels.end());
+		++image.layerCount;
+	}
+}
+
+void TextureLoader::WorkerLoop()
+{
+	PROFILE_THREAD_NAME("TextureLoader");
+
+	while (true)
+	{
+		LoadRequest request;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return bStopping || !requests.empty(); });
+
+			if (bStopping)
+			{
+				break;
+			}
+
+			request = std::move(requests.front());
+			requests.pop_front();
+			++busyCount;
+		}
+
+		Result result;
+		result.texture = request.texture;
+		auto decodeStart = std::chrono::high_resolution_clock::now();
+		try
+		{
+			DecodeLayers(request.fileNames, result.image);
+			if (request.bMipChain)
+			{
+				uint32_t mipCount = 0;
+				for (uint32_t size = std::max(result.image.width, result.image.height); size > 1; size /= 2)
+				{
+					++mipCount;
+				}
+				result.mips.resize(mipCount);
+				for (uint32_t i = 0; i < mipCount; ++i)
+				{
+					BuildMip(i == 0 ? result.image : result.mips[i - 1], request.texture->bSRGB, result.mips[i]);
+				}
+			}
+		}
+		catch (const std::runtime_error& e)
+		{
+			result.image = ImageData();
+			result.mips.clear();
+			result.error = e.what();
+		}
+		result.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - decodeStart).count();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			results.push_back(std::move(result));
+			--busyCount;
+		}
+		idleCondition.notify_all();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "Texture.h"
+
+// Decoded image, tightly packed RGBA8, top row first, layers one after another
+struct ImageData
+{
+	uint32_t				width = 0;
+	uint32_t				height = 0;
+	uint32_t				layerCount = 0;
+	std::vector<uint8_t>	pixels;
+};
+
+// Background image decoding service
+// Files are decoded on worker threads, the render thread collects the results and uploads them.
+// Formats: TGA (true colour / greyscale, uncompressed or RLE), BMP (24/32 bit uncompressed) and binary PPM/PGM.
+class TextureLoader
+{
+public:
+	struct Result
+	{
+		Texture*				texture;
+		ImageData				image;
+		std::vector<ImageData>	mips;				// Levels 1.. down to 1x1, if a mip chain was asked for
+		double					decodeMs = 0.0;
+		std::string				error;				// Empty if decoding succeeded
+	};
+
+	TextureLoader(int threadCount = 0);
+	~TextureLoader();
+
+	// Queue the files making up the layers of a texture (all must be the same size)
+	// The texture must stay alive until its result has been collected
+	// bMipChain: also build every mip on the CPU (streamed textures upload mips individually)
+	void					Load(Texture* texture, const std::vector<std::string>& fileNames, bool bMipChain = false);
+
+	// Move every finished result in to results (never blocks)
+	void					CollectResults(std::vector<Result>& results);
+
+	// Block until nothing is queued or being decoded
+	void					WaitIdle();
+
+	// Decode a single file, throws on unreadable or unsupported files
+	static void				DecodeImage(const std::string& fileName, ImageData& image);
+
+	// Next mip of an image, 2x2 box filter (in linear space if bSRGB), as the GPU mip generators filter
+	static void				BuildMip(const ImageData& source, bool bSRGB, ImageData& mip);
+
+private:
+	struct LoadRequest
+	{
+		Texture*				texture;
+		std::vector<std::string> fileNames;
+		bool					bMipChain;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<LoadRequest>	requests;
+	std::vector<Result>		results;
+	std::mutex				queueMutex;
+	std::condition_variable	queueCondition;
+	std::condition_variable	idleCondition;
+	uint32_t				busyCount = 0;			// Requests taken by a worker and not yet in results
+	bool					bStopping = false;
+
+	void					WorkerLoop();
+	static void				DecodeLayers(const std::vector<std::string>& fileNames, ImageData& image);
+};
@@ -0,0 +1,549 @@
+#include "TextureStreamer.h"
+#include "CpuProfiler.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Stages that sample streamed textures
+static const VkPipelineStageFlags SAMPLING_STAGES = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+// Layout transition of a range of levels (every layer)
+static void RecordLevelBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount, uint32_t layerCount,
+	VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+	VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, layerCount };
+
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+TextureStreamer::TextureStreamer(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator* allocator, StagingRing* stagingRing,
+	bool bMemoryBudget, VkDeviceSize budget)
+	: physicalDevice(physicalDevice), device(device), allocator(allocator), stagingRing(stagingRing), bMemoryBudget(bMemoryBudget), fixedBudget(budget)
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			&& memoryProperties.memoryHeaps[i].size > memoryProperties.memoryHeaps[heapIndex].size)
+		{
+			heapIndex = i;
+		}
+	}
+
+	UpdateBudget();
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Textures still streaming keep their current image (destroyed with the texture), only the ones being built go
+	for (auto& entry : textures)
+	{
+		if (entry.second.bPending)
+		{
+			vkDestroyImage(device, entry.second.pending.image, nullptr);
+			allocator->Free(entry.second.pending.allocation);
+		}
+	}
+	Reclaim(UINT64_MAX);
+}
+
+void TextureStreamer::Add(Texture* texture, ImageData&& image, std::vector<ImageData>&& mips)
+{
+	StreamedTexture& streamed = textures[texture];
+	streamed.texture = texture;
+	streamed.image = std::move(image);
+	streamed.mips = std::move(mips);
+	streamed.mipCount = static_cast<uint32_t>(streamed.mips.size()) + 1;
+
+	// Tail is every mip at most MIP_TAIL_SIZE across (or just the last one)
+	streamed.tailMip = streamed.mipCount - 1;
+	while (streamed.tailMip > 0 && std::max(GetMip(streamed, streamed.tailMip - 1).width, GetMip(streamed, streamed.tailMip - 1).height) <= MIP_TAIL_SIZE)
+	{
+		--streamed.tailMip;
+	}
+	streamed.wantedMip = streamed.tailMip;
+	streamed.lastUsedFrame = frame;
+
+	texture->bStreamed = true;
+	texture->residentMip = streamed.mipCount;
+	texture->layerCount = streamed.image.layerCount;
+	texture->format = texture->bSRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	texture->state = TextureState::Uploading;
+}
+
+void TextureStreamer::Remove(Texture* texture, uint64_t serial)
+{
+	auto found = textures.find(texture);
+	if (found == textures.end())
+	{
+		return;
+	}
+
+	StreamedTexture& streamed = found->second;
+	if (streamed.bPending)
+	{
+		RetireImage(streamed.pending.image, VK_NULL_HANDLE, streamed.pending.allocation, serial);
+		pendingChanges.erase(std::find(pendingChanges.begin(), pendingChanges.end(), &streamed));
+	}
+	if (texture->image != VK_NULL_HANDLE)
+	{
+		RetireImage(texture->image, texture->imageView, texture->allocation, serial);
+		texture->image = VK_NULL_HANDLE;
+		texture->imageView = VK_NULL_HANDLE;
+		texture->allocation = MemoryAllocation();
+	}
+
+	textures.erase(found);
+}
+
+void TextureStreamer::ReportUsage(Texture* texture, float pixels)
+{
+	auto found = textures.find(texture);
+	if (found == textures.end())
+	{
+		return;
+	}
+
+	found->second.reportedPixels = std::max(found->second.reportedPixels, pixels);
+	found->second.lastUsedFrame = frame;
+}
+
+void TextureStreamer::RecordUpdates(VkCommandBuffer commandBuffer)
+{
+	PROFILE_FUNCTION();
+
+	UpdateBudget();
+
+	// What will be resident once the changes in progress are done
+	VkDeviceSize committedBytes = 0;
+	for (auto& entry : textures)
+	{
+		StreamedTexture& streamed = entry.second;
+		committedBytes += GetMipRangeSize(streamed, streamed.bPending ? streamed.pending.firstMip : streamed.texture->residentMip);
+
+		// Coarsest mip still at least as large as the texture is on screen
+		if (streamed.lastUsedFrame == frame && streamed.reportedPixels > 0.0f)
+		{
+			uint32_t wantedMip = 0;
+			while (wantedMip < streamed.tailMip && std::max(GetMip(streamed, wantedMip + 1).width, GetMip(streamed, wantedMip + 1).height) >= streamed.reportedPixels)
+			{
+				++wantedMip;
+			}
+			streamed.wantedMip = wantedMip;
+		}
+		streamed.reportedPixels = 0.0f;
+	}
+
+	// Mip tails first, whatever the budget
+	std::vector<StreamedTexture*> candidates;
+	for (auto& entry : textures)
+	{
+		StreamedTexture& streamed = entry.second;
+		if (streamed.texture->image == VK_NULL_HANDLE && !streamed.bPending)
+		{
+			StartChange(streamed, streamed.tailMip);
+			committedBytes += GetMipRangeSize(streamed, streamed.tailMip);
+		}
+		else if (!streamed.bPending && streamed.lastUsedFrame == frame && streamed.wantedMip < streamed.texture->residentMip)
+		{
+			candidates.push_back(&streamed);
+		}
+	}
+
+	// Then finer mips, furthest from what the screen needs first, one level per change
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		return a->texture->residentMip - a->wantedMip > b->texture->residentMip - b->wantedMip;
+	});
+	for (StreamedTexture* streamed : candidates)
+	{
+		if (pendingChanges.size() >= MAX_PENDING_CHANGES)
+		{
+			break;
+		}
+
+		uint32_t firstMip = streamed->texture->residentMip - 1;
+		VkDeviceSize neededBytes = GetMipRangeSize(*streamed, firstMip) - GetMipRangeSize(*streamed, streamed->texture->residentMip);
+		if (committedBytes + neededBytes > budget)
+		{
+			committedBytes -= Evict(committedBytes + neededBytes - budget);
+			if (committedBytes + neededBytes > budget)
+			{
+				break;
+			}
+		}
+
+		StartChange(*streamed, firstMip);
+		committedBytes += neededBytes;
+	}
+
+	// The budget can shrink (other applications, other allocations of ours)
+	if (committedBytes > budget)
+	{
+		Evict(committedBytes - budget);
+	}
+
+	// New images must be in TRANSFER_DST before the ring's copies and the swaps
+	for (StreamedTexture* streamed : pendingChanges)
+	{
+		PendingImage& pending = streamed->pending;
+		if (!pending.bStarted)
+		{
+			RecordLevelBarrier(commandBuffer, pending.image, 0, streamed->mipCount - pending.firstMip, streamed->image.layerCount,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			pending.bStarted = true;
+		}
+	}
+
+	// Uploads in the order changes were started, until the ring is full
+	for (StreamedTexture* streamed : pendingChanges)
+	{
+		if (!QueueUploads(*streamed))
+		{
+			break;
+		}
+	}
+
+	++frame;
+}
+
+void TextureStreamer::RecordCompletions(VkCommandBuffer commandBuffer, uint64_t serial, std::vector<Texture*>& loadedTextures)
+{
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < pendingChanges.size();)
+	{
+		StreamedTexture* streamed = pendingChanges[i];
+		if (streamed->pending.uploadMip < streamed->pending.endMip)
+		{
+			++i;
+			continue;
+		}
+
+		if (streamed->texture->image == VK_NULL_HANDLE)
+		{
+			loadedTextures.push_back(streamed->texture);
+		}
+		RecordSwap(commandBuffer, *streamed, serial);
+		pendingChanges.erase(pendingChanges.begin() + i);
+	}
+}
+
+void TextureStreamer::Reclaim(uint64_t completedSerial)
+{
+	for (size_t i = 0; i < retiredImages.size();)
+	{
+		RetiredImage& retired = retiredImages[i];
+		if (retired.serial > completedSerial)
+		{
+			++i;
+			continue;
+		}
+
+		vkDestroyImageView(device, retired.imageView, nullptr);
+		vkDestroyImage(device, retired.image, nullptr);
+		allocatedBytes -= retired.allocation.size;
+		allocator->Free(retired.allocation);
+
+		retiredImages[i] = retiredImages.back();
+		retiredImages.pop_back();
+	}
+}
+
+bool TextureStreamer::IsLoading() const
+{
+	for (const auto& entry : textures)
+	{
+		if (entry.second.texture->image == VK_NULL_HANDLE)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+TextureStreamer::Stats TextureStreamer::GetStats() const
+{
+	Stats stats;
+	stats.textureCount = static_cast<uint32_t>(textures.size());
+	stats.pendingChanges = static_cast<uint32_t>(pendingChanges.size());
+	stats.residentBytes = allocatedBytes;
+	stats.budgetBytes = budget;
+	stats.bMemoryBudget = bMemoryBudget && fixedBudget == 0;
+	stats.streamedInMips = streamedInMips;
+	stats.evictedMips = evictedMips;
+
+	for (const auto& entry : textures)
+	{
+		const StreamedTexture& streamed = entry.second;
+		uint32_t residentMip = streamed.texture->residentMip;
+		stats.loadingCount += streamed.texture->image == VK_NULL_HANDLE ? 1 : 0;
+		stats.residentMips += streamed.mipCount - residentMip;
+		stats.totalMips += streamed.mipCount;
+		if (streamed.lastUsedFrame + 1 == frame && residentMip > streamed.wantedMip)
+		{
+			stats.missingMips += residentMip - streamed.wantedMip;
+		}
+		stats.fullBytes += GetMipRangeSize(streamed, 0);
+	}
+
+	return stats;
+}
+
+void TextureStreamer::UpdateBudget()
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	if (fixedBudget > 0)
+	{
+		budget = fixedBudget;
+	}
+	else if (bMemoryBudget)
+	{
+		// Whatever the rest of the process isn't using of what the OS gives it, less some headroom
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+		VkDeviceSize heapBudget = static_cast<VkDeviceSize>(budgetProperties.heapBudget[heapIndex] * (1.0 - BUDGET_HEADROOM));
+		VkDeviceSize otherUsage = budgetProperties.heapUsage[heapIndex] > allocatedBytes ? budgetProperties.heapUsage[heapIndex] - allocatedBytes : 0;
+		budget = heapBudget > otherUsage ? heapBudget - otherUsage : 0;
+	}
+	else
+	{
+		budget = static_cast<VkDeviceSize>(memoryProperties.memoryHeaps[heapIndex].size * HEAP_BUDGET_SHARE);
+	}
+}
+
+void TextureStreamer::StartChange(StreamedTexture& streamed, uint32_t firstMip)
+{
+	const ImageData& firstLevel = GetMip(streamed, firstMip);
+
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { firstLevel.width, firstLevel.height, 1 };
+	imageCreateInfo.mipLevels = streamed.mipCount - firstMip;
+	imageCreateInfo.arrayLayers = streamed.image.layerCount;
+	imageCreateInfo.format = streamed.texture->format;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// Source of the copies of the next change
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	PendingImage& pending = streamed.pending;
+	pending = PendingImage();
+	if (vkCreateImage(device, &imageCreateInfo, nullptr, &pending.image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Image!");
+	}
+	allocator->AllocateImageMemory(pending.image, VK_IMAGE_TILING_OPTIMAL, MemoryUsage::GpuOnly, &pending.allocation);
+	allocatedBytes += pending.allocation.size;
+
+	// Mips the current image doesn't have are uploaded (none for an eviction)
+	pending.firstMip = firstMip;
+	pending.endMip = std::max(firstMip, std::min(streamed.texture->residentMip, streamed.mipCount));
+	pending.uploadMip = firstMip;
+
+	streamed.bPending = true;
+	pendingChanges.push_back(&streamed);
+}
+
+bool TextureStreamer::QueueUploads(StreamedTexture& streamed)
+{
+	PendingImage& pending = streamed.pending;
+	uint32_t layerCount = streamed.image.layerCount;
+
+	// Row bands of at most a quarter of the ring, so one large mip can't hold up everything behind it
+	while (pending.uploadMip < pending.endMip)
+	{
+		const ImageData& mip = GetMip(streamed, pending.uploadMip);
+		VkDeviceSize rowSize = static_cast<VkDeviceSize>(mip.width) * 4;
+		uint32_t bandRows = static_cast<uint32_t>(std::max<VkDeviceSize>(1, StagingRing::DEFAULT_CAPACITY / 4 / rowSize));
+		uint32_t rows = std::min(bandRows, mip.height - pending.row);
+
+		VkBufferImageCopy region = {};
+		region.bufferRowLength = 0;											// Tightly packed
+		region.bufferImageHeight = 0;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, pending.uploadMip - pending.firstMip, pending.layer, 1 };
+		region.imageOffset = { 0, static_cast<int32_t>(pending.row), 0 };
+		region.imageExtent = { mip.width, rows, 1 };
+
+		const uint8_t* data = mip.pixels.data() + (static_cast<size_t>(pending.layer) * mip.height + pending.row) * rowSize;
+		if (!stagingRing->UploadToImage(pending.image, region, data, rows * rowSize))
+		{
+			return false;
+		}
+
+		pending.row += rows;
+		if (pending.row == mip.height)
+		{
+			pending.row = 0;
+			if (++pending.layer == layerCount)
+			{
+				pending.layer = 0;
+				++pending.uploadMip;
+			}
+		}
+	}
+
+	return true;
+}
+
+void TextureStreamer::RecordSwap(VkCommandBuffer commandBuffer, StreamedTexture& streamed, uint64_t serial)
+{
+	Texture* texture = streamed.texture;
+	PendingImage& pending = streamed.pending;
+	uint32_t layerCount = streamed.image.layerCount;
+	uint32_t oldMip = texture->residentMip;
+
+	// Mips both images have are copied on the GPU, the old image is only read from after this
+	uint32_t copyMip = std::max(oldMip, pending.firstMip);
+	if (texture->image != VK_NULL_HANDLE && copyMip < streamed.mipCount)
+	{
+		RecordLevelBarrier(commandBuffer, texture->image, copyMip - oldMip, streamed.mipCount - copyMip, layerCount,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, VK_ACCESS_TRANSFER_READ_BIT,
+			SAMPLING_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		std::vector<VkImageCopy> regions;
+		for (uint32_t mip = copyMip; mip < streamed.mipCount; ++mip)
+		{
+			VkImageCopy region = {};
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - oldMip, 0, layerCount };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - pending.firstMip, 0, layerCount };
+			region.extent = { GetMip(streamed, mip).width, GetMip(streamed, mip).height, 1 };
+			regions.push_back(region);
+		}
+		vkCmdCopyImage(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pending.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
+	// Uploads were made visible by the ring's barrier, the copies by this one
+	RecordLevelBarrier(commandBuffer, pending.image, 0, streamed.mipCount - pending.firstMip, layerCount,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, SAMPLING_STAGES);
+
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = pending.image;
+	viewCreateInfo.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = texture->format;
+	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+	viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, streamed.mipCount - pending.firstMip, 0, layerCount };
+
+	VkImageView imageView;
+	if (vkCreateImageView(device, &viewCreateInfo, nullptr, &imageView) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Image View!");
+	}
+
+	// Frames already submitted keep sampling the old image
+	if (texture->image != VK_NULL_HANDLE)
+	{
+		RetireImage(texture->image, texture->imageView, texture->allocation, serial);
+	}
+	if (pending.firstMip < oldMip)
+	{
+		streamedInMips += oldMip - pending.firstMip;
+	}
+	else
+	{
+		evictedMips += pending.firstMip - oldMip;
+	}
+
+	texture->image = pending.image;
+	texture->allocation = pending.allocation;
+	texture->imageView = imageView;
+	texture->width = GetMip(streamed, pending.firstMip).width;
+	texture->height = GetMip(streamed, pending.firstMip).height;
+	texture->mipLevels = streamed.mipCount - pending.firstMip;
+	texture->residentMip = pending.firstMip;
+	streamed.bPending = false;
+}
+
+VkDeviceSize TextureStreamer::Evict(VkDeviceSize bytes)
+{
+	// Not seen this frame, or sharper than the screen needs, least recently used first
+	std::vector<StreamedTexture*> candidates;
+	for (auto& entry : textures)
+	{
+		StreamedTexture& streamed = entry.second;
+		uint32_t residentMip = streamed.texture->residentMip;
+		if (!streamed.bPending && streamed.texture->image != VK_NULL_HANDLE && residentMip < streamed.tailMip
+			&& (streamed.lastUsedFrame < frame || residentMip < streamed.wantedMip))
+		{
+			candidates.push_back(&streamed);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		return a->lastUsedFrame < b->lastUsedFrame;
+	});
+
+	// Only as many mips as needed, unused textures at most down to their tail, visible ones to what they need
+	VkDeviceSize freedBytes = 0;
+	for (StreamedTexture* streamed : candidates)
+	{
+		if (freedBytes >= bytes)
+		{
+			break;
+		}
+
+		uint32_t residentMip = streamed->texture->residentMip;
+		uint32_t lastMip = streamed->lastUsedFrame < frame ? streamed->tailMip : streamed->wantedMip;
+		uint32_t firstMip = residentMip + 1;
+		while (firstMip < lastMip && freedBytes + GetMipRangeSize(*streamed, residentMip) - GetMipRangeSize(*streamed, firstMip) < bytes)
+		{
+			++firstMip;
+		}
+
+		freedBytes += GetMipRangeSize(*streamed, residentMip) - GetMipRangeSize(*streamed, firstMip);
+		StartChange(*streamed, firstMip);
+	}
+
+	return freedBytes;
+}
+
+const ImageData& TextureStreamer::GetMip(const StreamedTexture& streamed, uint32_t mip) const
+{
+	return mip == 0 ? streamed.image : streamed.mips[mip - 1];
+}
+
+VkDeviceSize TextureStreamer::GetMipRangeSize(const StreamedTexture& streamed, uint32_t firstMip) const
+{
+	VkDeviceSize size = 0;
+	for (uint32_t mip = firstMip; mip < streamed.mipCount; ++mip)
+	{
+		size += GetMip(streamed, mip).pixels.size();
+	}
+	return size;
+}
+
+void TextureStreamer::RetireImage(VkImage image, VkImageView imageView, const MemoryAllocation& allocation, uint64_t serial)
+{
+	RetiredImage retired;
+	retired.image = image;
+	retired.imageView = imageView;
+	retired.allocation = allocation;
+	retired.serial = serial;
+	retiredImages.push_back(retired);
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <vector>
+#include <unordered_map>
+
+#include "Texture.h"
+#include "TextureLoader.h"
+#include "StagingRing.h"
+#include "GpuAllocator.h"
+
+// Texture streaming residency manager
+// Streamed textures keep their whole mip chain in system memory and only the mips the screen needs in device memory.
+// The mip tail is made resident first, finer mips follow screen-space usage feedback one level at a time, and the least
+// recently used mips are evicted to stay under a device memory budget (VK_EXT_memory_budget, else a share of the heap).
+// A residency change builds an image holding the new mip range, copies the mips both have from the current image,
+// uploads the others through the staging ring and swaps the new image in once everything is recorded.
+class TextureStreamer
+{
+public:
+	struct Stats
+	{
+		uint32_t			textureCount = 0;
+		uint32_t			loadingCount = 0;			// Mip tail not resident yet
+		uint32_t			residentMips = 0;			// Summed over every texture
+		uint32_t			totalMips = 0;
+		uint32_t			missingMips = 0;			// Asked for by last frame's feedback but not resident
+		uint32_t			pendingChanges = 0;			// Residency changes in progress
+		VkDeviceSize		residentBytes = 0;			// Device memory of streamed images, including replaced ones not yet freed
+		VkDeviceSize		fullBytes = 0;				// Needed if every mip of every texture was resident
+		VkDeviceSize		budgetBytes = 0;
+		bool				bMemoryBudget = false;		// Budget follows VK_EXT_memory_budget
+		uint64_t			streamedInMips = 0;			// Since the streamer was created
+		uint64_t			evictedMips = 0;
+	};
+
+	// budget: bytes streamed textures may use, 0 = what VK_EXT_memory_budget leaves (bMemoryBudget) or a share of the device heap
+	TextureStreamer(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator* allocator, StagingRing* stagingRing,
+		bool bMemoryBudget, VkDeviceSize budget = 0);
+	~TextureStreamer();
+
+	// Take over a decoded texture and its CPU mip chain (levels 1..), its mip tail is uploaded by the next update
+	void				Add(Texture* texture, ImageData&& image, std::vector<ImageData>&& mips);
+
+	// Stop streaming a texture (unknown textures are ignored), its images are destroyed once the work tagged serial completes
+	void				Remove(Texture* texture, uint64_t serial);
+
+	// Screen-space usage feedback: the texture covers about "pixels" pixels across on screen this frame (largest report wins)
+	void				ReportUsage(Texture* texture, float pixels);
+
+	// Decide residency changes from this frame's feedback and the budget, and queue their uploads on the staging ring
+	// Must be followed by the ring's RecordCopies, then RecordCompletions, in the same command buffer
+	void				RecordUpdates(VkCommandBuffer commandBuffer);
+
+	// Swap in every image whose uploads are recorded, textures whose mip tail became resident are added to loadedTextures
+	void				RecordCompletions(VkCommandBuffer commandBuffer, uint64_t serial, std::vector<Texture*>& loadedTextures);
+
+	// Destroy replaced images whose serial has completed
+	void				Reclaim(uint64_t completedSerial);
+
+	bool				IsLoading() const;			// Some mip tail isn't resident yet
+	Stats				GetStats() const;
+
+private:
+	// Mips this size and smaller are the tail, resident from the start and never evicted
+	static const uint32_t	MIP_TAIL_SIZE = 64;
+
+	// Changes to finer mips started at once (each holds two images until it completes)
+	static const uint32_t	MAX_PENDING_CHANGES = 8;
+
+	// Share of the device local heap used without VK_EXT_memory_budget,
+	// and share of the reported budget left free for other applications
+	static constexpr double	HEAP_BUDGET_SHARE = 0.5;
+	static constexpr double	BUDGET_HEADROOM = 0.1;
+
+	// Image being built for a new resident mip range
+	struct PendingImage
+	{
+		VkImage				image = VK_NULL_HANDLE;
+		MemoryAllocation	allocation;
+		uint32_t			firstMip = 0;				// Mip of the full chain in its level 0
+		uint32_t			endMip = 0;					// Mips [firstMip, endMip) are uploaded, the rest copied from the current image
+		uint32_t			uploadMip = 0;				// Next rows to upload
+		uint32_t			layer = 0;
+		uint32_t			row = 0;
+		bool				bStarted = false;			// Transition to TRANSFER_DST recorded
+	};
+
+	struct StreamedTexture
+	{
+		Texture*			texture;
+		ImageData			image;						// Level 0
+		std::vector<ImageData> mips;					// Levels 1..
+		uint32_t			mipCount;					// Full chain, texture->residentMip == mipCount when nothing is resident
+		uint32_t			tailMip;
+		uint32_t			wantedMip;					// Finest mip feedback asked for
+		float				reportedPixels = 0.0f;		// Largest report of this frame
+		uint64_t			lastUsedFrame = 0;			// Last update it was reported in (eviction is least recently used first)
+		bool				bPending = false;
+		PendingImage		pending;
+	};
+
+	struct RetiredImage
+	{
+		VkImage				image;
+		VkImageView			imageView;
+		MemoryAllocation	allocation;
+		uint64_t			serial;
+	};
+
+	VkPhysicalDevice	physicalDevice;
+	VkDevice			device;
+	GpuAllocator*		allocator;
+	StagingRing*		stagingRing;
+
+	bool				bMemoryBudget;
+	VkDeviceSize		fixedBudget;
+	VkDeviceSize		budget = 0;
+	uint32_t			heapIndex = 0;					// Largest device local heap
+
+	// Node based, so the pointers in pendingChanges stay valid
+	std::unordered_map<Texture*, StreamedTexture> textures;
+	std::deque<StreamedTexture*> pendingChanges;		// In the order they were started
+	std::vector<RetiredImage> retiredImages;
+
+	uint64_t			frame = 0;						// Updates so far
+	VkDeviceSize		allocatedBytes = 0;
+	uint64_t			streamedInMips = 0;
+	uint64_t			evictedMips = 0;
+
+	void				UpdateBudget();
+	void				StartChange(StreamedTexture& streamed, uint32_t firstMip);
+	bool				QueueUploads(StreamedTexture& streamed);	// False once the ring is full
+	void				RecordSwap(VkCommandBuffer commandBuffer, StreamedTexture& streamed, uint64_t serial);
+
+	// Start evictions until bytes have been freed, returns how much was
+	VkDeviceSize		Evict(VkDeviceSize bytes);
+
+	const ImageData&	GetMip(const StreamedTexture& streamed, uint32_t mip) const;
+	VkDeviceSize		GetMipRangeSize(const StreamedTexture& streamed, uint32_t firstMip) const;	// Estimate, mips firstMip..
+	void				RetireImage(VkImage image, VkImageView imageView, const MemoryAllocation& allocation, uint64_t serial);
+};
@@ -1,9 +1,79 @@
 #pragma once
 
-#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <GLM/glm.hpp>
 
 const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
+// Number of frames the CPU is allowed to record ahead of the GPU
+// (2 lets the CPU build frame N+1 while the GPU executes frame N)
+const int DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+// Most queues created per dedicated family (more only help if work is submitted from that many threads)
+const uint32_t MAX_TRANSFER_QUEUES = 2;
+const uint32_t MAX_COMPUTE_QUEUES = 2;
+
+// File the pipeline cache is loaded from at startup and saved to on shutdown
+const std::string PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+// First word of every SPIR-V module
+const uint32_t SPIRV_MAGIC_NUMBER = 0x07230203;
+
+// 64-bit FNV-1a hash of a block of memory
+// Pass a previous result as "hash" to continue hashing across several blocks
+static uint64_t HashFNV1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Vertex data representation (layout in vertex buffers is decided by a VertexLayout)
+struct Vertex
+{
+	glm::vec3 pos;		// Vertex position (x, y, z)
+	glm::vec3 col;		// Vertex colour (r, g, b)
+};
+
+// Limits of a meshlet (cluster of triangles culled as one), sized for mesh shader workgroups
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Meshlet as the culling shaders read it (std430, must match Shaders/cluster_common.glsl)
+struct Meshlet
+{
+	glm::vec3	center;				// Bounding sphere
+	float		radius;
+	glm::vec3	coneApex;			// Normal cone, backfacing from every camera position inside it
+	float		coneCutoff;			// > 1 = never backfacing
+	glm::vec3	coneAxis;
+	uint32_t	firstIndex;			// Triangles are indices [firstIndex, firstIndex + triangleCount * 3) of the mesh
+	uint32_t	vertexOffset;		// In to the meshlet vertex list (mesh index of each local vertex)
+	uint32_t	vertexCount;
+	uint32_t	triangleOffset;		// Byte offset in to the meshlet triangle list (3 local vertex indices per triangle)
+	uint32_t	triangleCount;
+};
+
+// Optional device extensions and features, decided when the device is picked
+struct DeviceSupport
+{
+	bool bMeshShader = false;			// VK_EXT_mesh_shader with task and mesh shaders
+	bool bMultiDrawIndirect = false;	// More than one draw per indirect call
+	bool bDrawIndirectCount = false;	// Draw count read from a buffer (Vulkan 1.2 feature)
+	bool bMemoryBudget = false;			// VK_EXT_memory_budget, heap budget and usage of this process
+	bool bDynamicRendering = false;		// VK_KHR_dynamic_rendering, passes render without render pass or framebuffer objects
+	bool bExtendedDynamicState = false;	// VK_EXT_extended_dynamic_state, cull mode, front face, topology and depth state set when recording
+	bool bExtendedDynamicState2 = false;	// VK_EXT_extended_dynamic_state2, primitive restart set when recording
+	bool bExtendedDynamicState3 = false;	// VK_EXT_extended_dynamic_state3 with dynamic blend enable
+};
+
 // Indices (locations) of Queue families (if they exist at all)
 struct QueueFamilyIndices  
 {
@@ -13,12 +83,80 @@ struct QueueFamilyIndices
 	// Location of Presentation queue family
 	int iPresentationFamily = -1;
 
-	bool isValid()
+	// Number of meaningful bits in timestamps written on the Graphics queue (0 = no timestamp support)
+	uint32_t graphicsTimestampValidBits = 0;
+
+	// Location of a Transfer queue family without Graphics (-1 if all transfer capable families do graphics too)
+	// Transfer only families (DMA engines) are preferred over Compute ones
+	int iTransferFamily = -1;
+	uint32_t transferQueueCount = 0;
+
+	// Location of a Compute queue family without Graphics, for async compute
+	int iComputeFamily = -1;
+	uint32_t computeQueueCount = 0;
+
+	// Headless rendering never presents, so it doesn't need a Presentation queue
+	bool isValid(bool bNeedPresentation = true)
 	{
-		return iGraphicsFamily >= 0 && iPresentationFamily >= 0;
+		return iGraphicsFamily >= 0 && (!bNeedPresentation || iPresentationFamily >= 0);
 	}
 };
 
+// How the swapchain trades latency for smoothness and power
+enum class PresentPolicy
+{
+	LowLatency,		// IMMEDIATE (else MAILBOX), minimum image count: newest frame shown as soon as possible, may tear
+	Throughput,		// MAILBOX (else FIFO), extra images: CPU and GPU never wait on the display
+	PowerSaving,	// FIFO, minimum image count: capped at refresh rate, no wasted frames
+	Count
+};
+
+static const char* GetPresentPolicyName(PresentPolicy policy)
+{
+	switch (policy)
+	{
+	case PresentPolicy::LowLatency:		return "LowLatency";
+	case PresentPolicy::Throughput:		return "Throughput";
+	case PresentPolicy::PowerSaving:	return "PowerSaving";
+	default:							return "Unknown";
+	}
+}
+
+struct RendererSettings
+{
+	// Number of frames the CPU may record ahead of the GPU
+	int				framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+
+	// Render into offscreen images instead of a window (no GLFW, surface, swapchain or presentation queue)
+	bool			bHeadless = false;
+
+	// Window size, or size of the offscreen images when headless
+	uint32_t		width = 1280;
+	uint32_t		height = 720;
+
+	// Present mode and swapchain image count, can be changed at runtime with SetPresentPolicy
+	PresentPolicy	presentPolicy = PresentPolicy::Throughput;
+
+	// Winding of front faces for every pipeline, meshes are cooked for it too (overdraw order, meshlet cones)
+	VkFrontFace		frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+	// Cull meshlets of meshes that have them before drawing (mesh shaders if supported and allowed, else compute + indirect draw)
+	bool			bClusterCulling = true;
+	bool			bMeshShaders = true;
+
+	// Render passes straight to attachment views with VK_KHR_dynamic_rendering if supported (else render pass + framebuffers)
+	bool			bDynamicRendering = true;
+
+	// Leave fixed function state the device can set when recording out of pipelines (extended dynamic state 1, 2 and 3)
+	bool			bExtendedDynamicState = true;
+
+	// Threads recording the scene draw list in to secondary command buffers (0 = one per hardware thread)
+	uint32_t		recordThreads = 0;
+
+	// Device memory streamed textures may use (0 = what VK_EXT_memory_budget leaves free, or a share of device memory)
+	uint64_t		textureStreamingBudget = 0;
+};
+
 struct SwapChainDetails
 {
 	// Surface properties (image size ex.)
@@ -36,34 +174,6 @@ struct SwapChainImage
 	VkImageView		imageView;
 };
 
-static std::vector<char> readFile(const std::string& filename)
-{
-	// Open stream from given file
-	// std::ios::binary tells stream to read file as binary
-	// std::ios::ate tells stream to start reading from end of file
-	std::ifstream file(filename, std::ios::binary | std::ios::ate);
-
-	// Check if file stream successfully opened
-	if (!file.is_open())
-	{
-		throw std::runtime_error("Failed to open a file!");
-	}
-
-	// Get current read position and use to resize file buffer
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> fileBuffer(fileSize);
-
-	// Move read position (seek to) the start of the file
-	file.seekg(0);
-
-	// Read the file data into the buffer (stream "fileSize" in total)
-	file.read(fileBuffer.data(), fileSize);
-
-	// Close stream
-	file.close();
-
-	return fileBuffer;
-}
 
 
 
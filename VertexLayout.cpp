@@ -0,0 +1,121 @@
+#include "VertexLayout.h"
+
+#include <cstring>
+#include <stdexcept>
+
+VertexLayout::VertexLayout(const std::vector<VertexAttribute>& attributes)
+	: attributes(attributes)
+{
+	for (const auto& attribute : attributes)
+	{
+		if (attribute.stream >= MAX_VERTEX_STREAMS)
+		{
+			throw std::runtime_error("Vertex attribute stream is out of range!");
+		}
+
+		// Streams are numbered from 0 without gaps
+		while (bindings.size() <= attribute.stream)
+		{
+			VkVertexInputBindingDescription bindingDescription = {};
+			bindingDescription.binding = static_cast<uint32_t>(bindings.size());	// Can bind multiple streams of data, this defines which one
+			bindingDescription.stride = 0;											// Size of a single vertex object in this stream
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;				// How to move between data after each vertex.
+																					// VK_VERTEX_INPUT_RATE_VERTEX		: Move on to the next vertex
+																					// VK_VERTEX_INPUT_RATE_INSTANCE	: Move to a vertex for the next instance
+			bindings.push_back(bindingDescription);
+		}
+
+		// Attributes are packed in the order they're given
+		VkVertexInputAttributeDescription attributeDescription = {};
+		attributeDescription.binding = attribute.stream;							// Which binding the data is at (should be same as above)
+		attributeDescription.location = attribute.location;							// Location in shader where data will be read from
+		attributeDescription.format = attribute.format;								// Format the data will take (also helps define size of data)
+		attributeDescription.offset = bindings[attribute.stream].stride;			// Where this attribute is defined in the data for a single vertex
+		attributeDescriptions.push_back(attributeDescription);
+
+		bindings[attribute.stream].stride += GetFormatSize(attribute.format);
+	}
+}
+
+VertexLayout VertexLayout::Interleaved(std::vector<VertexAttribute> attributes)
+{
+	for (auto& attribute : attributes)
+	{
+		attribute.stream = 0;
+	}
+	return VertexLayout(attributes);
+}
+
+VertexLayout VertexLayout::PositionSplit(std::vector<VertexAttribute> attributes)
+{
+	for (size_t i = 0; i < attributes.size(); ++i)
+	{
+		attributes[i].stream = i == 0 ? 0 : 1;
+	}
+	return VertexLayout(attributes);
+}
+
+VertexLayout VertexLayout::PositionOnly() const
+{
+	std::vector<VertexAttribute> streamAttributes;
+	for (const auto& attribute : attributes)
+	{
+		if (attribute.stream == 0)
+		{
+			streamAttributes.push_back(attribute);
+		}
+	}
+	return VertexLayout(streamAttributes);
+}
+
+uint32_t VertexLayout::GetVertexSize() const
+{
+	uint32_t size = 0;
+	for (const auto& binding : bindings)
+	{
+		size += binding.stride;
+	}
+	return size;
+}
+
+void VertexLayout::WriteStreams(const void* vertices, size_t vertexStride, size_t vertexCount, std::vector<std::vector<uint8_t>>& streams) const
+{
+	streams.resize(bindings.size());
+	for (size_t s = 0; s < bindings.size(); ++s)
+	{
+		streams[s].resize(bindings[s].stride * vertexCount);
+	}
+
+	const uint8_t* source = static_cast<const uint8_t*>(vertices);
+	for (size_t i = 0; i < attributes.size(); ++i)
+	{
+		const VkVertexInputAttributeDescription& description = attributeDescriptions[i];
+		uint32_t size = GetFormatSize(description.format);
+		uint32_t stride = bindings[description.binding].stride;
+		uint8_t* destination = streams[description.binding].data() + description.offset;
+
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			memcpy(destination + v * stride, source + v * vertexStride + attributes[i].sourceOffset, size);
+		}
+	}
+}
+
+uint32_t VertexLayout::GetFormatSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R32_SFLOAT:				return 4;
+	case VK_FORMAT_R32G32_SFLOAT:			return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT:		return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:		return 16;
+	case VK_FORMAT_R16G16_SFLOAT:			return 4;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:		return 8;
+	case VK_FORMAT_R8G8B8A8_UNORM:			return 4;
+	case VK_FORMAT_R8G8B8A8_SNORM:			return 4;
+	case VK_FORMAT_A2B10G10R10_SNORM_PACK32:	return 4;
+	case VK_FORMAT_R32_UINT:				return 4;
+	default:
+		throw std::runtime_error("Unsupported vertex attribute format!");
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+
+// Most vertex buffers a layout can be split across
+const uint32_t MAX_VERTEX_STREAMS = 4;
+
+// One shader input, read from "sourceOffset" bytes in to the application's vertex struct
+struct VertexAttribute
+{
+	uint32_t		location;
+	VkFormat		format;
+	uint32_t		sourceOffset;
+	uint32_t		stream = 0;			// Vertex buffer (binding) the attribute is fetched from
+};
+
+// Vertex layout
+// Places attributes in streams (one vertex buffer per stream, attributes tightly packed in each) and generates
+// the vertex input descriptions a pipeline needs, so buffers and pipelines can't disagree on strides or offsets.
+class VertexLayout
+{
+public:
+	VertexLayout() = default;
+	explicit VertexLayout(const std::vector<VertexAttribute>& attributes);
+
+	// Every attribute in one stream
+	static VertexLayout	Interleaved(std::vector<VertexAttribute> attributes);
+
+	// First attribute (position) alone in stream 0, the rest interleaved in stream 1
+	// Passes that only need position (depth, shadows) then fetch a third of the bytes
+	static VertexLayout	PositionSplit(std::vector<VertexAttribute> attributes);
+
+	// Only the attributes in stream 0, for position only passes over PositionSplit meshes
+	VertexLayout		PositionOnly() const;
+
+	uint32_t			GetStreamCount() const { return static_cast<uint32_t>(bindings.size()); }
+	uint32_t			GetStride(uint32_t stream) const { return bindings[stream].stride; }
+	uint32_t			GetVertexSize() const;
+
+	const std::vector<VertexAttribute>&						GetAttributes() const { return attributes; }
+	const std::vector<VkVertexInputBindingDescription>&		GetBindingDescriptions() const { return bindings; }
+	const std::vector<VkVertexInputAttributeDescription>&	GetAttributeDescriptions() const { return attributeDescriptions; }
+
+	// Convert application vertices in to one tightly packed buffer per stream
+	void				WriteStreams(const void* vertices, size_t vertexStride, size_t vertexCount, std::vector<std::vector<uint8_t>>& streams) const;
+
+	static uint32_t		GetFormatSize(VkFormat format);
+
+private:
+	std::vector<VertexAttribute>						attributes;
+	std::vector<VkVertexInputBindingDescription>		bindings;
+	std::vector<VkVertexInputAttributeDescription>		attributeDescriptions;
+};
@@ -1,18 +1,49 @@
 #include "VulkanRenderer.h"
 
-VulkanRenderer::VulkanRenderer()
+VulkanRenderer::VulkanRenderer(const RendererSettings& settings)
+	: settings(settings)
 {
-	window = new VulkanWindow("Test", 1280, 720);
+	// Headless rendering doesn't touch GLFW at all, so it runs on machines without a display
+	if (!settings.bHeadless)
+	{
+		window = new VulkanWindow("Test", settings.width, settings.height);
+	}
+
+	// Always at least one frame, otherwise there is nothing to record into
+	frames.resize(std::max(settings.framesInFlight, 1));
+
+	PROFILE_ZONE("VulkanRenderer::Init");
 
 	try 
 	{
 		CreateInstance();
-		CreateSurface();
+		if (!settings.bHeadless)
+		{
+			CreateSurface();
+		}
 		GetPhysicalDevice();
 		CreateLogicalDevice();
-		CreateSwapChain();
+		CreateAllocator();
+		if (settings.bHeadless)
+		{
+			CreateOffscreenTargets();
+		}
+		else
+		{
+			CreateSwapChain();
+		}
 		CreateRenderPass();
+		CreatePipelineCache();
 		CreateGraphicsPipeline();
+		CreateClusterRenderer();
+		CreateTextureLoader();
+		CreateCommandPool();
+		CreateCommandAllocator();
+		CreateCommandRecorder();
+		CreateSynchronisation();
+		CreateGpuProfiler();
+		CreateRenderGraph();
+		CreateSceneMesh();
 	}
 	catch (const std::runtime_error& e)
 	{
@@ -22,24 +53,764 @@ VulkanRenderer::VulkanRenderer()
 
 VulkanRenderer::~VulkanRenderer()
 {
+	// Wait until no frame is in flight before destroying anything it may use
+	WaitIdle();
+
+	DestroyRetiredSwapChains(true);
+
+	if (triangleMesh != nullptr)
+	{
+		DestroyMesh(triangleMesh);
+	}
+	DestroyRetiredMeshes(true);
+	delete clusterRenderer;
+
+	// Loader threads first, nothing refers to a texture after that
+	// Mip generation views go before the images they view
+	delete textureLoader;
+	delete mipGenerator;
+	DestroyRetiredTextures(true);
+	delete textureStreamer;
+
+	// Graph passes are timed by the profiler
+	delete renderGraph;
+	delete gpuProfiler;
+
+	for (auto &frame : frames)
+	{
+		vkDestroySemaphore(mainDevice.logicalDevice, frame.renderFinished, nullptr);
+		vkDestroySemaphore(mainDevice.logicalDevice, frame.imageAvailable, nullptr);
+		vkDestroyFence(mainDevice.logicalDevice, frame.drawFence, nullptr);
+	}
+
+	// Freeing the pool frees every command buffer allocated from it
+	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
+	delete commandRecorder;
+	delete commandAllocator;
+
 	for (auto &image : swapChainImages)
 	{
 		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
 	}
 
+	// Offscreen images are owned by the renderer (swapchain images are owned by the swapchain)
+	for (size_t i = 0; i < offscreenImageAllocations.size(); ++i)
+	{
+		vkDestroyImage(mainDevice.logicalDevice, swapChainImages[i].image, nullptr);
+		gpuAllocator->Free(offscreenImageAllocations[i]);
+	}
+
+	// Stops workers, merges their caches and destroys background compiled pipelines
+	delete pipelineCompiler;
+
 	vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
 	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
 
+	// Pipelines are gone, so are the last users of the shader modules
+	delete shaderModuleCache;
+
+	// Persist compiled pipelines so the next launch starts warm
+	if (pipelineCache != nullptr)
+	{
+		pipelineCache->Save();
+		delete pipelineCache;
+	}
+
 	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapChain, nullptr);
-	vkDestroyInstance(instance, nullptr);
+
+	// Every resource has given its memory back by now, this frees the blocks themselves
+	delete stagingRing;
+	delete gpuAllocator;
+
 	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
 	vkDestroySurfaceKHR(instance, surface, nullptr);
+	vkDestroyInstance(instance, nullptr);
 	delete window;
 }
 
+void VulkanRenderer::Draw()
+{
+	PROFILE_FUNCTION();
+
+	FrameData& frame = frames[currentFrame];
+
+	// -- GET NEXT IMAGE --
+	// Wait for the GPU to finish the last submission that used this frame's resources.
+	// With N frames in flight this only blocks when the CPU is N frames ahead of the GPU.
+	{
+		PROFILE_ZONE("WaitForFrameFence");
+		vkWaitForFences(mainDevice.logicalDevice, 1, &frame.drawFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+
+	// Every command buffer the slot recorded last time has executed, recycle them all at once
+	commandAllocator->ResetFrame(static_cast<uint32_t>(currentFrame));
+
+	// Frames are submitted to one queue and complete in order, so every frame up to the one
+	// that last used this slot is done
+	if (submittedFrames >= frames.size())
+	{
+		completedFrames = std::max<uint64_t>(completedFrames, submittedFrames - frames.size() + 1);
+	}
+	stagingRing->Reclaim(completedFrames);
+	mipGenerator->Reclaim(completedFrames);
+	textureStreamer->Reclaim(completedFrames);
+	renderGraph->Reclaim(completedFrames);
+	CompleteTextureUploads();
+	DestroyRetiredSwapChains(false);
+	DestroyRetiredMeshes(false);
+	DestroyRetiredTextures(false);
+
+	// Window was resized (or the surface changed) after the last present
+	if (bSwapChainOutOfDate)
+	{
+		RecreateSwapChain();
+
+		// Still out of date while minimised, nothing to draw to
+		if (bSwapChainOutOfDate)
+		{
+			return;
+		}
+	}
+
+	// Get index of next image to be drawn to, and signal semaphore when ready to be drawn to
+	// Headless: every frame in flight has its own offscreen image, nothing to acquire
+	uint32_t imageIndex = static_cast<uint32_t>(currentFrame);
+	auto acquireStart = std::chrono::high_resolution_clock::now();
+	if (!settings.bHeadless)
+	{
+		PROFILE_ZONE("AcquireNextImage");
+		VkResult result = vkAcquireNextImageKHR(mainDevice.logicalDevice, swapChain, std::numeric_limits<uint64_t>::max(), frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+
+		// Swapchain no longer matches the surface: nothing was acquired or signalled, so skip this frame
+		// (frame fence hasn't been reset, so next Draw doesn't wait on it)
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			RecreateSwapChain();
+			return;
+		}
+
+		// Suboptimal images can still be presented, recreate after this frame
+		if (result == VK_SUBOPTIMAL_KHR)
+		{
+			bSwapChainOutOfDate = true;
+		}
+		else if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to acquire a Swapchain Image!");
+		}
+	}
+
+	// Images can be returned out of order, so another frame may still be rendering to this image
+	if (imageFences[imageIndex] != VK_NULL_HANDLE)
+	{
+		PROFILE_ZONE("WaitForImageFence");
+		vkWaitForFences(mainDevice.logicalDevice, 1, &imageFences[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+	imageFences[imageIndex] = frame.drawFence;
+
+	// -- RECORD --
+	frame.commandBuffer = commandAllocator->Allocate(static_cast<uint32_t>(currentFrame), 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	RecordCommands(frame.commandBuffer, imageIndex);
+
+	// -- SUBMIT COMMAND BUFFER TO RENDER --
+	// Stages to wait at for the semaphores
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+
+	// Headless: no swapchain to wait for or present to, so no semaphores
+	uint32_t semaphoreCount = settings.bHeadless ? 0 : 1;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.waitSemaphoreCount = semaphoreCount;					// Number of semaphores to wait on
+	submitInfo.pWaitSemaphores = &frame.imageAvailable;				// List of semaphores to wait on
+	submitInfo.pWaitDstStageMask = waitStages;						// Stages to check semaphores at
+	submitInfo.commandBufferCount = 1;								// Number of command buffers to submit
+	submitInfo.pCommandBuffers = &frame.commandBuffer;				// Command buffer to submit
+	submitInfo.signalSemaphoreCount = semaphoreCount;				// Number of semaphores to signal
+	submitInfo.pSignalSemaphores = &frame.renderFinished;			// Semaphores to signal when command buffer finishes
+
+	// Submit command buffer to queue, fence is signalled once the GPU is done with this frame
+	{
+		PROFILE_ZONE("QueueSubmit");
+
+		// Only reset the fence once recording succeeded and work is about to be submitted that signals it again,
+		// otherwise a throw while recording leaves it unsignalled and the next wait on this frame never returns
+		vkResetFences(mainDevice.logicalDevice, 1, &frame.drawFence);
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.drawFence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit Command Buffer to Queue!");
+		}
+	}
+	++submittedFrames;
+
+	if (settings.bHeadless)
+	{
+		currentFrame = (currentFrame + 1) % static_cast<int>(frames.size());
+		return;
+	}
+
+	// -- PRESENT RENDERED IMAGE TO SCREEN --
+	VkPresentInfoKHR presentInfo = {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;								// Number of semaphores to wait on
+	presentInfo.pWaitSemaphores = &frame.renderFinished;			// Semaphores to wait on
+	presentInfo.swapchainCount = 1;									// Number of swapchains to present to
+	presentInfo.pSwapchains = &swapChain;							// Swapchains to present images to
+	presentInfo.pImageIndices = &imageIndex;						// Index of images in swapchains to present
+
+	{
+		PROFILE_ZONE("QueuePresent");
+		VkResult result = vkQueuePresentKHR(presentationQueue, &presentInfo);
+		bool bResized = window->ConsumeResize();
+
+		// Recreated at the start of the next frame, once its frame fence has been waited on
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || bResized)
+		{
+			bSwapChainOutOfDate = true;
+		}
+		else if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to present Image!");
+		}
+	}
+
+	// Attributed to the policy the frame was presented with
+	double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - acquireStart).count();
+	PresentLatencyStats& latency = presentLatency[static_cast<size_t>(swapChainPresentPolicy)];
+	latency.minMs = latency.frameCount == 0 ? latencyMs : std::min(latency.minMs, latencyMs);
+	latency.maxMs = std::max(latency.maxMs, latencyMs);
+	latency.totalMs += latencyMs;
+	++latency.frameCount;
+
+	// Move on to next frame
+	currentFrame = (currentFrame + 1) % static_cast<int>(frames.size());
+}
+
+void VulkanRenderer::SetPresentPolicy(PresentPolicy policy)
+{
+	if (policy == settings.presentPolicy)
+	{
+		return;
+	}
+
+	settings.presentPolicy = policy;
+
+	// Headless never presents, nothing to recreate
+	if (!settings.bHeadless)
+	{
+		bSwapChainOutOfDate = true;
+	}
+}
+
+Mesh* VulkanRenderer::CreateMesh(const VertexLayout& layout, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	PROFILE_FUNCTION();
+
+	// Pack the vertices in to one buffer per stream of the layout
+	std::vector<std::vector<uint8_t>> streams;
+	layout.WriteStreams(vertices.data(), sizeof(Vertex), vertices.size(), streams);
+
+	const void* streamData[MAX_VERTEX_STREAMS] = {};
+	for (size_t s = 0; s < streams.size(); ++s)
+	{
+		streamData[s] = streams[s].data();
+	}
+
+	return CreateMesh(layout, static_cast<uint32_t>(vertices.size()), streamData, indices.data(), static_cast<uint32_t>(indices.size()));
+}
+
+Mesh* VulkanRenderer::CreateMesh(const MeshCacheFile& cacheFile)
+{
+	PROFILE_FUNCTION();
+
+	// Streams are stored packed already, upload straight from the mapping
+	VertexLayout layout = cacheFile.GetVertexLayout();
+	const void* streamData[MAX_VERTEX_STREAMS] = {};
+	for (uint32_t s = 0; s < layout.GetStreamCount(); ++s)
+	{
+		const MeshCacheSection* section = cacheFile.FindSection(MeshCacheSectionType::VertexStream, s);
+		if (section == nullptr || section->size != static_cast<uint64_t>(layout.GetStride(s)) * cacheFile.GetHeader().vertexCount)
+		{
+			throw std::runtime_error("Mesh cache vertex stream is missing or the wrong size!");
+		}
+		streamData[s] = cacheFile.GetSectionData(*section);
+	}
+
+	const MeshCacheSection* indexSection = cacheFile.FindSection(MeshCacheSectionType::Indices);
+	if (indexSection == nullptr || indexSection->size != sizeof(uint32_t) * static_cast<uint64_t>(cacheFile.GetHeader().indexCount))
+	{
+		throw std::runtime_error("Mesh cache indices are missing or the wrong size!");
+	}
+
+	Mesh* mesh = CreateMesh(layout, cacheFile.GetHeader().vertexCount, streamData, cacheFile.GetSectionData(*indexSection), cacheFile.GetHeader().indexCount);
+
+	// Meshlets are optional, a cache without them is drawn without cluster culling
+	const MeshCacheSection* meshletSection = cacheFile.FindSection(MeshCacheSectionType::Meshlets);
+	const MeshCacheSection* meshletVertexSection = cacheFile.FindSection(MeshCacheSectionType::MeshletVertices);
+	const MeshCacheSection* meshletTriangleSection = cacheFile.FindSection(MeshCacheSectionType::MeshletTriangles);
+	if (meshletSection != nullptr && meshletVertexSection != nullptr && meshletTriangleSection != nullptr
+		&& meshletSection->stride == sizeof(Meshlet) && meshletSection->size % sizeof(Meshlet) == 0)
+	{
+		CreateMeshlets(mesh, static_cast<uint32_t>(meshletSection->size / sizeof(Meshlet)), cacheFile.GetSectionData(*meshletSection),
+			cacheFile.GetSectionData(*meshletVertexSection), meshletVertexSection->size,
+			cacheFile.GetSectionData(*meshletTriangleSection), meshletTriangleSection->size);
+	}
+
+	return mesh;
+}
+
+Mesh* VulkanRenderer::CreateMesh(const VertexLayout& layout, const MeshData& meshData)
+{
+	Mesh* mesh = CreateMesh(layout, meshData.vertices, meshData.indices);
+	if (!meshData.meshlets.empty())
+	{
+		CreateMeshlets(mesh, static_cast<uint32_t>(meshData.meshlets.size()), meshData.meshlets.data(),
+			meshData.meshletVertices.data(), meshData.meshletVertices.size() * sizeof(uint32_t),
+			meshData.meshletTriangles.data(), meshData.meshletTriangles.size());
+	}
+	return mesh;
+}
+
+Mesh* VulkanRenderer::CreateMesh(const VertexLayout& layout, uint32_t vertexCount, const void* const* streamData, const void* indices, uint32_t indexCount)
+{
+	Mesh* mesh = new Mesh();
+	mesh->layout = layout;
+	mesh->vertexCount = vertexCount;
+	mesh->indexCount = indexCount;
+
+	// One device local buffer per stream of the layout
+	mesh->vertexBuffers.resize(layout.GetStreamCount());
+	mesh->vertexAllocations.resize(layout.GetStreamCount());
+	for (uint32_t s = 0; s < layout.GetStreamCount(); ++s)
+	{
+		VkDeviceSize streamSize = static_cast<VkDeviceSize>(layout.GetStride(s)) * vertexCount;
+		// Also read as a storage buffer by the mesh shader path
+		mesh->vertexBuffers[s] = gpuAllocator->CreateBuffer(streamSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			| VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuOnly, &mesh->vertexAllocations[s]);
+		UploadBuffer(mesh->vertexBuffers[s], 0, streamData[s], streamSize);
+	}
+
+	VkDeviceSize indexSize = sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCount);
+	mesh->indexBuffer = gpuAllocator->CreateBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		MemoryUsage::GpuOnly, &mesh->indexAllocation);
+	UploadBuffer(mesh->indexBuffer, 0, indices, indexSize);
+
+	return mesh;
+}
+
+void VulkanRenderer::CreateMeshlets(Mesh* mesh, uint32_t meshletCount, const void* meshlets, const void* meshletVertices, VkDeviceSize meshletVertexSize,
+	const void* meshletTriangles, VkDeviceSize meshletTriangleSize)
+{
+	if (meshletCount == 0 || meshletVertexSize == 0 || meshletTriangleSize == 0)
+	{
+		return;
+	}
+
+	const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VkDeviceSize meshletSize = sizeof(Meshlet) * static_cast<VkDeviceSize>(meshletCount);
+
+	mesh->meshletCount = meshletCount;
+	mesh->meshletBuffer = gpuAllocator->CreateBuffer(meshletSize, usage, MemoryUsage::GpuOnly, &mesh->meshletAllocation);
+	UploadBuffer(mesh->meshletBuffer, 0, meshlets, meshletSize);
+	mesh->meshletVertexBuffer = gpuAllocator->CreateBuffer(meshletVertexSize, usage, MemoryUsage::GpuOnly, &mesh->meshletVertexAllocation);
+	UploadBuffer(mesh->meshletVertexBuffer, 0, meshletVertices, meshletVertexSize);
+	mesh->meshletTriangleBuffer = gpuAllocator->CreateBuffer(meshletTriangleSize, usage, MemoryUsage::GpuOnly, &mesh->meshletTriangleAllocation);
+	UploadBuffer(mesh->meshletTriangleBuffer, 0, meshletTriangles, meshletTriangleSize);
+
+	if (clusterRenderer != nullptr)
+	{
+		clusterRenderer->CreateMeshResources(*mesh, gpuAllocator);
+	}
+}
+
+void VulkanRenderer::DestroyMesh(Mesh* mesh)
+{
+	if (sceneMesh == mesh)
+	{
+		sceneMesh = triangleMesh != mesh ? triangleMesh : nullptr;
+	}
+	if (triangleMesh == mesh)
+	{
+		triangleMesh = nullptr;
+	}
+
+	RetiredMesh retired;
+	retired.mesh = mesh;
+	retired.lastFrame = submittedFrames;
+	retiredMeshes.push_back(retired);
+}
+
+void VulkanRenderer::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+	// Chunks of at most half the ring, so every chunk fits once the ring has been flushed
+	const VkDeviceSize chunkSize = StagingRing::DEFAULT_CAPACITY / 2;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	for (VkDeviceSize uploaded = 0; uploaded < size;)
+	{
+		VkDeviceSize chunk = std::min(chunkSize, size - uploaded);
+		if (!stagingRing->UploadToBuffer(buffer, offset + uploaded, bytes + uploaded, chunk))
+		{
+			// Ring is full of uploads not yet copied, or still being copied
+			FlushUploads();
+			continue;
+		}
+		uploaded += chunk;
+	}
+}
+
+void VulkanRenderer::FlushUploads()
+{
+	PROFILE_FUNCTION();
+
+	// Tagged with frames already submitted: once the queue is idle, those and this batch are complete
+	VkCommandBuffer commandBuffer = BeginOneTimeCommands();
+	RecordUploads(commandBuffer, submittedFrames);
+	EndOneTimeCommands(commandBuffer);
+
+	completedFrames = submittedFrames;
+	stagingRing->Reclaim(completedFrames);
+	mipGenerator->Reclaim(completedFrames);
+	textureStreamer->Reclaim(completedFrames);
+	CompleteTextureUploads();
+}
+
+Texture* VulkanRenderer::LoadTexture(const std::string& fileName, bool bSRGB)
+{
+	return LoadTextureArray({ fileName }, bSRGB);
+}
+
+Texture* VulkanRenderer::LoadTextureArray(const std::vector<std::string>& fileNames, bool bSRGB)
+{
+	Texture* texture = new Texture();
+	texture->name = fileNames.empty() ? std::string() : fileNames[0];
+	texture->bSRGB = bSRGB;
+	texture->requestTime = std::chrono::high_resolution_clock::now();
+
+	textureLoader->Load(texture, fileNames);
+	++decodingTextureCount;
+
+	return texture;
+}
+
+Texture* VulkanRenderer::LoadStreamedTexture(const std::string& fileName, bool bSRGB)
+{
+	Texture* texture = new Texture();
+	texture->name = fileName;
+	texture->bSRGB = bSRGB;
+	texture->bStreamed = true;
+	texture->requestTime = std::chrono::high_resolution_clock::now();
+
+	// Every mip is kept in system memory, the streamer uploads them as they're needed
+	textureLoader->Load(texture, { fileName }, true);
+	++decodingTextureCount;
+
+	return texture;
+}
+
+void VulkanRenderer::DestroyTexture(Texture* texture)
+{
+	RetiredTexture retired;
+	retired.texture = texture;
+	retired.lastFrame = submittedFrames;
+	retiredTextures.push_back(retired);
+}
+
+void VulkanRenderer::FinishTextureLoads()
+{
+	PROFILE_FUNCTION();
+
+	while (decodingTextureCount > 0 || !pendingTextureUploads.empty() || !pendingMipTextures.empty() || !generatingTextures.empty()
+		|| textureStreamer->IsLoading())
+	{
+		// Nothing to upload until something has been decoded
+		if (pendingTextureUploads.empty() && pendingMipTextures.empty() && generatingTextures.empty() && !textureStreamer->IsLoading())
+		{
+			textureLoader->WaitIdle();
+		}
+		FlushUploads();
+	}
+}
+
+void VulkanRenderer::CreateTextureImage(Texture* texture, const ImageData& image)
+{
+	// Full chain down to 1x1, unless the device can't generate mips for the format
+	texture->format = texture->bSRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	texture->width = image.width;
+	texture->height = image.height;
+	texture->layerCount = image.layerCount;
+	MipGenerator::Method mipMethod = mipGenerator->GetMethod(texture->format);
+	texture->bComputeMips = mipMethod == MipGenerator::Method::Compute;
+	texture->mipLevels = 1;
+	if (mipMethod != MipGenerator::Method::None)
+	{
+		for (uint32_t size = std::max(image.width, image.height); size > 1; size /= 2)
+		{
+			++texture->mipLevels;
+		}
+	}
+
+	texture->image = CreateImage(texture->width, texture->height, texture->format, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_SAMPLED_BIT | mipGenerator->GetImageUsage(texture->format), MemoryUsage::GpuOnly, &texture->allocation,
+		texture->mipLevels, texture->layerCount, mipGenerator->GetImageFlags(texture->format));
+	texture->imageView = CreateImageView(texture->image, texture->format, VK_IMAGE_ASPECT_COLOR_BIT, texture->mipLevels, texture->layerCount);
+}
+
+void VulkanRenderer::RecordUploads(VkCommandBuffer commandBuffer, uint64_t serial)
+{
+	PROFILE_FUNCTION();
+
+	// Decoded textures get their image, then wait for staging space (streamed ones are handed to the streamer)
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+
+	std::vector<TextureLoader::Result> results;
+	textureLoader->CollectResults(results);
+	for (auto& result : results)
+	{
+		--decodingTextureCount;
+
+		Texture* texture = result.texture;
+		texture->decodeMs = result.decodeMs;
+		try
+		{
+			if (!result.error.empty())
+			{
+				throw std::runtime_error(result.error);
+			}
+			if (result.image.width > deviceProperties.limits.maxImageDimension2D || result.image.height > deviceProperties.limits.maxImageDimension2D
+				|| result.image.layerCount > deviceProperties.limits.maxImageArrayLayers)
+			{
+				throw std::runtime_error("Texture is larger than the device supports!");
+			}
+			if (!texture->bStreamed)
+			{
+				CreateTextureImage(texture, result.image);
+			}
+		}
+		catch (const std::runtime_error& e)
+		{
+			std::cout << "Failed to load texture '" << texture->name << "': " << e.what() << std::endl;
+			texture->state = TextureState::Failed;
+			continue;
+		}
+
+		if (texture->bStreamed)
+		{
+			textureStreamer->Add(texture, std::move(result.image), std::move(result.mips));
+			continue;
+		}
+
+		texture->state = TextureState::Uploading;
+		PendingTexture pending;
+		pending.texture = texture;
+		pending.image = std::move(result.image);
+		pendingTextureUploads.push_back(std::move(pending));
+	}
+
+	// Level 0 of pending textures in row bands, in request order, until the ring is full
+	// Bands of at most a quarter of the ring, so a large texture never blocks the ring for everything else
+	bool bRingFull = false;
+	while (!pendingTextureUploads.empty() && !bRingFull)
+	{
+		PendingTexture& pending = pendingTextureUploads.front();
+		Texture* texture = pending.texture;
+
+		// Copies need every level in TRANSFER_DST (barrier is recorded before the ring's copies)
+		if (pending.layer == 0 && pending.row == 0)
+		{
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = texture->image;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mipLevels, 0, texture->layerCount };
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		VkDeviceSize rowSize = static_cast<VkDeviceSize>(texture->width) * 4;
+		uint32_t bandRows = static_cast<uint32_t>(std::max<VkDeviceSize>(1, StagingRing::DEFAULT_CAPACITY / 4 / rowSize));
+		while (pending.layer < texture->layerCount)
+		{
+			uint32_t rows = std::min(bandRows, texture->height - pending.row);
+
+			VkBufferImageCopy region = {};
+			region.bufferRowLength = 0;											// Tightly packed
+			region.bufferImageHeight = 0;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pending.layer, 1 };
+			region.imageOffset = { 0, static_cast<int32_t>(pending.row), 0 };
+			region.imageExtent = { texture->width, rows, 1 };
+
+			const uint8_t* data = pending.image.pixels.data() + (static_cast<size_t>(pending.layer) * texture->height + pending.row) * rowSize;
+			if (!stagingRing->UploadToImage(texture->image, region, data, rows * rowSize))
+			{
+				bRingFull = true;
+				break;
+			}
+
+			pending.row += rows;
+			if (pending.row == texture->height)
+			{
+				pending.row = 0;
+				++pending.layer;
+			}
+		}
+
+		if (pending.layer == texture->layerCount)
+		{
+			pendingMipTextures.push_back(texture);
+			pendingTextureUploads.pop_front();
+		}
+	}
+
+	// Streaming changes take what space is left
+	textureStreamer->RecordUpdates(commandBuffer);
+
+	stagingRing->RecordCopies(commandBuffer, serial);
+
+	// Streamed textures whose mip tail is in are done once this frame completes, they need no mip generation
+	std::vector<Texture*> streamedTextures;
+	textureStreamer->RecordCompletions(commandBuffer, serial, streamedTextures);
+	for (Texture* texture : streamedTextures)
+	{
+		texture->uploadSerial = serial;
+		generatingTextures.push_back(texture);
+	}
+
+	// Ring's barrier after the copies makes level 0 visible to the blits
+	for (size_t i = 0; i < pendingMipTextures.size();)
+	{
+		Texture* texture = pendingMipTextures[i];
+		if (!mipGenerator->Record(commandBuffer, *texture, serial))
+		{
+			++i;
+			continue;
+		}
+
+		texture->uploadSerial = serial;
+		generatingTextures.push_back(texture);
+		pendingMipTextures.erase(pendingMipTextures.begin() + i);
+	}
+}
+
+void VulkanRenderer::CompleteTextureUploads()
+{
+	for (size_t i = 0; i < generatingTextures.size();)
+	{
+		Texture* texture = generatingTextures[i];
+		if (completedFrames < texture->uploadSerial)
+		{
+			++i;
+			continue;
+		}
+
+		texture->state = TextureState::Ready;
+		texture->loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - texture->requestTime).count();
+		std::cout << "Texture '" << texture->name << "' " << texture->width << "x" << texture->height << "x" << texture->layerCount
+			<< ", " << texture->mipLevels << " mips (" << (texture->bStreamed ? "streamed" : texture->mipLevels == 1 ? "none" : texture->bComputeMips ? "compute" : "blit")
+			<< "), " << texture->allocation.size / 1024 << " KB VRAM, decoded in " << texture->decodeMs << " ms, ready in " << texture->loadMs << " ms\n";
+
+		generatingTextures.erase(generatingTextures.begin() + i);
+	}
+}
+
+void VulkanRenderer::DestroyRetiredTextures(bool bForce)
+{
+	for (size_t i = 0; i < retiredTextures.size();)
+	{
+		// Textures still being loaded finish first, nothing else keeps track of them
+		Texture* texture = retiredTextures[i].texture;
+		bool bSettled = texture->state == TextureState::Ready || texture->state == TextureState::Failed;
+		if (!bForce && (!bSettled || completedFrames < retiredTextures[i].lastFrame))
+		{
+			++i;
+			continue;
+		}
+
+		// Streamer may have swapped its image since, it destroys them once the last frame submitted is done
+		if (texture->bStreamed)
+		{
+			textureStreamer->Remove(texture, submittedFrames);
+		}
+		if (texture->image != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(mainDevice.logicalDevice, texture->imageView, nullptr);
+			vkDestroyImage(mainDevice.logicalDevice, texture->image, nullptr);
+			gpuAllocator->Free(texture->allocation);
+		}
+		delete texture;
+
+		retiredTextures.erase(retiredTextures.begin() + i);
+	}
+}
+
+std::vector<VertexAttribute> VulkanRenderer::GetVertexAttributes()
+{
+	return {
+		{ 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) },		// Position Attribute
+		{ 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, col) },		// Colour Attribute
+	};
+}
+
+void VulkanRenderer::WaitIdle()
+{
+	if (mainDevice.logicalDevice != VK_NULL_HANDLE)
+	{
+		vkDeviceWaitIdle(mainDevice.logicalDevice);
+	}
+}
+
+void VulkanRenderer::ReadbackLastFrame(std::vector<uint8_t>& pixels)
+{
+	PROFILE_FUNCTION();
+
+	if (!settings.bHeadless)
+	{
+		throw std::runtime_error("Readback is only supported in headless mode!");
+	}
+
+	// Frame drawn last, make sure the GPU has finished it
+	int lastFrame = (currentFrame + static_cast<int>(frames.size()) - 1) % static_cast<int>(frames.size());
+	vkWaitForFences(mainDevice.logicalDevice, 1, &frames[lastFrame].drawFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+
+	// Host visible buffer to copy image in to (persistently mapped by the allocator)
+	MemoryAllocation readbackAllocation;
+	VkBuffer readbackBuffer = gpuAllocator->CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuToCpu, &readbackAllocation);
+
+	// Render graph left the image in TRANSFER_SRC layout
+	VkBufferImageCopy imageRegion = {};
+	imageRegion.bufferOffset = 0;											// Offset into data
+	imageRegion.bufferRowLength = 0;										// 0 = tightly packed rows
+	imageRegion.bufferImageHeight = 0;										// 0 = tightly packed image
+	imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;	// Which aspect of image to copy
+	imageRegion.imageSubresource.mipLevel = 0;								// Mipmap level to copy
+	imageRegion.imageSubresource.baseArrayLayer = 0;						// Starting array layer (if array)
+	imageRegion.imageSubresource.layerCount = 1;							// Number of layers to copy starting at baseArrayLayer
+	imageRegion.imageOffset = { 0, 0, 0 };									// Offset into image (as opposed to raw data in bufferOffset)
+	imageRegion.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+	VkCommandBuffer commandBuffer = BeginOneTimeCommands();
+	vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[lastFrame].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &imageRegion);
+	EndOneTimeCommands(commandBuffer);
+
+	// Copy mapped data out to host memory
+	pixels.resize(static_cast<size_t>(imageSize));
+	memcpy(pixels.data(), readbackAllocation.pMapped, static_cast<size_t>(imageSize));
+
+	gpuAllocator->DestroyBuffer(readbackBuffer, readbackAllocation);
+}
+
 void VulkanRenderer::GetPhysicalDevice()
 {
+	PROFILE_FUNCTION();
+
 	// Enumerate Physical devices the vkInstance can access
 	uint32_t deviceCount = 0;
 	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -63,10 +834,17 @@ void VulkanRenderer::GetPhysicalDevice()
 			break;
 		}
 	}
+
+	if (mainDevice.physicalDevice == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("Cant find a GPU that supports the required features!");
+	}
 }
 
 void VulkanRenderer::CreateInstance()
 {
+	PROFILE_FUNCTION();
+
 	// Info about the app itself
 	// Most data here does not affect program
 	VkApplicationInfo appInfo = {};
@@ -87,18 +865,21 @@ void VulkanRenderer::CreateInstance()
 	std::vector<const char*> instanceExtensions = std::vector<const char*>();
 
 	// Setup extensions Instance will use
-	// GLFW may require multiple extension
-	uint32_t glfwExtensionCount = 0;
+	// GLFW may require multiple extension (headless rendering needs none)
+	if (!settings.bHeadless)
+	{
+		uint32_t glfwExtensionCount = 0;
 
-	const char** glfwExtensions;
+		const char** glfwExtensions;
 
-	// Get GLFW extensions
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		// Get GLFW extensions
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	// Add GLFW extensions to list of extensions
-	for (size_t i = 0; i < glfwExtensionCount; ++i)
-	{
-		instanceExtensions.push_back(glfwExtensions[i]);
+		// Add GLFW extensions to list of extensions
+		for (size_t i = 0; i < glfwExtensionCount; ++i)
+		{
+			instanceExtensions.push_back(glfwExtensions[i]);
+		}
 	}
 
 	if (!CheckInstanceExtensionSupport(&instanceExtensions))
@@ -123,23 +904,64 @@ void VulkanRenderer::CreateInstance()
 
 void VulkanRenderer::CreateLogicalDevice()
 {
+	PROFILE_FUNCTION();
+
 	// Get queue family indices for the chosen Physical device
 	QueueFamilyIndices indices = GetQueueFamilies(mainDevice.physicalDevice);
 	
-	// Vector for queue creation info, and set for family indices
-	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> queueFamilyIndices = { indices.iGraphicsFamily, indices.iPresentationFamily };
+	// Priorities of the queues to create in each family (1 is highest)
+	// Graphics is what the frame waits on, async compute comes next, streaming transfers run in the background
+	std::map<int, std::vector<float>> queuePriorities;
+	queuePriorities[indices.iGraphicsFamily] = { 1.0f };
+	if (!settings.bHeadless && queuePriorities.count(indices.iPresentationFamily) == 0)
+	{
+		queuePriorities[indices.iPresentationFamily] = { 1.0f };
+	}
+	// Compute queues follow the presentation queue when both come from the same family
+	uint32_t computeQueueBase = 0;
+	if (indices.iComputeFamily >= 0)
+	{
+		std::vector<float>& priorities = queuePriorities[indices.iComputeFamily];
+		computeQueueBase = static_cast<uint32_t>(priorities.size());
+		for (uint32_t q = 0; q < std::min(indices.computeQueueCount, MAX_COMPUTE_QUEUES); ++q)
+		{
+			priorities.push_back(q == 0 ? 0.75f : 0.5f);
+		}
+	}
+	if (indices.iTransferFamily >= 0)
+	{
+		// May be the compute family on devices without a transfer only one, queues are then shared
+		std::vector<float>& priorities = queuePriorities[indices.iTransferFamily];
+		for (uint32_t q = static_cast<uint32_t>(priorities.size()); q < std::min(indices.transferQueueCount, MAX_TRANSFER_QUEUES); ++q)
+		{
+			priorities.push_back(0.25f);
+		}
+	}
+
+	// A family shared by several roles can't give out more queues than it has
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, queueFamilyList.data());
+	for (auto& familyPriorities : queuePriorities)
+	{
+		uint32_t familyQueueCount = queueFamilyList[familyPriorities.first].queueCount;
+		if (familyPriorities.second.size() > familyQueueCount)
+		{
+			familyPriorities.second.resize(familyQueueCount);
+		}
+	}
 
 	// Queue the logical device need to create and info to do so 
-	for (int q : queueFamilyIndices)
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+	for (const auto& familyPriorities : queuePriorities)
 	{
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo.queueFamilyIndex = q;
-		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.queueFamilyIndex = familyPriorities.first;
+		queueCreateInfo.queueCount = static_cast<uint32_t>(familyPriorities.second.size());
 		// Vulkan needs to know how to handle multiple queues, so decide priority (1 is highest)
-		float priority = 1.0f;
-		queueCreateInfo.pQueuePriorities = &priority;
+		queueCreateInfo.pQueuePriorities = familyPriorities.second.data();
 
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
@@ -151,14 +973,183 @@ void VulkanRenderer::CreateLogicalDevice()
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	// List of queue create info so device can create required
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
+	// Logical device extensions to enable (optional ones are added below)
+	std::vector<const char*> requiredExtensions = GetRequiredDeviceExtensions();
+
+	// Optional extensions and features, every path using one has a fallback when it is missing
+	DeviceSupport support;
+	CheckDeviceExtensionSupport(mainDevice.physicalDevice, &support);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+	bool bVulkan12 = deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+
+	VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+	supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures = {};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supportedFeatures12;
+#ifdef VK_EXT_mesh_shader
+	VkPhysicalDeviceMeshShaderFeaturesEXT supportedMeshShaderFeatures = {};
+	supportedMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	if (support.bMeshShader)
+	{
+		supportedFeatures12.pNext = &supportedMeshShaderFeatures;
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supportedDynamicStateFeatures = {};
+	supportedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+	if (support.bExtendedDynamicState)
+	{
+		supportedDynamicStateFeatures.pNext = supportedFeatures12.pNext;
+		supportedFeatures12.pNext = &supportedDynamicStateFeatures;
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+	VkPhysicalDeviceExtendedDynamicState2FeaturesEXT supportedDynamicState2Features = {};
+	supportedDynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+	if (support.bExtendedDynamicState2)
+	{
+		supportedDynamicState2Features.pNext = supportedFeatures12.pNext;
+		supportedFeatures12.pNext = &supportedDynamicState2Features;
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supportedDynamicState3Features = {};
+	supportedDynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+	if (support.bExtendedDynamicState3)
+	{
+		supportedDynamicState3Features.pNext = supportedFeatures12.pNext;
+		supportedFeatures12.pNext = &supportedDynamicState3Features;
+	}
+#endif
+#ifdef VK_KHR_dynamic_rendering
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR supportedDynamicRenderingFeatures = {};
+	supportedDynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	if (support.bDynamicRendering)
+	{
+		supportedDynamicRenderingFeatures.pNext = supportedFeatures12.pNext;
+		supportedFeatures12.pNext = &supportedDynamicRenderingFeatures;
+	}
+#endif
+	if (bVulkan12)
+	{
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &supportedFeatures);
+	}
+	else
+	{
+		vkGetPhysicalDeviceFeatures(mainDevice.physicalDevice, &supportedFeatures.features);
+	}
+
+	// Physical device features the logical device will be using
+	VkPhysicalDeviceFeatures2 deviceFeatures = {};
+	deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	VkPhysicalDeviceVulkan12Features deviceFeatures12 = {};
+	deviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	// Cluster culling: one indirect call for every meshlet draw, with the count written by the GPU
+	support.bMultiDrawIndirect = supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+	deviceFeatures.features.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+	support.bDrawIndirectCount = bVulkan12 && supportedFeatures12.drawIndirectCount == VK_TRUE;
+	deviceFeatures12.drawIndirectCount = support.bDrawIndirectCount ? VK_TRUE : VK_FALSE;
+
+	if (bVulkan12)
+	{
+		deviceFeatures.pNext = &deviceFeatures12;
+	}
+
+#ifdef VK_EXT_mesh_shader
+	// Mesh shaders are SPIR-V 1.4, which is core from Vulkan 1.2
+	VkPhysicalDeviceMeshShaderFeaturesEXT deviceMeshShaderFeatures = {};
+	deviceMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	support.bMeshShader = support.bMeshShader && bVulkan12
+		&& supportedMeshShaderFeatures.taskShader == VK_TRUE && supportedMeshShaderFeatures.meshShader == VK_TRUE;
+	if (support.bMeshShader)
+	{
+		deviceMeshShaderFeatures.taskShader = VK_TRUE;
+		deviceMeshShaderFeatures.meshShader = VK_TRUE;
+		deviceFeatures12.pNext = &deviceMeshShaderFeatures;
+		requiredExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+	}
+#else
+	support.bMeshShader = false;
+#endif
+
+#ifdef VK_KHR_dynamic_rendering
+	// Render graph passes begin rendering on their attachment views, no render pass or framebuffer objects
+	// (its dependencies, create_renderpass2 and depth_stencil_resolve, are core from Vulkan 1.2)
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR deviceDynamicRenderingFeatures = {};
+	deviceDynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	support.bDynamicRendering = support.bDynamicRendering && bVulkan12 && supportedDynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+	if (support.bDynamicRendering)
+	{
+		deviceDynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+		deviceDynamicRenderingFeatures.pNext = deviceFeatures12.pNext;
+		deviceFeatures12.pNext = &deviceDynamicRenderingFeatures;
+		requiredExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+	}
+#else
+	support.bDynamicRendering = false;
+#endif
+
+	// Extended dynamic state: pipelines only differ in what can't be set when recording
+#ifdef VK_EXT_extended_dynamic_state
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT deviceDynamicStateFeatures = {};
+	deviceDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+	support.bExtendedDynamicState = support.bExtendedDynamicState && bVulkan12 && supportedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+	if (support.bExtendedDynamicState)
+	{
+		deviceDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+		deviceDynamicStateFeatures.pNext = deviceFeatures12.pNext;
+		deviceFeatures12.pNext = &deviceDynamicStateFeatures;
+		requiredExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+	}
+#else
+	support.bExtendedDynamicState = false;
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+	VkPhysicalDeviceExtendedDynamicState2FeaturesEXT deviceDynamicState2Features = {};
+	deviceDynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+	support.bExtendedDynamicState2 = support.bExtendedDynamicState2 && bVulkan12 && supportedDynamicState2Features.extendedDynamicState2 == VK_TRUE;
+	if (support.bExtendedDynamicState2)
+	{
+		deviceDynamicState2Features.extendedDynamicState2 = VK_TRUE;
+		deviceDynamicState2Features.pNext = deviceFeatures12.pNext;
+		deviceFeatures12.pNext = &deviceDynamicState2Features;
+		requiredExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+	}
+#else
+	support.bExtendedDynamicState2 = false;
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT deviceDynamicState3Features = {};
+	deviceDynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+	support.bExtendedDynamicState3 = support.bExtendedDynamicState3 && bVulkan12 && supportedDynamicState3Features.extendedDynamicState3ColorBlendEnable == VK_TRUE;
+	if (support.bExtendedDynamicState3)
+	{
+		deviceDynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+		deviceDynamicState3Features.pNext = deviceFeatures12.pNext;
+		deviceFeatures12.pNext = &deviceDynamicState3Features;
+		requiredExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+	}
+#else
+	support.bExtendedDynamicState3 = false;
+#endif
+
+	// Texture streaming budget follows what the OS gives the process
+	if (support.bMemoryBudget)
+	{
+		requiredExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
 	// Number of enabled logical device extensions
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
 	// List of enabled logical device extensions
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
-	
-	// Physical device features the logical device will be using
-	VkPhysicalDeviceFeatures deviceFeatures = {};
-	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+	deviceCreateInfo.ppEnabledExtensionNames = requiredExtensions.data();
+	// Features go through the pNext chain, so pEnabledFeatures must stay null
+	deviceCreateInfo.pNext = &deviceFeatures;
+	deviceCreateInfo.pEnabledFeatures = nullptr;
 
 	// Create the logical device for the given physical device
 	if (vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice) != VK_SUCCESS)
@@ -169,13 +1160,99 @@ void VulkanRenderer::CreateLogicalDevice()
 	// Queues are created at the same time as the device
 	// So we want to handle queue.
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.iGraphicsFamily, 0, &graphicsQueue);
-	vkGetDeviceQueue(mainDevice.logicalDevice, indices.iPresentationFamily, 0, &presentationQueue);
+	if (!settings.bHeadless)
+	{
+		vkGetDeviceQueue(mainDevice.logicalDevice, indices.iPresentationFamily, 0, &presentationQueue);
+	}
+
+	// Dedicated queues, each with its own index in its family
+	if (indices.iComputeFamily >= 0)
+	{
+		// If clamping left no queue past the presentation one, compute shares the family's last queue
+		uint32_t familyQueueCount = static_cast<uint32_t>(queuePriorities[indices.iComputeFamily].size());
+		computeQueueBase = std::min(computeQueueBase, familyQueueCount - 1);
+		computeQueues.resize(std::min(familyQueueCount - computeQueueBase, std::min(indices.computeQueueCount, MAX_COMPUTE_QUEUES)));
+		for (uint32_t q = 0; q < computeQueues.size(); ++q)
+		{
+			vkGetDeviceQueue(mainDevice.logicalDevice, indices.iComputeFamily, computeQueueBase + q, &computeQueues[q]);
+		}
+	}
+	if (indices.iTransferFamily >= 0)
+	{
+		transferQueues.resize(queuePriorities[indices.iTransferFamily].size());
+		for (uint32_t q = 0; q < transferQueues.size(); ++q)
+		{
+			vkGetDeviceQueue(mainDevice.logicalDevice, indices.iTransferFamily, q, &transferQueues[q]);
+		}
+	}
+
+	queueFamilies = indices;
+	std::cout << "Queues: graphics family " << indices.iGraphicsFamily << ", " << computeQueues.size() << " async compute (family "
+		<< indices.iComputeFamily << "), " << transferQueues.size() << " transfer (family " << indices.iTransferFamily << ")" << std::endl;
 
+	deviceSupport = support;
+	std::cout << "Device support: mesh shaders " << (support.bMeshShader ? "yes" : "no") << ", multi draw indirect "
+		<< (support.bMultiDrawIndirect ? "yes" : "no") << ", draw indirect count " << (support.bDrawIndirectCount ? "yes" : "no")
+		<< ", memory budget " << (support.bMemoryBudget ? "yes" : "no") << ", dynamic rendering " << (support.bDynamicRendering ? "yes" : "no")
+		<< ", extended dynamic state 1/2/3 " << (support.bExtendedDynamicState ? "yes" : "no") << "/" << (support.bExtendedDynamicState2 ? "yes" : "no")
+		<< "/" << (support.bExtendedDynamicState3 ? "yes" : "no") << std::endl;
+
+	LoadDynamicStateFunctions();
 
 }
 
+void VulkanRenderer::LoadDynamicStateFunctions()
+{
+	// Extension commands, only called for pipelines built with the matching GraphicsPipelineDesc flag
+#ifdef VK_EXT_extended_dynamic_state
+	if (deviceSupport.bExtendedDynamicState)
+	{
+		VkDevice device = mainDevice.logicalDevice;
+		pfnCmdSetCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT"));
+		pfnCmdSetFrontFace = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT"));
+		pfnCmdSetPrimitiveTopology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT"));
+		pfnCmdSetDepthTestEnable = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT"));
+		pfnCmdSetDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT"));
+		pfnCmdSetDepthCompareOp = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT"));
+		deviceSupport.bExtendedDynamicState = pfnCmdSetCullMode != nullptr && pfnCmdSetFrontFace != nullptr && pfnCmdSetPrimitiveTopology != nullptr
+			&& pfnCmdSetDepthTestEnable != nullptr && pfnCmdSetDepthWriteEnable != nullptr && pfnCmdSetDepthCompareOp != nullptr;
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+	if (deviceSupport.bExtendedDynamicState2)
+	{
+		pfnCmdSetPrimitiveRestartEnable = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(
+			vkGetDeviceProcAddr(mainDevice.logicalDevice, "vkCmdSetPrimitiveRestartEnableEXT"));
+		deviceSupport.bExtendedDynamicState2 = pfnCmdSetPrimitiveRestartEnable != nullptr;
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+	if (deviceSupport.bExtendedDynamicState3)
+	{
+		pfnCmdSetColorBlendEnable = reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(vkGetDeviceProcAddr(mainDevice.logicalDevice, "vkCmdSetColorBlendEnableEXT"));
+		deviceSupport.bExtendedDynamicState3 = pfnCmdSetColorBlendEnable != nullptr;
+	}
+#endif
+}
+
+void VulkanRenderer::CreateAllocator()
+{
+	PROFILE_FUNCTION();
+
+	// Every buffer and image is sub-allocated from this, so the device sees a handful of allocations
+	gpuAllocator = new GpuAllocator(mainDevice.physicalDevice, mainDevice.logicalDevice);
+
+	// Image copies out of the ring start at offsets the device copies from fastest
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+	stagingRing = new StagingRing(mainDevice.logicalDevice, gpuAllocator, StagingRing::DEFAULT_CAPACITY,
+		std::max<VkDeviceSize>(deviceProperties.limits.optimalBufferCopyOffsetAlignment, 16));
+}
+
 void VulkanRenderer::CreateSurface()
 {
+	PROFILE_FUNCTION();
+
 	// Create Surface
 	if (glfwCreateWindowSurface(instance, window->GetWindow(), nullptr, &surface) != VK_SUCCESS)
 	{
@@ -185,6 +1262,8 @@ void VulkanRenderer::CreateSurface()
 
 void VulkanRenderer::CreateSwapChain()
 {
+	PROFILE_FUNCTION();
+
 	SwapChainDetails swp = GetSwapChainDetails(mainDevice.physicalDevice);
 
 	// 1. CHOOSE BEST SURFACE FORMAT
@@ -197,8 +1276,13 @@ void VulkanRenderer::CreateSwapChain()
 	VkExtent2D extent = ChooseSwapExtent(swp.surfaceCapabilities);
 
 	// How many images are in the swap chain?
-	// Get 1 more than the min to allow triple buffering
-	uint32_t imageCount = swp.surfaceCapabilities.minImageCount + 1;
+	// Throughput gets 2 more than the min so the CPU and GPU can run ahead of the display,
+	// the other policies use the min so queued frames don't add latency
+	uint32_t imageCount = swp.surfaceCapabilities.minImageCount;
+	if (settings.presentPolicy == PresentPolicy::Throughput)
+	{
+		imageCount += 2;
+	}
 	if (swp.surfaceCapabilities.maxImageCount > 0 && swp.surfaceCapabilities.maxImageCount < imageCount)
 	{
 		imageCount = swp.surfaceCapabilities.maxImageCount;
@@ -244,16 +1328,21 @@ void VulkanRenderer::CreateSwapChain()
 
 	// If old swap chain been destroyed and this one replaces it,
 	// then link old one to quickly hand over responsibilities
-	swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+	// (old one is retired by RecreateSwapChain, and destroyed once no frame in flight uses it)
+	swapChainCreateInfo.oldSwapchain = swapChain;
 
 	// Create Swap Chain
-	if (vkCreateSwapchainKHR(mainDevice.logicalDevice, &swapChainCreateInfo, nullptr, &swapChain) != VK_SUCCESS)
+	VkSwapchainKHR newSwapChain;
+	if (vkCreateSwapchainKHR(mainDevice.logicalDevice, &swapChainCreateInfo, nullptr, &newSwapChain) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create a Swapchain!");
 	}
+	swapChain = newSwapChain;
 
 	swapChainImageFormat = surfaceFormat.format;
 	swapChainExtent = extent;
+	swapChainPresentMode = presentMode;
+	swapChainPresentPolicy = settings.presentPolicy;
 
 	// Get swap chain images
 	uint32_t swapChainImageCount;
@@ -262,148 +1351,115 @@ void VulkanRenderer::CreateSwapChain()
 	std::vector<VkImage> images(swapChainImageCount);
 	vkGetSwapchainImagesKHR(mainDevice.logicalDevice, swapChain, &swapChainImageCount, images.data());
 
-	for (VkImage image : images)
+	for (VkImage image : images)
+	{
+		// Store image handle
+		SwapChainImage swapChainImage = {};
+		swapChainImage.image = image;
+
+		// Create IMAGE VIEW here
+		swapChainImage.imageView = CreateImageView(image, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		
+		// Add to swapchain image list
+		swapChainImages.push_back(swapChainImage);
+	}
+}
+
+void VulkanRenderer::RecreateSwapChain()
+{
+	PROFILE_FUNCTION();
+
+	// Minimised windows have a zero sized framebuffer, a swapchain can't be created until restored
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window->GetWindow(), &width, &height);
+	if (width == 0 || height == 0)
+	{
+		bSwapChainOutOfDate = true;
+		return;
+	}
+
+	// Frames in flight may still render to or present the old images, so retire rather than destroy them
+	RetiredSwapChain retired;
+	retired.swapChain = swapChain;
+	retired.images = std::move(swapChainImages);
+	retired.lastFrame = submittedFrames;
+	retiredSwapChains.push_back(std::move(retired));
+
+	swapChainImages.clear();
+
+	// Only objects that depend on the extent are rebuilt: render pass and pipelines don't
+	// (viewport and scissor are dynamic, and the surface format is chosen the same way again)
+	// The graph's framebuffers and transient images are retired with the old images
+	CreateSwapChain();
+	renderGraph->Reset(submittedFrames);
+	BuildRenderGraph();
+
+	// New images aren't used by any frame yet
+	imageFences.assign(swapChainImages.size(), VK_NULL_HANDLE);
+
+	bSwapChainOutOfDate = false;
+}
+
+void VulkanRenderer::DestroyRetiredSwapChains(bool bForce)
+{
+	for (size_t i = 0; i < retiredSwapChains.size();)
 	{
-		// Store image handle
-		SwapChainImage swapChainImage = {};
-		swapChainImage.image = image;
+		RetiredSwapChain& retired = retiredSwapChains[i];
+		if (!bForce && completedFrames < retired.lastFrame)
+		{
+			++i;
+			continue;
+		}
 
-		// Create IMAGE VIEW here
-		swapChainImage.imageView = CreateImageView(image, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-		
-		// Add to swapchain image list
-		swapChainImages.push_back(swapChainImage);
+		for (auto& image : retired.images)
+		{
+			vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
+		}
+		vkDestroySwapchainKHR(mainDevice.logicalDevice, retired.swapChain, nullptr);
+
+		retiredSwapChains.erase(retiredSwapChains.begin() + i);
 	}
 }
 
-void VulkanRenderer::CreateGraphicsPipeline()
+void VulkanRenderer::CreateOffscreenTargets()
 {
-	// Read in SPIR-V code of shaders
-	auto vertexShaderCode = readFile("Shaders/vert.spv");
-	auto fragmentShaderCode = readFile("Shaders/frag.spv");
-
-	// Create Shader Modules
-	VkShaderModule vertexShaderModule = CreateShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = CreateShaderModule(fragmentShaderCode);
-
-	// -- SHADER STAGE CREATION INFORMATION --
-	// Vertex Stage creation information
-	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;				// Shader Stage name
-	vertexShaderCreateInfo.module = vertexShaderModule;						// Shader module to be used by stage
-	vertexShaderCreateInfo.pName = "main";									// Entry point in to shader
+	PROFILE_FUNCTION();
 
-	// Fragment Stage creation information
-	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;				// Shader Stage name
-	fragmentShaderCreateInfo.module = fragmentShaderModule;						// Shader module to be used by stage
-	fragmentShaderCreateInfo.pName = "main";									// Entry point in to shader
+	// Stand-ins for swapchain images: rendered to as colour attachment, then copied out for readback
+	swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	swapChainExtent = { settings.width, settings.height };
 
-	// Put shader stage creation info in to array
-	// Graphics Pipeline creation info requires array of shader stage creates
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+	// One image per frame in flight, so frames can overlap without acquiring anything
+	offscreenImageAllocations.resize(frames.size());
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		SwapChainImage offscreenImage = {};
+		offscreenImage.image = CreateImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, MemoryUsage::GpuOnly, &offscreenImageAllocations[i]);
+		offscreenImage.imageView = CreateImageView(offscreenImage.image, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
 
+		swapChainImages.push_back(offscreenImage);
+	}
+}
 
-	// -- VERTEX INPUT (TODO: Put in vertex descriptions when resources created) --
-	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 0;
-	vertexInputCreateInfo.pVertexBindingDescriptions = nullptr;			// List of Vertex Binding Descriptions (data spacing/stride information)
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = 0;
-	vertexInputCreateInfo.pVertexAttributeDescriptions = nullptr;		// List of Vertex Attribute Descriptions (data format and where to bind to/from)
+void VulkanRenderer::CreatePipelineCache()
+{
+	PROFILE_FUNCTION();
 
+	pipelineCache = new PipelineCache(mainDevice.physicalDevice, mainDevice.logicalDevice, PIPELINE_CACHE_FILE);
 
-	// -- INPUT ASSEMBLY --
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;		// Primitive type to assemble vertices as
-	inputAssembly.primitiveRestartEnable = VK_FALSE;					// Allow overriding of "strip" topology to start new primitives
+	// Shader modules are shared between all pipelines using the same SPIR-V
+	shaderModuleCache = new ShaderModuleCache(mainDevice.logicalDevice);
+}
 
+void VulkanRenderer::CreateGraphicsPipeline()
+{
+	PROFILE_FUNCTION();
 
-	// -- VIEWPORT & SCISSOR --
-	// Create a viewport info struct
-	VkViewport viewport = {};
-	viewport.x = 0.0f;									// x start coordinate
-	viewport.y = 0.0f;									// y start coordinate
-	viewport.width = (float)swapChainExtent.width;		// width of viewport
-	viewport.height = (float)swapChainExtent.height;	// height of viewport
-	viewport.minDepth = 0.0f;							// min framebuffer depth
-	viewport.maxDepth = 1.0f;							// max framebuffer depth
-
-	// Create a scissor info struct
-	VkRect2D scissor = {};
-	scissor.offset = { 0,0 };							// Offset to use region from
-	scissor.extent = swapChainExtent;					// Extent to describe region to use, starting at offset
-
-	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.pViewports = &viewport;
-	viewportStateCreateInfo.scissorCount = 1;
-	viewportStateCreateInfo.pScissors = &scissor;
-
-
-	// -- DYNAMIC STATES --
-	// Dynamic states to enable
-	//std::vector<VkDynamicState> dynamicStateEnables;
-	//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);	// Dynamic Viewport : Can resize in command buffer with vkCmdSetViewport(commandbuffer, 0, 1, &viewport);
-	//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// Dynamic Scissor	: Can resize in command buffer with vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
-
-	//// Dynamic State creation info
-	//VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
-	//dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	//dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-	//dynamicStateCreateInfo.pDynamicStates = dynamicStateEnables.data();
-
-
-	// -- RASTERIZER --
-	VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizerCreateInfo.depthClampEnable = VK_FALSE;			// Change if fragments beyond near/far planes are clipped (default) or clamped to plane
-	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;	// Whether to discard data and skip rasterizer. Never creates fragments, only suitable for pipeline without framebuffer output
-	rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;	// How to handle filling points between vertices
-	rasterizerCreateInfo.lineWidth = 1.0f;						// How thick lines should be when drawn
-	rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;		// Which face of a tri to cull
-	rasterizerCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;	// Winding to determine which side is front
-	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;			// Whether to add depth bias to fragments (good for stopping "shadow acne" in shadow mapping)
-
-
-	// -- MULTISAMPLING --
-	VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
-	multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;					// Enable multisample shading or not
-	multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;	// Number of samples to use per fragment
-
-
-	// -- BLENDING --
-	// Blending decides how to blend a new colour being written to a fragment, with the old value
-
-	// Blend Attachment State (how blending is handled)
-	VkPipelineColorBlendAttachmentState colourState = {};
-	colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT	// Colours to apply blending to
-		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colourState.blendEnable = VK_TRUE;													// Enable blending
-
-	// Blending uses equation: (srcColorBlendFactor * new colour) colorBlendOp (dstColorBlendFactor * old colour)
-	colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colourState.colorBlendOp = VK_BLEND_OP_ADD;
-
-	// Summarised: (VK_BLEND_FACTOR_SRC_ALPHA * new colour) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * old colour)
-	//			   (new colour alpha * new colour) + ((1 - new colour alpha) * old colour)
-
-	colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colourState.alphaBlendOp = VK_BLEND_OP_ADD;
-	// Summarised: (1 * new alpha) + (0 * old alpha) = new alpha
-
-	VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
-	colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colourBlendingCreateInfo.logicOpEnable = VK_FALSE;				// Alternative to calculations is to use logical operations
-	colourBlendingCreateInfo.attachmentCount = 1;
-	colourBlendingCreateInfo.pAttachments = &colourState;
+	// Get Shader Modules (only read and created the first time the code is seen)
+	// Owned by the module cache, so they stay alive for pipeline permutations compiled in the background
+	VkShaderModule vertexShaderModule = shaderModuleCache->GetModule("Shaders/vert.spv");
+	VkShaderModule fragmentShaderModule = shaderModuleCache->GetModule("Shaders/frag.spv");
 
 
 	// -- PIPELINE LAYOUT (TODO: Apply Future Descriptor Set Layouts) --
@@ -421,44 +1477,76 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	}
 
 
-	// -- DEPTH STENCIL TESTING --
-	// TODO: Set up depth stencil testing
-
-
-	// -- GRAPHICS PIPELINE CREATION --
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = 2;									// Number of shader stages
-	pipelineCreateInfo.pStages = shaderStages;							// List of shader stages
-	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;		// All the fixed function pipeline states
-	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
-	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
-	pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = nullptr;
-	pipelineCreateInfo.layout = pipelineLayout;							// Pipeline Layout pipeline should use
-	pipelineCreateInfo.renderPass = renderPass;							// Render pass description the pipeline is compatible with
-	pipelineCreateInfo.subpass = 0;										// Subpass of render pass to use with pipeline
+	// -- GRAPHICS PIPELINE DESCRIPTION --
+	// Fixed function state is filled in by the pipeline compiler from this description
+	basePipelineDesc = {};
+	basePipelineDesc.vertexShader = vertexShaderModule;
+	basePipelineDesc.fragmentShader = fragmentShaderModule;
+	basePipelineDesc.layout = pipelineLayout;							// Pipeline Layout pipeline should use
+	basePipelineDesc.renderPass = renderPass;							// Render pass description the pipeline is compatible with
+	basePipelineDesc.subpass = 0;										// Subpass of render pass to use with pipeline
+	basePipelineDesc.colourFormats = { swapChainImageFormat };			// Attachment formats, used instead when there is no render pass
+	basePipelineDesc.vertexLayout = VertexLayout::Interleaved(GetVertexAttributes());
+	basePipelineDesc.frontFace = settings.frontFace;					// Winding to determine which side is front, meshes are cooked for it
+
+	// Cull mode, depth, topology and blend state are set when recording where the device allows, so permutations
+	// differing only in them share one pipeline
+	basePipelineDesc.bExtendedDynamicState = settings.bExtendedDynamicState && deviceSupport.bExtendedDynamicState;
+	basePipelineDesc.bExtendedDynamicState2 = settings.bExtendedDynamicState && deviceSupport.bExtendedDynamicState2;
+	basePipelineDesc.bExtendedDynamicState3 = settings.bExtendedDynamicState && deviceSupport.bExtendedDynamicState3;
+
+	// Create Graphics Pipeline (timed, to compare cold and warm pipeline cache)
+	// Created synchronously: it is the fallback for every draw whose own pipeline isn't compiled yet
+	auto pipelineStart = std::chrono::high_resolution_clock::now();
+	PipelineCompiler::CreateGraphicsPipelines(mainDevice.logicalDevice, pipelineCache->GetCache(), &basePipelineDesc, 1, &graphicsPipeline);
+	auto pipelineEnd = std::chrono::high_resolution_clock::now();
+
+	std::cout << "Graphics Pipeline created in " << std::chrono::duration<double, std::milli>(pipelineEnd - pipelineStart).count()
+		<< " ms (" << (pipelineCache->IsWarm() ? "warm" : "cold") << " cache)\n";
+
+	// Everything else compiles in the background
+	pipelineCompiler = new PipelineCompiler(mainDevice.logicalDevice, pipelineCache);
+}
 
-	// Pipeline Derivatives : Can create multiple pipelines that derive from one another for optimisation
-	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;	// Existing pipeline to derive from...
-	pipelineCreateInfo.basePipelineIndex = -1;				// or index of pipeline being created to derive from (in case creating multiple at once)
+void VulkanRenderer::CreateClusterRenderer()
+{
+	PROFILE_FUNCTION();
 
-	// Create Graphics Pipeline
-	if (vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+	// Optional: without its shaders meshes are simply drawn whole
+	try
+	{
+		clusterRenderer = new ClusterRenderer(mainDevice.logicalDevice, deviceSupport, settings.bMeshShaders, shaderModuleCache,
+			pipelineCache->GetCache(), basePipelineDesc);
+		std::cout << "Cluster culling: " << (clusterRenderer->UsesMeshShaders() ? "task + mesh shaders" : "compute + indirect draw") << std::endl;
+	}
+	catch (const std::runtime_error& e)
 	{
-		throw std::runtime_error("Failed to create a Graphics Pipeline!");
+		std::cout << "Cluster culling disabled: " << e.what() << std::endl;
 	}
+}
+
+void VulkanRenderer::CreateTextureLoader()
+{
+	PROFILE_FUNCTION();
 
-	// Destroy Shader Modules, no longer needed after Pipeline created
-	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
+	textureLoader = new TextureLoader();
+	mipGenerator = new MipGenerator(mainDevice.physicalDevice, mainDevice.logicalDevice, shaderModuleCache, pipelineCache->GetCache());
+	textureStreamer = new TextureStreamer(mainDevice.physicalDevice, mainDevice.logicalDevice, gpuAllocator, stagingRing,
+		deviceSupport.bMemoryBudget, settings.textureStreamingBudget);
 }
 
 void VulkanRenderer::CreateRenderPass()
 {
+	PROFILE_FUNCTION();
+
+	// Pipelines are described by their attachment formats instead
+	if (UsesDynamicRendering())
+	{
+		return;
+	}
+
+	// Pipelines are built against this render pass, frames are recorded in the render graph's compatible passes
+	// (compatibility only depends on attachment formats and sample counts, so loads, stores and layouts are placeholders)
 	// Colour attachment of render pass
 	VkAttachmentDescription colourAttachment = {};
 	colourAttachment.format = swapChainImageFormat;						// Format to use for attachment
@@ -467,11 +1555,8 @@ void VulkanRenderer::CreateRenderPass()
 	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;			// Describes what to do with attachment after rendering
 	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;	// Describes what to do with stencil before rendering
 	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;	// Describes what to do with stencil after rendering
-
-	// Framebuffer data will be stored as an image, but images can be given different data layouts
-	// to give optimal use for certain operations
-	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;			// Image data layout before render pass starts
-	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;		// Image data layout after render pass (to change to)
+	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	// Attachment reference uses an attachment index that refers to index in the attachment list passed to renderPassCreateInfo
 	VkAttachmentReference colourAttachmentReference = {};
@@ -484,32 +1569,6 @@ void VulkanRenderer::CreateRenderPass()
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colourAttachmentReference;
 
-	// Need to determine when layout transitions occur using subpass dependencies
-	std::array<VkSubpassDependency, 2> subpassDependencies;
-
-	// Conversion from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-	// Transition must happen after...
-	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;						// Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of renderpass)
-	subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;		// Pipeline stage
-	subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;				// Stage access mask (memory access)
-	// But must happen before...
-	subpassDependencies[0].dstSubpass = 0;
-	subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpassDependencies[0].dependencyFlags = 0;
-
-
-	// Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-	// Transition must happen after...
-	subpassDependencies[1].srcSubpass = 0;
-	subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;;
-	// But must happen before...
-	subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	subpassDependencies[1].dependencyFlags = 0;
-
 	// Create info for Render Pass
 	VkRenderPassCreateInfo renderPassCreateInfo = {};
 	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -517,8 +1576,6 @@ void VulkanRenderer::CreateRenderPass()
 	renderPassCreateInfo.pAttachments = &colourAttachment;
 	renderPassCreateInfo.subpassCount = 1;
 	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-	renderPassCreateInfo.pDependencies = subpassDependencies.data();
 
 	VkResult result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &renderPass);
 	if (result != VK_SUCCESS)
@@ -527,6 +1584,439 @@ void VulkanRenderer::CreateRenderPass()
 	}
 }
 
+void VulkanRenderer::CreateCommandPool()
+{
+	PROFILE_FUNCTION();
+
+	// Get indices of queue families from device
+	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(mainDevice.physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;		// One-time buffers are begun again (reset) instead of freed
+	poolInfo.queueFamilyIndex = queueFamilyIndices.iGraphicsFamily;			// Queue Family type that buffers from this command pool will use
+
+	// Create a Graphics Queue Family Command Pool
+	if (vkCreateCommandPool(mainDevice.logicalDevice, &poolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Command Pool!");
+	}
+}
+
+void VulkanRenderer::CreateCommandAllocator()
+{
+	PROFILE_FUNCTION();
+
+	// Pools per frame in flight and recording thread, the frame's primary buffer comes from thread 0's pool
+	commandAllocator = new CommandAllocator(mainDevice.logicalDevice, queueFamilies.iGraphicsFamily, static_cast<uint32_t>(frames.size()), settings.recordThreads);
+}
+
+void VulkanRenderer::CreateCommandRecorder()
+{
+	PROFILE_FUNCTION();
+
+	commandRecorder = new CommandRecorder(commandAllocator);
+	recordThreadCount = commandRecorder->GetThreadCount();
+}
+
+void VulkanRenderer::CreateSynchronisation()
+{
+	PROFILE_FUNCTION();
+
+	// No swapchain image is in use by any frame yet
+	imageFences.assign(swapChainImages.size(), VK_NULL_HANDLE);
+
+	// Semaphore creation information
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Fence creation information
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;		// Start signalled so the first wait on each frame doesn't block
+
+	for (auto &frame : frames)
+	{
+		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &frame.imageAvailable) != VK_SUCCESS ||
+			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &frame.renderFinished) != VK_SUCCESS ||
+			vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &frame.drawFence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Semaphore and/or Fence!");
+		}
+	}
+}
+
+void VulkanRenderer::CreateGpuProfiler()
+{
+	PROFILE_FUNCTION();
+
+	// Profiler disables itself if the Graphics queue can't write timestamps
+	QueueFamilyIndices indices = GetQueueFamilies(mainDevice.physicalDevice);
+	gpuProfiler = new GpuProfiler(mainDevice.logicalDevice, mainDevice.physicalDevice, static_cast<int>(frames.size()), indices.graphicsTimestampValidBits);
+	if (!gpuProfiler->IsEnabled())
+	{
+		std::cout << "GPU timestamps are not supported on the graphics queue, GPU profiling disabled" << std::endl;
+	}
+}
+
+void VulkanRenderer::CreateRenderGraph()
+{
+	PROFILE_FUNCTION();
+
+	renderGraph = new RenderGraph(mainDevice.logicalDevice, gpuAllocator, gpuProfiler, UsesDynamicRendering());
+	BuildRenderGraph();
+}
+
+void VulkanRenderer::BuildRenderGraph()
+{
+	PROFILE_FUNCTION();
+
+	// Swapchain (or offscreen) image: contents are discarded once acquired, and handed to present (or readback) after the frame
+	RenderGraph::ImageDesc backbufferDesc;
+	backbufferDesc.format = swapChainImageFormat;
+	backbufferDesc.extent = swapChainExtent;
+
+	RenderGraph::ImageState acquiredState;
+	acquiredState.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	acquiredState.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;		// Where the submit waits for the acquire
+	acquiredState.access = 0;
+
+	RenderGraph::ImageState presentState;
+	presentState.layout = settings.bHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	presentState.stages = settings.bHeadless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	presentState.access = settings.bHeadless ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+
+	backbuffer = renderGraph->ImportImage("Backbuffer", backbufferDesc, acquiredState, presentState);
+
+	// Scene, straight in to the backbuffer
+	VkClearValue clearColour = {};
+	clearColour.color = { { 0.6f, 0.65f, 0.4f, 1.0f } };
+	mainPass = renderGraph->AddPass("MainPass", true, [this](const RenderGraph::PassContext& context) { RecordMainPass(context); });
+	renderGraph->Write(mainPass, backbuffer, RenderGraph::Usage::ColourAttachment, &clearColour);
+
+	renderGraph->Compile();
+}
+
+void VulkanRenderer::CreateSceneMesh()
+{
+	PROFILE_FUNCTION();
+
+	// The triangle the vertex shader used to hardcode, uploaded with the first frame
+	std::vector<Vertex> vertices = {
+		{ { 0.0f, -0.4f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 0.4f, 0.4f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -0.4f, 0.4f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+	};
+	std::vector<uint32_t> indices = { 0, 1, 2 };
+
+	triangleMesh = CreateMesh(basePipelineDesc.vertexLayout, vertices, indices);
+	sceneMesh = triangleMesh;
+}
+
+void VulkanRenderer::DestroyRetiredMeshes(bool bForce)
+{
+	for (size_t i = 0; i < retiredMeshes.size();)
+	{
+		if (!bForce && completedFrames < retiredMeshes[i].lastFrame)
+		{
+			++i;
+			continue;
+		}
+
+		Mesh* mesh = retiredMeshes[i].mesh;
+		for (size_t s = 0; s < mesh->vertexBuffers.size(); ++s)
+		{
+			gpuAllocator->DestroyBuffer(mesh->vertexBuffers[s], mesh->vertexAllocations[s]);
+		}
+		gpuAllocator->DestroyBuffer(mesh->indexBuffer, mesh->indexAllocation);
+		if (mesh->meshletCount > 0)
+		{
+			if (clusterRenderer != nullptr)
+			{
+				clusterRenderer->DestroyMeshResources(*mesh, gpuAllocator);
+			}
+			gpuAllocator->DestroyBuffer(mesh->meshletBuffer, mesh->meshletAllocation);
+			gpuAllocator->DestroyBuffer(mesh->meshletVertexBuffer, mesh->meshletVertexAllocation);
+			gpuAllocator->DestroyBuffer(mesh->meshletTriangleBuffer, mesh->meshletTriangleAllocation);
+		}
+		delete mesh;
+
+		retiredMeshes.erase(retiredMeshes.begin() + i);
+	}
+}
+
+void VulkanRenderer::RecordCommands(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	PROFILE_FUNCTION();
+
+	// Information about how to begin each command buffer
+	VkCommandBufferBeginInfo bufferBeginInfo = {};
+	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;	// Re-recorded before every submit
+
+	// Start recording commands to command buffer!
+	if (vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording a Command Buffer!");
+	}
+
+	// Collect this frame slot's previous timings and reset its queries (must be outside a render pass)
+	gpuProfiler->BeginFrame(currentFrame, commandBuffer);
+
+	// Uploads queued since the last frame, their staging space is reclaimed once this frame completes
+	{
+		GpuProfileScope uploadScope(gpuProfiler, commandBuffer, "Uploads");
+		RecordUploads(commandBuffer, submittedFrames + 1);
+	}
+
+	// Meshlets are culled before the pass that draws them (compute path only)
+	if (DrawsClusters() && !clusterRenderer->UsesMeshShaders())
+	{
+		GpuProfileScope cullScope(gpuProfiler, commandBuffer, "ClusterCull");
+		clusterRenderer->RecordCull(commandBuffer, *sceneMesh, cullParams);
+	}
+
+	// Render passes, with the barriers and layout transitions between them
+	renderGraph->SetImportedImage(backbuffer, swapChainImages[imageIndex].image, swapChainImages[imageIndex].imageView);
+	renderGraph->SetPassContents(mainPass, GetRecordSliceCount() > 1 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+	renderGraph->Execute(commandBuffer);
+
+	// Stop recording to command buffer
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Command Buffer!");
+	}
+}
+
+void VulkanRenderer::RecordMainPass(const RenderGraph::PassContext& context)
+{
+	VkCommandBuffer commandBuffer = context.commandBuffer;
+
+	// Large draw lists are recorded in slices on several threads, in to secondary buffers the pass executes
+	uint32_t drawCount = sceneDraws.empty() ? 1 : static_cast<uint32_t>(sceneDraws.size());
+	uint32_t sliceCount = GetRecordSliceCount();
+	auto recordStart = std::chrono::high_resolution_clock::now();
+
+	// Scene pipeline may still be compiling in the background, draw with the base pipeline until it is ready
+	VkPipeline pipeline = PipelineCompiler::ReadyOr(scenePipeline, graphicsPipeline);
+	const GraphicsPipelineDesc* pipelineDesc = pipeline == graphicsPipeline ? &basePipelineDesc : &scenePipelineDesc;
+
+	if (sliceCount > 1)
+	{
+		VkCommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = context.renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = context.framebuffer;
+
+#ifdef VK_KHR_dynamic_rendering
+		// Without a render pass the secondary buffers are told the formats they render to
+		VkCommandBufferInheritanceRenderingInfoKHR renderingInheritanceInfo = {};
+		renderingInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+		renderingInheritanceInfo.colorAttachmentCount = context.colourFormatCount;
+		renderingInheritanceInfo.pColorAttachmentFormats = context.colourFormats;
+		renderingInheritanceInfo.depthAttachmentFormat = context.depthFormat;
+		renderingInheritanceInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+		renderingInheritanceInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		if (context.renderPass == VK_NULL_HANDLE)
+		{
+			inheritanceInfo.pNext = &renderingInheritanceInfo;
+		}
+#endif
+
+		// Secondary buffers inherit no state, every slice sets its own
+		const std::vector<VkCommandBuffer>& secondaryBuffers = commandRecorder->Record(static_cast<uint32_t>(currentFrame), inheritanceInfo,
+			drawCount, sliceCount, [this, pipeline, pipelineDesc](VkCommandBuffer sliceBuffer, uint32_t first, uint32_t end)
+		{
+			RecordDynamicState(sliceBuffer, *pipelineDesc);
+			RecordSceneDraws(sliceBuffer, pipeline, first, end);
+		});
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+	}
+	else if (!sceneDraws.empty())
+	{
+		RecordDynamicState(commandBuffer, *pipelineDesc);
+		RecordSceneDraws(commandBuffer, pipeline, 0, drawCount);
+	}
+	else if (DrawsClusters())
+	{
+		RecordDynamicState(commandBuffer, *pipelineDesc);
+
+		// Visible meshlets only
+		clusterRenderer->RecordDraw(commandBuffer, *sceneMesh, cullParams, pipeline);
+	}
+	else
+	{
+		RecordDynamicState(commandBuffer, *pipelineDesc);
+
+		// Bind Pipeline to be used in render pass
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		// Bind every vertex stream of the mesh, and its index buffer
+		const VkDeviceSize offsets[MAX_VERTEX_STREAMS] = {};
+		vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(sceneMesh->vertexBuffers.size()), sceneMesh->vertexBuffers.data(), offsets);
+		vkCmdBindIndexBuffer(commandBuffer, sceneMesh->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// Execute pipeline
+		vkCmdDrawIndexed(commandBuffer, sceneMesh->indexCount, 1, 0, 0, 0);
+	}
+
+	commandStats.frameCount++;
+	commandStats.drawCount += drawCount;
+	commandStats.recordMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+}
+
+bool VulkanRenderer::DrawsClusters() const
+{
+	return sceneDraws.empty() && settings.bClusterCulling && clusterRenderer != nullptr && clusterRenderer->CanDraw(*sceneMesh);
+}
+
+uint32_t VulkanRenderer::GetRecordSliceCount() const
+{
+	uint32_t drawCount = static_cast<uint32_t>(sceneDraws.size());
+	return std::min(recordThreadCount, drawCount / MIN_DRAWS_PER_RECORD_THREAD);
+}
+
+void VulkanRenderer::RecordDynamicState(VkCommandBuffer commandBuffer, const GraphicsPipelineDesc& pipelineDesc)
+{
+	// Viewport and scissor are dynamic state, so pipelines don't have to be rebuilt on resize
+	VkViewport viewport = {};
+	viewport.x = 0.0f;										// x start coordinate
+	viewport.y = 0.0f;										// y start coordinate
+	viewport.width = (float)swapChainExtent.width;			// width of viewport
+	viewport.height = (float)swapChainExtent.height;		// height of viewport
+	viewport.minDepth = 0.0f;								// min framebuffer depth
+	viewport.maxDepth = 1.0f;								// max framebuffer depth
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0,0 };								// Offset to use region from
+	scissor.extent = swapChainExtent;						// Extent to describe region to use, starting at offset
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// Fixed function state the pipeline leaves dynamic, as its description asks for
+#ifdef VK_EXT_extended_dynamic_state
+	if (pipelineDesc.bExtendedDynamicState)
+	{
+		pfnCmdSetCullMode(commandBuffer, pipelineDesc.cullMode);
+		pfnCmdSetFrontFace(commandBuffer, pipelineDesc.frontFace);
+		pfnCmdSetPrimitiveTopology(commandBuffer, pipelineDesc.topology);
+		pfnCmdSetDepthTestEnable(commandBuffer, pipelineDesc.bDepthTest ? VK_TRUE : VK_FALSE);
+		pfnCmdSetDepthWriteEnable(commandBuffer, pipelineDesc.bDepthWrite ? VK_TRUE : VK_FALSE);
+		pfnCmdSetDepthCompareOp(commandBuffer, pipelineDesc.depthCompareOp);
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+	if (pipelineDesc.bExtendedDynamicState2)
+	{
+		pfnCmdSetPrimitiveRestartEnable(commandBuffer, pipelineDesc.bPrimitiveRestart ? VK_TRUE : VK_FALSE);
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+	if (pipelineDesc.bExtendedDynamicState3)
+	{
+		VkBool32 blendEnable = pipelineDesc.bBlendEnable ? VK_TRUE : VK_FALSE;
+		pfnCmdSetColorBlendEnable(commandBuffer, 0, 1, &blendEnable);
+	}
+#endif
+}
+
+void VulkanRenderer::RecordSceneDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline, uint32_t first, uint32_t end)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	// Buffers are only rebound when the mesh changes, so lists sorted by mesh are cheapest
+	const Mesh* boundMesh = nullptr;
+	const VkDeviceSize offsets[MAX_VERTEX_STREAMS] = {};
+	for (uint32_t i = first; i < end; ++i)
+	{
+		const MeshDraw& draw = sceneDraws[i];
+		if (draw.mesh != boundMesh)
+		{
+			vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(draw.mesh->vertexBuffers.size()), draw.mesh->vertexBuffers.data(), offsets);
+			vkCmdBindIndexBuffer(commandBuffer, draw.mesh->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			boundMesh = draw.mesh;
+		}
+
+		uint32_t indexCount = draw.indexCount != 0 ? draw.indexCount : draw.mesh->indexCount - draw.firstIndex;
+		vkCmdDrawIndexed(commandBuffer, indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+	}
+}
+
+VkCommandBuffer VulkanRenderer::BeginOneTimeCommands()
+{
+	// Command buffer to hold transfer commands, a finished one if there is one
+	VkCommandBuffer commandBuffer;
+	if (!oneTimeCommandBuffers.empty())
+	{
+		commandBuffer = oneTimeCommandBuffers.back();
+		oneTimeCommandBuffers.pop_back();
+		commandStats.recycledBuffers++;
+	}
+	else
+	{
+		// Command Buffer details
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = graphicsCommandPool;
+		allocInfo.commandBufferCount = 1;
+
+		// Allocate command buffer from pool
+		if (vkAllocateCommandBuffers(mainDevice.logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate Command Buffers!");
+		}
+		commandStats.allocatedBuffers++;
+	}
+
+	// Information to begin the command buffer record
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;	// We're only using the command buffer once
+
+	// Begin recording transfer commands (implicitly resets a reused buffer)
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+void VulkanRenderer::EndOneTimeCommands(VkCommandBuffer commandBuffer)
+{
+	// End commands
+	vkEndCommandBuffer(commandBuffer);
+
+	// Queue submission information
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	// Submit command to queue and wait until it has finished
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(graphicsQueue);
+
+	// Queue is idle, so the buffer can be begun again by the next one-time submit (the pool frees it on destruction)
+	oneTimeCommandBuffers.push_back(commandBuffer);
+}
+
+VulkanRenderer::CommandStats VulkanRenderer::GetCommandStats() const
+{
+	// One-time buffers are counted here, everything else by the allocator
+	CommandStats stats = commandStats;
+	CommandAllocator::Stats allocatorStats = commandAllocator->GetStats();
+	stats.allocatedBuffers += allocatorStats.allocatedBuffers;
+	stats.recycledBuffers += allocatorStats.recycledBuffers;
+	stats.poolResets += allocatorStats.poolResets;
+	return stats;
+}
+
+void VulkanRenderer::ResetCommandStats()
+{
+	commandStats = CommandStats();
+	commandAllocator->ResetStats();
+}
+
 bool VulkanRenderer::CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions)
 {
 	// IMPORTANT
@@ -553,7 +2043,7 @@ bool VulkanRenderer::CheckInstanceExtensionSupport(std::vector<const char*>* che
 		bool hasExtension = false;
 		for (const auto& extension : extensions)
 		{
-			if (strcmp(checkExtension, extension.extensionName))
+			if (strcmp(checkExtension, extension.extensionName) == 0)
 			{
 				hasExtension = true;
 				break;
@@ -569,33 +2059,57 @@ bool VulkanRenderer::CheckInstanceExtensionSupport(std::vector<const char*>* che
 	return true;
 }
 
-bool VulkanRenderer::CheckDeviceExtensionSupport(VkPhysicalDevice device)
+bool VulkanRenderer::CheckDeviceExtensionSupport(VkPhysicalDevice device, DeviceSupport* support)
 {
 	// Get device extension count
 	uint32_t extensionCount = 0;
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
-	if (extensionCount == 0)
-		return false;
-
 	// Create list of vkExtensionProperties using count
 	std::vector<VkExtensionProperties> extensions(extensionCount);
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+	if (extensionCount > 0)
+	{
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+	}
 
-	// Check if given extensions are in list of available extensions
-	for (const auto& deviceExtension : deviceExtensions)
+	auto hasExtension = [&extensions](const char* name)
 	{
-		bool hasExtension = false;
 		for (const auto& extension : extensions)
 		{
-			if (strcmp(deviceExtension, extension.extensionName))
+			if (strcmp(name, extension.extensionName) == 0)
 			{
-				hasExtension = true;
-				break;
+				return true;
 			}
 		}
+		return false;
+	};
 
-		if (!hasExtension)
+	// Optional extensions, their features are checked when the logical device is created
+	if (support != nullptr)
+	{
+		*support = DeviceSupport();
+#ifdef VK_EXT_mesh_shader
+		support->bMeshShader = hasExtension(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+#endif
+		support->bMemoryBudget = hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#ifdef VK_KHR_dynamic_rendering
+		support->bDynamicRendering = hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+		support->bExtendedDynamicState = hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+		support->bExtendedDynamicState2 = hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+		support->bExtendedDynamicState3 = hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+#endif
+	}
+
+	// Check if given extensions are in list of available extensions
+	for (const auto& deviceExtension : GetRequiredDeviceExtensions())
+	{
+		if (!hasExtension(deviceExtension))
 		{
 			return false;
 		}
@@ -619,14 +2133,26 @@ bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
 
 	bool bExtensionSupported = CheckDeviceExtensionSupport(device);
 
-	bool bSwapChainValid = false;
-	if (bExtensionSupported)
+	// Headless rendering has no surface, so any device that can do graphics will do
+	bool bSwapChainValid = settings.bHeadless;
+	if (bExtensionSupported && !settings.bHeadless)
 	{
 		SwapChainDetails swp = GetSwapChainDetails(device);
 		bSwapChainValid = !swp.presentationModes.empty() && !swp.formats.empty();
 	}
 
-	return indices.isValid() && bExtensionSupported && bSwapChainValid;
+	return indices.isValid(!settings.bHeadless) && bExtensionSupported && bSwapChainValid;
+}
+
+std::vector<const char*> VulkanRenderer::GetRequiredDeviceExtensions()
+{
+	// Swapchain extension is only needed when presenting to a window
+	if (settings.bHeadless)
+	{
+		return {};
+	}
+
+	return deviceExtensions;
 }
 
 QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
@@ -641,31 +2167,60 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
 	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilyList.data());
 
-	// Go through each queue family and check if it has at least 1 of the required types of queue
+	// Go through every queue family, the dedicated ones can come after graphics and presentation
 	int i = 0;
 	for (const auto& queueFamily : queueFamilyList)
 	{
 		// First check if queue family has at least 1 queue in that family
+		if (queueFamily.queueCount == 0)
+		{
+			++i;
+			continue;
+		}
+
 		// Queue can be multiple types defined through bitfield.
 		// Need to bitwise AND with VK_QUEUE_*_BIT to check if has required type
-		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		bool bGraphics = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		bool bCompute = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+		bool bTransfer = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+		// Check if queue family supports presentation (nothing to present to when headless)
+		VkBool32 bPresentationSupport = false;
+		if (surface != VK_NULL_HANDLE)
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &bPresentationSupport);
+		}
+
+		// Prefer a graphics family that can also present, so no image is shared between families
+		if (bGraphics && (indices.iGraphicsFamily < 0 || (bPresentationSupport && indices.iGraphicsFamily != indices.iPresentationFamily)))
 		{
 			// If queue family is valid then get index
 			indices.iGraphicsFamily = i;
+
+			// GPU profiling writes timestamps on this queue, only possible if it has valid bits
+			indices.graphicsTimestampValidBits = queueFamily.timestampValidBits;
 		}
 
-		// Check if queue family supports presentation
-		VkBool32 bPresentationSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &bPresentationSupport);
-		if (queueFamily.queueCount > 0 && bPresentationSupport)
+		if (bPresentationSupport && (indices.iPresentationFamily < 0 || indices.iGraphicsFamily == i))
 		{
 			indices.iPresentationFamily = i;
 		}
 
-		// Check if queue family indices are in a valid state, stop searching if so
-		if (indices.isValid())
+		// Async compute: compute without graphics
+		if (bCompute && !bGraphics && indices.iComputeFamily < 0)
 		{
-			break;
+			indices.iComputeFamily = i;
+			indices.computeQueueCount = queueFamily.queueCount;
+		}
+
+		// Transfer without graphics, a transfer only family beats one that also does compute
+		// (compute families always support transfer, even if they don't report the bit)
+		bool bTransferOnly = bTransfer && !bGraphics && !bCompute;
+		bool bCurrentTransferOnly = indices.iTransferFamily >= 0 && !(queueFamilyList[indices.iTransferFamily].queueFlags & VK_QUEUE_COMPUTE_BIT);
+		if ((bTransfer || bCompute) && !bGraphics && (indices.iTransferFamily < 0 || (bTransferOnly && !bCurrentTransferOnly)))
+		{
+			indices.iTransferFamily = i;
+			indices.transferQueueCount = queueFamily.queueCount;
 		}
 
 		++i;
@@ -725,14 +2280,29 @@ VkSurfaceFormatKHR VulkanRenderer::ChooseBestSurfaceFormat(const std::vector<VkS
 
 VkPresentModeKHR VulkanRenderer::ChooseBestPresentationMode(const std::vector<VkPresentModeKHR> presentationModes)
 {
-	for (const auto& presentationMode : presentationModes)
+	// Preferred modes for the current policy, in order
+	std::vector<VkPresentModeKHR> preferredModes;
+	switch (settings.presentPolicy)
 	{
-		if (presentationMode == VK_PRESENT_MODE_MAILBOX_KHR)
+	case PresentPolicy::LowLatency:
+		preferredModes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+		break;
+	case PresentPolicy::Throughput:
+		preferredModes = { VK_PRESENT_MODE_MAILBOX_KHR };
+		break;
+	default:
+		break;
+	}
+
+	for (VkPresentModeKHR preferredMode : preferredModes)
+	{
+		if (std::find(presentationModes.begin(), presentationModes.end(), preferredMode) != presentationModes.end())
 		{
-			return presentationMode;
+			return preferredMode;
 		}
 	}
 
+	// FIFO is always available (and is what PowerSaving wants)
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -760,12 +2330,47 @@ VkExtent2D VulkanRenderer::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surf
 	}
 }
 
-VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags,
+	MemoryUsage memoryUsage, MemoryAllocation* imageAllocation, uint32_t mipLevels, uint32_t layerCount, VkImageCreateFlags createFlags)
+{
+	// CREATE IMAGE
+	// Image Creation Info
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;						// Type of image (1D, 2D, or 3D)
+	imageCreateInfo.extent.width = width;								// Width of image extent
+	imageCreateInfo.extent.height = height;								// Height of image extent
+	imageCreateInfo.extent.depth = 1;									// Depth of image (just 1, no 3D aspect)
+	imageCreateInfo.flags = createFlags;
+	imageCreateInfo.mipLevels = mipLevels;								// Number of mipmap levels
+	imageCreateInfo.arrayLayers = layerCount;							// Number of levels in image array
+	imageCreateInfo.format = format;									// Format type of image
+	imageCreateInfo.tiling = tiling;									// How image data should be "tiled" (arranged for optimal reading)
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;			// Layout of image data on creation
+	imageCreateInfo.usage = useFlags;									// Bit flags defining what image will be used for
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;					// Number of samples for multi-sampling
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;			// Whether image can be shared between queues
+
+	// Create image
+	VkImage image;
+	if (vkCreateImage(mainDevice.logicalDevice, &imageCreateInfo, nullptr, &image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Image!");
+	}
+
+	// CREATE MEMORY FOR IMAGE
+	// Sub-allocated from a shared block and bound at the allocation's offset
+	gpuAllocator->AllocateImageMemory(image, tiling, memoryUsage, imageAllocation);
+
+	return image;
+}
+
+VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t layerCount)
 {
 	VkImageViewCreateInfo viewCreateInfo = {};
 	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewCreateInfo.image = image;										// Image to create view for
-	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;					// Type of Image
+	viewCreateInfo.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;	// Type of Image
 	viewCreateInfo.format = format;
 	viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;		// Allow remapping of rgba components to other rgba values
 	viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -775,9 +2380,9 @@ VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkIm
 	// Subresources allow the view to view only a part of an image
 	viewCreateInfo.subresourceRange.aspectMask = aspectFlags;			// which aspect of image to view
 	viewCreateInfo.subresourceRange.baseMipLevel = 0;					// Start mipmap level to view from
-	viewCreateInfo.subresourceRange.levelCount = 1;						// Num of mipmap levels to view
+	viewCreateInfo.subresourceRange.levelCount = mipLevels;				// Num of mipmap levels to view
 	viewCreateInfo.subresourceRange.baseArrayLayer = 0;					// Start aray level to view from
-	viewCreateInfo.subresourceRange.layerCount = 1;						// Num of array levels to view
+	viewCreateInfo.subresourceRange.layerCount = layerCount;			// Num of array levels to view
 	
 	// Create image and view and return it
 	VkImageView imageView;
@@ -789,21 +2394,6 @@ VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkIm
 	return imageView;
 }
 
-VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<char>& code)
-{
-	VkShaderModuleCreateInfo shaderModuleCrateInfo = {};
-	shaderModuleCrateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCrateInfo.codeSize = code.size();
-	shaderModuleCrateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(mainDevice.logicalDevice, &shaderModuleCrateInfo, nullptr, &shaderModule) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create shader module!");
-	}
-	return shaderModule;
-}
-
 
 
 
@@ -4,42 +4,306 @@
 #include <GLFW/glfw3.h>
 
 #include <set>
+#include <deque>
+#include <map>
 #include <array>
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <chrono>
 #include <algorithm>
 
 #include "VulkanWindow.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "ShaderModuleCache.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "GpuAllocator.h"
+#include "StagingRing.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "ClusterRenderer.h"
+#include "Texture.h"
+#include "TextureLoader.h"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
+#include "RenderGraph.h"
+#include "CommandAllocator.h"
+#include "CommandRecorder.h"
 #include "Utilities.h"
 
 class VulkanRenderer
 {
 public:
-	VulkanRenderer();
+	VulkanRenderer(const RendererSettings& settings = RendererSettings());
 	~VulkanRenderer();
 
+	// nullptr when headless
 	VulkanWindow* GetVulkanWindow() { return window; }
 
+	void				Draw();
+	void				WaitIdle();
+
+	// Copy the most recently drawn frame to host memory (tightly packed RGBA8, top row first)
+	void				ReadbackLastFrame(std::vector<uint8_t>& pixels);
+
+	bool				IsHeadless() const { return settings.bHeadless; }
+	VkExtent2D			GetExtent() const { return swapChainExtent; }
+
+	int					GetFramesInFlight() const { return static_cast<int>(frames.size()); }
+
+	// Meshes
+	// Data goes through the staging ring, copies are recorded at the start of the next frame (or by FlushUploads)
+	Mesh*				CreateMesh(const VertexLayout& layout, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	Mesh*				CreateMesh(const VertexLayout& layout, const MeshData& meshData);	// With its meshlets, if it has any
+	Mesh*				CreateMesh(const MeshCacheFile& cacheFile);		// Uses the layout the cache was cooked with
+	void				DestroyMesh(Mesh* mesh);					// Deferred until no frame in flight uses it
+	void				UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+	void				FlushUploads();								// Copy everything queued now and wait for it
+
+	// Textures
+	// Decoded on loader threads, then uploaded and mip mapped over the next frames (state becomes Ready or Failed)
+	Texture*			LoadTexture(const std::string& fileName, bool bSRGB = true);
+	Texture*			LoadTextureArray(const std::vector<std::string>& fileNames, bool bSRGB = true);	// One layer per file
+	void				DestroyTexture(Texture* texture);			// Deferred until no frame in flight uses it
+	void				FinishTextureLoads();						// Block until every requested texture is Ready or Failed
+
+	// Streamed textures are Ready once their mip tail is resident, finer mips follow ReportTextureUsage
+	Texture*			LoadStreamedTexture(const std::string& fileName, bool bSRGB = true);
+	void				ReportTextureUsage(Texture* texture, float screenPixels) { textureStreamer->ReportUsage(texture, screenPixels); }
+	TextureStreamer*	GetTextureStreamer() { return textureStreamer; }
+
+	// Mesh drawn each frame (nullptr = default triangle), scene pipeline must use the mesh's vertex layout
+	void				SetSceneMesh(Mesh* mesh) { sceneMesh = mesh != nullptr ? mesh : triangleMesh; }
+
+	// View meshlets are culled against (default: the clip volume, looking down +z)
+	// Meshes with meshlets are drawn through the cluster renderer when settings.bClusterCulling is set
+	void				SetCullView(const glm::mat4& viewProjection, const glm::vec4& camera) { cullParams = ClusterCullParams::FromViewProjection(viewProjection, camera); }
+	ClusterRenderer*	GetClusterRenderer() { return clusterRenderer; }
+
+	// Draw list drawn each frame instead of the scene mesh (empty = scene mesh), with the scene pipeline
+	// Large lists are recorded in slices on several threads, at most count (clamped to the recorder's threads, 1 = inline)
+	void				SetSceneDraws(const std::vector<MeshDraw>& draws) { sceneDraws = draws; }
+	void				SetRecordThreadCount(uint32_t count) { recordThreadCount = count; }
+	CommandRecorder*	GetCommandRecorder() { return commandRecorder; }
+
+	// CPU cost of recording the main pass contents, and command buffer churn (a steady frame allocates none)
+	struct CommandStats
+	{
+		uint64_t		frameCount = 0;
+		uint64_t		drawCount = 0;
+		double			recordMs = 0.0;
+		uint64_t		allocatedBuffers = 0;			// vkAllocateCommandBuffers calls
+		uint64_t		recycledBuffers = 0;			// Buffers reused after their pool was reset
+		uint64_t		poolResets = 0;
+	};
+	CommandStats		GetCommandStats() const;
+	void				ResetCommandStats();
+
+	// Attributes of Vertex (location 0 = position, 1 = colour)
+	static std::vector<VertexAttribute> GetVertexAttributes();
+
+	// Presentation policy, switching recreates the swapchain at the start of the next frame
+	struct PresentLatencyStats
+	{
+		uint64_t		frameCount = 0;
+		double			totalMs = 0.0;
+		double			minMs = 0.0;
+		double			maxMs = 0.0;
+
+		double			GetAverageMs() const { return frameCount > 0 ? totalMs / frameCount : 0.0; }
+	};
+	void				SetPresentPolicy(PresentPolicy policy);
+	PresentPolicy		GetPresentPolicy() const { return settings.presentPolicy; }
+	VkPresentModeKHR	GetPresentMode() const { return swapChainPresentMode; }
+
+	// CPU time from starting to acquire an image to the present call returning, per policy
+	const PresentLatencyStats& GetPresentLatency(PresentPolicy policy) const { return presentLatency[static_cast<size_t>(policy)]; }
+
+	// Background pipeline compilation
+	// Permutations are built from the base description, the scene is drawn with the base pipeline until its own is ready
+	PipelineCompiler*			GetPipelineCompiler() { return pipelineCompiler; }
+	const GraphicsPipelineDesc&	GetBasePipelineDesc() const { return basePipelineDesc; }
+	// desc: what the pipeline was compiled from, the states it leaves dynamic are set from it when recording
+	void						SetScenePipeline(std::shared_future<VkPipeline> pipeline, const GraphicsPipelineDesc& desc) { scenePipeline = pipeline; scenePipelineDesc = desc; }
+	ShaderModuleCache*			GetShaderModuleCache() { return shaderModuleCache; }
+
+	// Per pass GPU timings, read back without stalling once each frame's fence has signalled
+	GpuProfiler*				GetGpuProfiler() { return gpuProfiler; }
+
+	// Queues
+	// Without a dedicated family the transfer and compute queues are the graphics queue.
+	// Queues need external synchronisation, submit to each from one thread at a time.
+	const QueueFamilyIndices&	GetQueueFamilyIndices() const { return queueFamilies; }
+	VkQueue						GetGraphicsQueue() { return graphicsQueue; }
+	VkQueue						GetTransferQueue(uint32_t index = 0) { return transferQueues.empty() ? graphicsQueue : transferQueues[index % transferQueues.size()]; }
+	VkQueue						GetComputeQueue(uint32_t index = 0) { return computeQueues.empty() ? graphicsQueue : computeQueues[index % computeQueues.size()]; }
+	uint32_t					GetTransferQueueCount() const { return static_cast<uint32_t>(transferQueues.size()); }
+	uint32_t					GetComputeQueueCount() const { return static_cast<uint32_t>(computeQueues.size()); }
+	bool						HasDedicatedTransferQueue() const { return !transferQueues.empty(); }
+	bool						HasAsyncComputeQueue() const { return !computeQueues.empty(); }
+
+	// Optional extensions and features enabled on the device
+	const DeviceSupport&		GetDeviceSupport() const { return deviceSupport; }
+
+	// Frames render without render pass and framebuffer objects (supported and allowed by the settings)
+	bool						UsesDynamicRendering() const { return deviceSupport.bDynamicRendering && settings.bDynamicRendering; }
+
+	// Device memory for every buffer and image
+	VkDevice					GetDevice() const { return mainDevice.logicalDevice; }
+	GpuAllocator*				GetGpuAllocator() { return gpuAllocator; }
+
+	// Passes of a frame, rebuilt when the swapchain is
+	RenderGraph*				GetRenderGraph() { return renderGraph; }
+
+	// Uploads queued here are copied at the start of the next recorded frame
+	StagingRing*				GetStagingRing() { return stagingRing; }
+
 private:
+	RendererSettings			settings;
+
 	VkInstance					instance;
 	VulkanWindow*				window = nullptr;
 	VkQueue						graphicsQueue;
-	VkQueue						presentationQueue;
-	VkSurfaceKHR				surface;
-	VkSwapchainKHR				swapChain;
+	VkQueue						presentationQueue = VK_NULL_HANDLE;
+	std::vector<VkQueue>		transferQueues;
+	std::vector<VkQueue>		computeQueues;
+	QueueFamilyIndices			queueFamilies;
+	VkSurfaceKHR				surface = VK_NULL_HANDLE;
+	VkSwapchainKHR				swapChain = VK_NULL_HANDLE;
 
 	// - Pipeline
+	PipelineCache*				pipelineCache = nullptr;
+	PipelineCompiler*			pipelineCompiler = nullptr;
+	GraphicsPipelineDesc		basePipelineDesc;
+	std::shared_future<VkPipeline> scenePipeline;
+	GraphicsPipelineDesc		scenePipelineDesc;
+	ShaderModuleCache*			shaderModuleCache = nullptr;
 	VkPipeline					graphicsPipeline;
 	VkPipelineLayout			pipelineLayout;
-	VkRenderPass				renderPass;
+	VkRenderPass				renderPass = VK_NULL_HANDLE;	// Pipeline compatibility, frames use the render graph's passes (none with dynamic rendering)
+
+	// - Profiling
+	GpuProfiler*				gpuProfiler = nullptr;
+
+	// - Memory
+	GpuAllocator*				gpuAllocator = nullptr;
+	StagingRing*				stagingRing = nullptr;
+
+	// - Scene
+	Mesh*						triangleMesh = nullptr;
+	Mesh*						sceneMesh = nullptr;
+	struct RetiredMesh
+	{
+		Mesh*					mesh;
+		uint64_t				lastFrame;				// Number of frames submitted when it was destroyed
+	};
+	std::vector<RetiredMesh>	retiredMeshes;
+	std::vector<MeshDraw>		sceneDraws;
+
+	// - Command recording
+	// Fewer draws than this per thread aren't worth a secondary command buffer
+	static const uint32_t		MIN_DRAWS_PER_RECORD_THREAD = 128;
+	CommandAllocator*			commandAllocator = nullptr;	// Per-frame buffers of every recording thread
+	CommandRecorder*			commandRecorder = nullptr;
+	uint32_t					recordThreadCount = 1;
+	CommandStats				commandStats;
+
+	// - Frame graph
+	RenderGraph*				renderGraph = nullptr;
+	RenderGraph::ResourceHandle	backbuffer = 0;
+	RenderGraph::PassHandle		mainPass = 0;
+
+	// - Textures
+	TextureLoader*				textureLoader = nullptr;
+	MipGenerator*				mipGenerator = nullptr;
+	TextureStreamer*			textureStreamer = nullptr;
+	struct PendingTexture
+	{
+		Texture*				texture;
+		ImageData				image;
+		uint32_t				layer = 0;				// Next rows to copy
+		uint32_t				row = 0;
+	};
+	uint32_t					decodingTextureCount = 0;
+	std::deque<PendingTexture>	pendingTextureUploads;	// Decoded, waiting for staging space
+	std::vector<Texture*>		pendingMipTextures;		// Level 0 copied, waiting for mip generation
+	std::vector<Texture*>		generatingTextures;		// Mips recorded, waiting for the frame to complete
+	struct RetiredTexture
+	{
+		Texture*				texture;
+		uint64_t				lastFrame;				// Number of frames submitted when it was destroyed
+	};
+	std::vector<RetiredTexture>	retiredTextures;
+
+	// - Cluster culling (nullptr if its shaders are missing)
+	ClusterRenderer*			clusterRenderer = nullptr;
+	ClusterCullParams			cullParams = ClusterCullParams::FromViewProjection(glm::mat4(1.0f), glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
 
 	std::vector<SwapChainImage> swapChainImages;
 
+	// - Resize
+	// Replaced swapchains stay alive until every frame submitted while they were current has finished
+	struct RetiredSwapChain
+	{
+		VkSwapchainKHR				swapChain;
+		std::vector<SwapChainImage> images;
+		uint64_t					lastFrame;			// Number of frames submitted when it was replaced
+	};
+	std::vector<RetiredSwapChain> retiredSwapChains;
+	bool						bSwapChainOutOfDate = false;
+
+	// - Presentation
+	VkPresentModeKHR			swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	PresentPolicy				swapChainPresentPolicy = PresentPolicy::Throughput;	// Policy the current swapchain was created with
+	std::array<PresentLatencyStats, static_cast<size_t>(PresentPolicy::Count)> presentLatency;
+	uint64_t					submittedFrames = 0;
+	uint64_t					completedFrames = 0;
+
+	// - Headless
+	// Offscreen images stand in for swapchain images (one per frame in flight)
+	std::vector<MemoryAllocation> offscreenImageAllocations;
+
+	// - Pools
+	VkCommandPool				graphicsCommandPool;			// One-time commands
+	std::vector<VkCommandBuffer> oneTimeCommandBuffers;		// Finished one-time buffers, begun again instead of freed
+
+	// - Frames in flight
+	// Everything the CPU touches while recording a frame is duplicated per frame,
+	// so frame N+1 can be recorded while the GPU is still executing frame N
+	struct FrameData
+	{
+		VkCommandBuffer			commandBuffer;			// From the command allocator, recycled once the fence signals
+		VkFence					drawFence;				// Signalled when the GPU has finished this frame
+		VkSemaphore				imageAvailable;			// Signalled when the swapchain image can be rendered to
+		VkSemaphore				renderFinished;			// Signalled when rendering is done and image can be presented
+	};
+	std::vector<FrameData>		frames;
+	std::vector<VkFence>		imageFences;			// Fence of the frame currently using each swapchain image
+	int							currentFrame = 0;
+
 	struct{
-		VkPhysicalDevice		physicalDevice;
-		VkDevice				logicalDevice;
+		VkPhysicalDevice		physicalDevice = VK_NULL_HANDLE;
+		VkDevice				logicalDevice = VK_NULL_HANDLE;
 	}mainDevice;
+	DeviceSupport				deviceSupport;
+
+	// Extended dynamic state commands (loaded if the device supports them)
+#ifdef VK_EXT_extended_dynamic_state
+	PFN_vkCmdSetCullModeEXT				pfnCmdSetCullMode = nullptr;
+	PFN_vkCmdSetFrontFaceEXT			pfnCmdSetFrontFace = nullptr;
+	PFN_vkCmdSetPrimitiveTopologyEXT	pfnCmdSetPrimitiveTopology = nullptr;
+	PFN_vkCmdSetDepthTestEnableEXT		pfnCmdSetDepthTestEnable = nullptr;
+	PFN_vkCmdSetDepthWriteEnableEXT		pfnCmdSetDepthWriteEnable = nullptr;
+	PFN_vkCmdSetDepthCompareOpEXT		pfnCmdSetDepthCompareOp = nullptr;
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+	PFN_vkCmdSetPrimitiveRestartEnableEXT pfnCmdSetPrimitiveRestartEnable = nullptr;
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+	PFN_vkCmdSetColorBlendEnableEXT		pfnCmdSetColorBlendEnable = nullptr;
+#endif
 
 	// Utility
 	VkFormat					swapChainImageFormat;
@@ -49,15 +313,53 @@ private:
 
 	void				CreateInstance();
 	void				CreateLogicalDevice();
+	void				LoadDynamicStateFunctions();
+	void				CreateAllocator();
 	void				CreateSurface();
 	void				CreateSwapChain();
+	void				RecreateSwapChain();
+	void				DestroyRetiredSwapChains(bool bForce);
+	void				CreateOffscreenTargets();
+	void				CreatePipelineCache();
 	void				CreateGraphicsPipeline();
 	void				CreateRenderPass();
+	void				CreateCommandPool();
+	void				CreateCommandAllocator();
+	void				CreateSynchronisation();
+	void				CreateGpuProfiler();
+	void				CreateClusterRenderer();
+	void				CreateTextureLoader();
+	void				CreateCommandRecorder();
+	void				CreateRenderGraph();
+	void				BuildRenderGraph();
+	void				CreateSceneMesh();
+	void				DestroyRetiredMeshes(bool bForce);
+	Mesh*				CreateMesh(const VertexLayout& layout, uint32_t vertexCount, const void* const* streamData, const void* indices, uint32_t indexCount);
+	void				CreateMeshlets(Mesh* mesh, uint32_t meshletCount, const void* meshlets, const void* meshletVertices, VkDeviceSize meshletVertexSize,
+									const void* meshletTriangles, VkDeviceSize meshletTriangleSize);
+
+	void				CreateTextureImage(Texture* texture, const ImageData& image);
+	void				CompleteTextureUploads();
+	void				DestroyRetiredTextures(bool bForce);
+
+	// Queued buffer and texture uploads and streaming changes, then mip generation of every texture whose level 0 is complete
+	void				RecordUploads(VkCommandBuffer commandBuffer, uint64_t serial);
+	void				RecordCommands(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void				RecordMainPass(const RenderGraph::PassContext& context);
+	bool				DrawsClusters() const;
+	uint32_t			GetRecordSliceCount() const;
+	void				RecordDynamicState(VkCommandBuffer commandBuffer, const GraphicsPipelineDesc& pipelineDesc);
+	void				RecordSceneDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline, uint32_t first, uint32_t end);
+
+	VkCommandBuffer		BeginOneTimeCommands();
+	void				EndOneTimeCommands(VkCommandBuffer commandBuffer);
 
 	bool				CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions);
-	bool				CheckDeviceExtensionSupport(VkPhysicalDevice device);
+	bool				CheckDeviceExtensionSupport(VkPhysicalDevice device, DeviceSupport* support = nullptr);
 	bool				CheckDeviceSuitable(VkPhysicalDevice device);
 
+	std::vector<const char*> GetRequiredDeviceExtensions();
+
 	QueueFamilyIndices	GetQueueFamilies(VkPhysicalDevice device);
 	SwapChainDetails	GetSwapChainDetails(VkPhysicalDevice device);
 
@@ -65,8 +367,11 @@ private:
 	VkPresentModeKHR	ChooseBestPresentationMode(const std::vector<VkPresentModeKHR> presentationModes);
 	VkExtent2D			ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
 
-	VkImageView			CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	VkShaderModule		CreateShaderModule(const std::vector<char>& code);
+	VkImage				CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags,
+									MemoryUsage memoryUsage, MemoryAllocation* imageAllocation, uint32_t mipLevels = 1, uint32_t layerCount = 1,
+									VkImageCreateFlags createFlags = 0);
+	// View of every mip and layer (an array view if there is more than one layer)
+	VkImageView			CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1, uint32_t layerCount = 1);
 
 };
 
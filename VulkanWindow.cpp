@@ -7,9 +7,13 @@ VulkanWindow::VulkanWindow(std::string wName, const int width, const int height)
 
 	// Set GLFW to NOT work with OPENGL
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 	Window = glfwCreateWindow(iWidth, iHeight, WindowName.c_str(), nullptr, nullptr);
+
+	// Renderer recreates the swapchain when told the framebuffer changed size
+	glfwSetWindowUserPointer(Window, this);
+	glfwSetFramebufferSizeCallback(Window, FramebufferResizeCallback);
 }
 
 VulkanWindow::~VulkanWindow()
@@ -18,3 +22,18 @@ VulkanWindow::~VulkanWindow()
 
 	glfwTerminate();
 }
+
+bool VulkanWindow::ConsumeResize()
+{
+	bool bResized = bFramebufferResized;
+	bFramebufferResized = false;
+	return bResized;
+}
+
+void VulkanWindow::FramebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+	VulkanWindow* vulkanWindow = static_cast<VulkanWindow*>(glfwGetWindowUserPointer(window));
+	vulkanWindow->bFramebufferResized = true;
+	vulkanWindow->iWidth = width;
+	vulkanWindow->iHeight = height;
+}
@@ -9,6 +9,9 @@ public:
 	~VulkanWindow();
 
 	GLFWwindow* GetWindow() { return Window; }
+
+	// True once after the framebuffer has been resized
+	bool ConsumeResize();
 private:
 	int				iWidth = 1280;
 	int				iHeight = 720;
@@ -16,5 +19,9 @@ private:
 	std::string		WindowName = " ";
 
 	GLFWwindow*		Window = nullptr;
+
+	bool			bFramebufferResized = false;
+
+	static void		FramebufferResizeCallback(GLFWwindow* window, int width, int height);
 };
 
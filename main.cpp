@@ -1,16 +1,252 @@
-
 #include "VulkanRenderer.h"
 #include "VulkanWindow.h"
+#include "Benchmark.h"
 #include <iostream>
+#include <fstream>
+#include <string>
+
+// Write RGBA8 pixels as a binary PPM (alpha dropped), easy to diff in regression tests
+static void WritePPM(const std::string& fileName, const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	file << "P6\n" << width << " " << height << "\n255\n";
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i)
+	{
+		file.write(reinterpret_cast<const char*>(&pixels[i * 4]), 3);
+	}
+}
+
+// Per pass GPU timings (min/avg/p99) of the frames just rendered
+static void DumpGpuTimings(VulkanRenderer* vulkanRenderer)
+{
+	GpuProfiler* gpuProfiler = vulkanRenderer->GetGpuProfiler();
+	if (gpuProfiler == nullptr || !gpuProfiler->IsEnabled())
+	{
+		return;
+	}
+
+	for (const auto& pass : gpuProfiler->GetStats())
+	{
+		std::cout << pass.first << ": min " << pass.second.minMs << " ms, avg " << pass.second.avgMs << " ms, p99 " << pass.second.p99Ms << " ms\n";
+	}
+
+	gpuProfiler->DumpCSV("gpu_timings.csv");
+	gpuProfiler->DumpJSON("gpu_timings.json");
+}
+
+// Device memory blocks vs what resources actually use
+static void DumpMemoryStats(VulkanRenderer* vulkanRenderer)
+{
+	GpuAllocator* gpuAllocator = vulkanRenderer->GetGpuAllocator();
+	if (gpuAllocator == nullptr)
+	{
+		return;
+	}
+
+	GpuAllocator::Stats stats = gpuAllocator->GetStats();
+	std::cout << "Device memory: " << stats.allocationCount << " allocations in " << stats.blockCount << " blocks, "
+		<< stats.usedBytes / (1024.0 * 1024.0) << " / " << stats.blockBytes / (1024.0 * 1024.0) << " MB used, fragmentation "
+		<< stats.GetFragmentation() << "\n";
+}
+
+// Command buffers allocated from the driver vs recycled from reset pools
+static void DumpCommandStats(VulkanRenderer* vulkanRenderer)
+{
+	VulkanRenderer::CommandStats stats = vulkanRenderer->GetCommandStats();
+	if (stats.frameCount == 0)
+	{
+		return;
+	}
+
+	std::cout << "Command buffers: " << stats.allocatedBuffers << " allocated (" << static_cast<double>(stats.allocatedBuffers) / stats.frameCount
+		<< " per frame), " << stats.recycledBuffers << " recycled, " << stats.poolResets << " pool resets over " << stats.frameCount << " frames\n";
+}
 
-int main()
+// Acquire-to-present latency of every policy that was used
+static void DumpPresentLatency(VulkanRenderer* vulkanRenderer)
 {
+	for (int i = 0; i < static_cast<int>(PresentPolicy::Count); ++i)
+	{
+		const VulkanRenderer::PresentLatencyStats& latency = vulkanRenderer->GetPresentLatency(static_cast<PresentPolicy>(i));
+		if (latency.frameCount == 0)
+		{
+			continue;
+		}
+
+		std::cout << GetPresentPolicyName(static_cast<PresentPolicy>(i)) << ": " << latency.frameCount << " frames, acquire-to-present min "
+			<< latency.minMs << " ms, avg " << latency.GetAverageMs() << " ms, max " << latency.maxMs << " ms\n";
+	}
+}
+
+// Startup, frame and shutdown zones, open in chrome://tracing or ui.perfetto.dev
+static void WriteCpuTrace()
+{
+#if GENIX_CPU_PROFILER_ENABLED
+	CpuProfiler::WriteChromeTrace("cpu_trace.json");
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	PROFILE_THREAD_NAME("Main");
+
+	// Genix-Vulkan --headless [frameCount] [output.ppm]
+	// Renders offscreen without a window and writes the last frame to disk
+	if (argc > 1 && std::string(argv[1]) == "--headless")
+	{
+		RendererSettings settings;
+		settings.bHeadless = true;
+
+		VulkanRenderer* vulkanRenderer = new VulkanRenderer(settings);
+
+		int frameCount = argc > 2 ? std::stoi(argv[2]) : 1;
+		for (int i = 0; i < frameCount; ++i)
+		{
+			PROFILE_ZONE("Frame");
+			vulkanRenderer->Draw();
+		}
+
+		std::vector<uint8_t> pixels;
+		vulkanRenderer->ReadbackLastFrame(pixels);
+		WritePPM(argc > 3 ? argv[3] : "frame.ppm", pixels, vulkanRenderer->GetExtent().width, vulkanRenderer->GetExtent().height);
+
+		DumpGpuTimings(vulkanRenderer);
+		DumpMemoryStats(vulkanRenderer);
+		DumpCommandStats(vulkanRenderer);
+
+		delete vulkanRenderer;
+		WriteCpuTrace();
+		return 0;
+	}
+
+	// Genix-Vulkan --cook input.obj [output.gxmesh]
+	// Converts a mesh to the binary cache format ahead of time
+	if (argc > 2 && std::string(argv[1]) == "--cook")
+	{
+		std::string cacheFileName = argc > 3 ? argv[3] : std::string(argv[2]) + ".gxmesh";
+		MeshCache::CookOBJ(argv[2], cacheFileName, VertexLayout::Interleaved(VulkanRenderer::GetVertexAttributes()), RendererSettings().frontFace);
+		return 0;
+	}
+
+	// Genix-Vulkan --bench frames [frameCount]
+	// Genix-Vulkan --bench load [fileName] [iterations]
+	// Genix-Vulkan --bench vertex [triangleCount] [frameCount]
+	// Genix-Vulkan --bench import [fileName.obj] [iterations]
+	// Genix-Vulkan --bench meshcache [fileName.obj] [iterations]
+	// Genix-Vulkan --bench meshopt [fileName.obj ...]
+	// Genix-Vulkan --bench texture [fileName.tga ...]
+	// Genix-Vulkan --bench streaming [textureCount] [frameCount]
+	// Genix-Vulkan --bench record [drawCount] [frameCount]
+	// Genix-Vulkan --bench rendergraph [width] [height]
+	// Genix-Vulkan --bench pipelines [materialCount]
+	if (argc > 2 && std::string(argv[1]) == "--bench")
+	{
+		std::string benchmark = argv[2];
+		if (benchmark == "frames")
+		{
+			RunFrameBenchmark(argc > 3 ? std::stoi(argv[3]) : 1000);
+		}
+		else if (benchmark == "load")
+		{
+			RunFileLoadBenchmark(argc > 3 ? argv[3] : "", argc > 4 ? std::stoi(argv[4]) : 20);
+		}
+		else if (benchmark == "vertex")
+		{
+			RunVertexLayoutBenchmark(argc > 3 ? std::stoi(argv[3]) : 1000000, argc > 4 ? std::stoi(argv[4]) : 200);
+		}
+		else if (benchmark == "import")
+		{
+			RunMeshImportBenchmark(argc > 3 ? argv[3] : "", argc > 4 ? std::stoi(argv[4]) : 5);
+		}
+		else if (benchmark == "meshcache")
+		{
+			RunMeshCacheBenchmark(argc > 3 ? argv[3] : "", argc > 4 ? std::stoi(argv[4]) : 5);
+		}
+		else if (benchmark == "meshopt")
+		{
+			RunMeshOptimizationReport(std::vector<std::string>(argv + 3, argv + argc));
+		}
+		else if (benchmark == "texture")
+		{
+			RunTextureBenchmark(std::vector<std::string>(argv + 3, argv + argc));
+		}
+		else if (benchmark == "streaming")
+		{
+			RunTextureStreamingBenchmark(argc > 3 ? std::stoi(argv[3]) : 24, argc > 4 ? std::stoi(argv[4]) : 600);
+		}
+		else if (benchmark == "record")
+		{
+			RunCommandRecordBenchmark(argc > 3 ? std::stoi(argv[3]) : 20000, argc > 4 ? std::stoi(argv[4]) : 200);
+		}
+		else if (benchmark == "rendergraph")
+		{
+			RunRenderGraphReport(argc > 3 ? std::stoi(argv[3]) : 1920, argc > 4 ? std::stoi(argv[4]) : 1080);
+		}
+		else if (benchmark == "pipelines")
+		{
+			RunPipelineCountReport(argc > 3 ? std::stoi(argv[3]) : 256);
+		}
+		else
+		{
+			std::cout << "Unknown benchmark: " << benchmark << "\n";
+			return 1;
+		}
+		return 0;
+	}
+
 	VulkanRenderer* vulkanRenderer = new VulkanRenderer();
 
-	while (!glfwWindowShouldClose(vulkanRenderer->GetVulkanWindow()->GetWindow()))
+	// Genix-Vulkan --mesh input.obj
+	// Draws the mesh instead of the default triangle. Only the first launch parses the OBJ, later ones map the
+	// cache cooked next to it (recooked whenever the OBJ changes).
+	Mesh* sceneMesh = nullptr;
+	if (argc > 2 && std::string(argv[1]) == "--mesh")
+	{
+		std::string cacheFileName = std::string(argv[2]) + ".gxmesh";
+		MeshCache::CookIfStale(argv[2], cacheFileName, vulkanRenderer->GetBasePipelineDesc().vertexLayout, vulkanRenderer->GetBasePipelineDesc().frontFace);
+
+		MeshCacheFile cacheFile(cacheFileName);
+		sceneMesh = vulkanRenderer->CreateMesh(cacheFile);
+		vulkanRenderer->SetSceneMesh(sceneMesh);
+
+		// Mapping can be released once the data is copied out of it
+		vulkanRenderer->FlushUploads();
+	}
+
+	// Keys 1/2/3 switch between the LowLatency/Throughput/PowerSaving presentation policies
+	GLFWwindow* window = vulkanRenderer->GetVulkanWindow()->GetWindow();
+	const int policyKeys[] = { GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3 };
+
+	while (!glfwWindowShouldClose(window))
+	{
+		PROFILE_ZONE("Frame");
+		{
+			PROFILE_ZONE("PollEvents");
+			glfwPollEvents();
+		}
+
+		for (int i = 0; i < static_cast<int>(PresentPolicy::Count); ++i)
+		{
+			if (glfwGetKey(window, policyKeys[i]) == GLFW_PRESS)
+			{
+				vulkanRenderer->SetPresentPolicy(static_cast<PresentPolicy>(i));
+			}
+		}
+
+		vulkanRenderer->Draw();
+	}
+
+	DumpGpuTimings(vulkanRenderer);
+	DumpPresentLatency(vulkanRenderer);
+	DumpMemoryStats(vulkanRenderer);
+	DumpCommandStats(vulkanRenderer);
+
+	if (sceneMesh != nullptr)
 	{
-		glfwPollEvents();
+		vulkanRenderer->DestroyMesh(sceneMesh);
 	}
+	delete vulkanRenderer;
+	WriteCpuTrace();
 
 	return 0;
 }